@@ -0,0 +1,149 @@
+/**
+  Host-native benchmark suite for the digital I/O firmware
+
+  Built and run by [env:native], e.g.
+    pio run -e native -t exec
+
+  or to replay an input trace recorded on a device instead
+    .pio/build/native/program replay trace.txt [config.json]
+
+  Each suite drives the real firmware (setup/loop/jsonConfig/jsonCommand)
+  through the native HAL with synthetic pin streams on a virtual clock,
+  and times it with the host's monotonic clock.
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <Arduino.h>
+#include <OXRS_HOST.h>
+#include <gpio_pins.h>
+#include <vector>
+
+/*--------------------------- Firmware under test ---------------------*/
+extern OXRS_HOST oxrs;
+extern uint8_t gpioTypes[GPIO_COUNT];
+
+// Status event document size, as in the firmware (names are stored by
+// pointer, so only the nodes)
+#define       EVENT_JSON_SIZE       JSON_OBJECT_SIZE(6)
+
+// Fixed document sizes of the streamed parser, as in the firmware
+#if defined(STREAM_CONFIG)
+#if !defined(STREAM_ELEMENT_SIZE)
+#define       STREAM_ELEMENT_SIZE   512
+#endif
+
+#if !defined(STREAM_MEMBERS_SIZE)
+#define       STREAM_MEMBERS_SIZE   1024
+#endif
+#endif
+
+void setup(void);
+void loop(void);
+gpioWord_t readInputs(void);
+void processInputs(gpioWord_t value);
+void jsonConfig(JsonVariant json);
+void jsonCommand(JsonVariant json);
+#if defined(STREAM_CONFIG)
+void streamConfig(const char * payload, size_t length);
+void streamCommand(const char * payload, size_t length);
+#endif
+void setConfigSchema(void);
+void setCommandSchema(void);
+void inputEvent(uint8_t id, uint8_t input, uint8_t type, uint8_t state);
+const char * getInputType(uint8_t type);
+const char * getInputEventType(uint8_t type, uint8_t state);
+
+/*--------------------------- Helpers ---------------------------------*/
+// Same pin map the firmware uses on the native target
+const uint8_t BENCH_PINS[]        = { OXRS_NATIVE_GPIOS };
+const uint8_t BENCH_PIN_COUNT     = sizeof(BENCH_PINS);
+
+// Monotonic host clock, in nanoseconds
+uint64_t benchNanos(void);
+
+// Collects samples and prints count/mean/p50/p99/max on report
+class BenchSamples
+{
+  public:
+    void reserve(size_t count) { _samples.reserve(count); }
+    void add(uint64_t sample) { _samples.push_back(sample); }
+    void clear(void) { _samples.clear(); }
+    size_t size(void) const { return _samples.size(); }
+
+    void report(const char * name, const char * unit);
+
+  private:
+    std::vector<uint64_t> _samples;
+};
+
+// Captures the status publishes made between begin() and end() - how
+// many and how many bytes - and hands each payload to the suite's own
+// handler, if it has one. Given a GPIO, only its events are captured.
+class BenchStatus
+{
+  public:
+    typedef void (*handler_t)(const char * payload);
+
+    void begin(handler_t handler = NULL, int gpio = -1);
+    void end(void);
+
+    uint32_t publishes(void) const { return _publishes; }
+    uint64_t bytes(void) const { return _bytes; }
+
+    // Look up a "key": in a payload - false if it isn't there
+    static bool number(const char * payload, const char * key, int32_t & value);
+    static bool text(const char * payload, const char * key, char * value, size_t size);
+
+  private:
+    static void capture(const char * payload, size_t length);
+
+    handler_t _handler = NULL;
+    char _gpio[24] = "";
+    uint32_t _publishes = 0;
+    uint64_t _bytes = 0;
+};
+
+extern BenchStatus benchStatus;
+
+// Report a throughput figure (operations per second)
+void benchThroughput(const char * name, uint32_t operations, uint64_t nanos);
+
+// Build a config payload for every pin - alternating input/output types
+void benchFullConfig(char * payload, size_t size);
+
+// Reset all pins to idle (high) and let the input handlers settle
+void benchSettle(void);
+
+// Put every pin back to the default config ('switch' input) and settle
+void benchResetConfig(void);
+
+// Put the simulated expanders on the mock I2C bus (before setup())
+void benchAttachExpanders(void);
+
+// Replay a recorded input trace, with an optional config applied first
+// (see bench_trace.cpp)
+int benchReplayFile(const char * tracePath, const char * configPath);
+
+/*--------------------------- Suites ----------------------------------*/
+void benchLoop(void);
+void benchEventLatency(void);
+void benchStall(void);
+void benchInputs(void);
+void benchFailover(void);
+void benchBatch(void);
+void benchEvents(void);
+void benchRules(void);
+void benchRotary(void);
+void benchCounter(void);
+void benchPwm(void);
+void benchStorm(void);
+void benchExpanders(void);
+void benchTrace(void);
+void benchMemory(void);
+void benchConfig(void);
+void benchCommand(void);
+void benchStream(void);
+
+#endif
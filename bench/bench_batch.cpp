@@ -0,0 +1,71 @@
+/**
+  Host-native benchmark suite - batched status publishing
+*/
+
+#include "bench.h"
+
+// Number of all-output commands sent per scenario
+#define       BATCH_COMMANDS        1000
+
+static void benchBatchRun(const char * name, uint16_t windowMs, const char * on, const char * off)
+{
+  char payload[96];
+  snprintf(payload, sizeof(payload), "{\"batch\":{\"windowMs\":%u,\"maxEvents\":null}}", windowMs);
+  oxrs.injectConfig(payload);
+
+  benchStatus.begin();
+
+  uint64_t nanos = 0;
+  for (uint32_t i = 0; i < BATCH_COMMANDS; i++)
+  {
+    oxrs.injectCommand((i & 1) ? off : on);
+
+    // Run long enough for the batch window to close
+    for (uint8_t pass = 0; pass < 25; pass++)
+    {
+      uint64_t start = benchNanos();
+      loop();
+      nanos += benchNanos() - start;
+    }
+  }
+
+  benchStatus.end();
+
+  printf("%-32s  %.1f publishes, %.0f bytes, %.0f ns loop() per command\n",
+    name,
+    (double)benchStatus.publishes() / BATCH_COMMANDS,
+    (double)benchStatus.bytes() / BATCH_COMMANDS,
+    (double)nanos / BATCH_COMMANDS);
+}
+
+void benchBatch(void)
+{
+  printf("-- batched status publishing --\n");
+
+  // Alternate inputs/outputs so there are outputs to command
+  char payload[4096];
+  benchFullConfig(payload, sizeof(payload));
+  oxrs.injectConfig(payload);
+
+  // Two payloads switching every output on/off, one event per output
+  char on[1024], off[1024];
+  size_t onLength = snprintf(on, sizeof(on), "{\"gpios\":[");
+  size_t offLength = snprintf(off, sizeof(off), "{\"gpios\":[");
+  for (uint8_t index = 1; index < BENCH_PIN_COUNT; index += 2)
+  {
+    onLength += snprintf(on + onLength, sizeof(on) - onLength,
+      "%s{\"gpio\":%u,\"command\":\"on\"}", index > 1 ? "," : "", BENCH_PINS[index]);
+    offLength += snprintf(off + offLength, sizeof(off) - offLength,
+      "%s{\"gpio\":%u,\"command\":\"off\"}", index > 1 ? "," : "", BENCH_PINS[index]);
+  }
+  snprintf(on + onLength, sizeof(on) - onLength, "]}");
+  snprintf(off + offLength, sizeof(off) - offLength, "]}");
+
+  benchBatchRun("batch.off", 0, on, off);
+  benchBatchRun("batch.10ms", 10, on, off);
+
+  // Back to unbatched for anything that follows
+  oxrs.injectConfig("{\"batch\":{\"windowMs\":0}}");
+
+  printf("\n");
+}
@@ -0,0 +1,104 @@
+/**
+  Host-native benchmark suite - counter inputs vs a press per pulse
+*/
+
+#include "bench.h"
+#include <Preferences.h>
+
+// An S0 meter at 7200 pulses/hour for 10 minutes - 40ms pulses with
+// 1ms of contact bounce on each edge
+#define       COUNTER_RUN_MS        600000
+#define       COUNTER_PERIOD_MS     500
+#define       COUNTER_PULSE_MS      40
+
+static int32_t _total = 0;
+
+// Pulses actually started (the run can begin part way through one)
+static uint32_t _pulses = 0;
+static bool _pulseActive = false;
+
+static void benchCounterStatus(const char * payload)
+{
+  BenchStatus::number(payload, "total", _total);
+}
+
+static void benchCounterTick(uint32_t ms)
+{
+  uint32_t phase = ms % COUNTER_PERIOD_MS;
+
+  bool active = phase < COUNTER_PULSE_MS;
+  if (active && !_pulseActive) { _pulses++; }
+  _pulseActive = active;
+
+  // Active low, bouncing for a ms after each edge
+  uint8_t level = phase < COUNTER_PULSE_MS ? LOW : HIGH;
+  if (phase == 1 || phase == COUNTER_PULSE_MS + 1) { level = !level; }
+
+  nativeSetPin(BENCH_PINS[0], level);
+}
+
+static void benchCounterRun(const char * name, const char * type)
+{
+  char payload[256];
+  snprintf(payload, sizeof(payload),
+    "{\"counter\":{\"intervalSeconds\":60,\"delta\":null,\"debounceMs\":10},"
+    "\"gpios\":[{\"gpio\":%u,\"type\":\"input\",\"input\":{\"type\":\"%s\"}}]}",
+    BENCH_PINS[0], type);
+  oxrs.injectConfig(payload);
+  benchSettle();
+
+  _total = 0;
+  _pulses = 0;
+  _pulseActive = false;
+  benchStatus.begin(benchCounterStatus);
+  nativeSetTickCallback(benchCounterTick);
+
+  uint32_t endMs = millis() + COUNTER_RUN_MS;
+  while (millis() < endMs)
+  {
+    loop();
+  }
+
+  nativeSetTickCallback(NULL);
+  nativeSetPin(BENCH_PINS[0], HIGH);
+
+  // Pick up the last few pulses with one more interval
+  uint32_t publishes = benchStatus.publishes();
+  oxrs.injectConfig("{\"counter\":{\"intervalSeconds\":1}}");
+  for (uint16_t pass = 0; pass < 2000; pass++) { loop(); }
+
+  benchStatus.end();
+
+  printf("%-32s  pulses=%u publishes=%u", name, _pulses, publishes);
+  if (_total) { printf(" total=%d", _total); }
+  printf("\n");
+}
+
+void benchCounter(void)
+{
+  printf("-- counter inputs (S0 meter, 10 minutes) --\n");
+
+  benchCounterRun("counter.press-per-pulse", "press");
+  benchCounterRun("counter.counter", "counter");
+
+  // Totals are persisted every COUNTER_SAVE_DELTA pulses (at most once a
+  // minute), so this lags behind by up to about a minute's pulses - a
+  // header then a total per GPIO (including any on expanders)
+  uint8_t store[4 + 4 * 64];
+  Preferences preferences;
+  preferences.begin("counters", true);
+  if (preferences.getBytes("counters", store, sizeof(store)) >= 4 + 4 * BENCH_PIN_COUNT)
+  {
+    uint32_t total;
+    memcpy(&total, &store[4], sizeof(total));
+    printf("%-32s  total=%u\n", "counter.persisted", total);
+  }
+  else
+  {
+    printf("%-32s  nothing stored\n", "counter.persisted");
+  }
+  preferences.end();
+
+  benchResetConfig();
+  printf("\n");
+}
@@ -0,0 +1,129 @@
+/**
+  Host-native benchmark suite - status event serialization
+*/
+
+#include "bench.h"
+#include <OXRS_Input.h>
+
+// Number of events serialized per strategy
+#define       EVENT_PASSES          1000000
+
+// The reference copies its names into the document, so needs room for them
+#define       EVENT_SPRINTF_SIZE    (EVENT_JSON_SIZE + JSON_STRING_SIZE(8) + JSON_STRING_SIZE(6))
+
+// Reference - the original path, formatting names into stack buffers
+// with sprintf_P which ArduinoJson then copies into the document
+static void addEventJsonSprintf(JsonObject json, uint8_t gpio, uint8_t type, uint8_t state)
+{
+  char inputType[9];
+  char eventType[7];
+
+  sprintf_P(inputType, PSTR("error"));
+  switch (type)
+  {
+    case BUTTON:   sprintf_P(inputType, PSTR("button"));   break;
+    case CONTACT:  sprintf_P(inputType, PSTR("contact"));  break;
+    case SWITCH:   sprintf_P(inputType, PSTR("switch"));   break;
+  }
+
+  sprintf_P(eventType, PSTR("error"));
+  switch (type)
+  {
+    case BUTTON:
+      switch (state)
+      {
+        case HOLD_EVENT: sprintf_P(eventType, PSTR("hold"));   break;
+        case 1:          sprintf_P(eventType, PSTR("single")); break;
+        case 2:          sprintf_P(eventType, PSTR("double")); break;
+      }
+      break;
+    case CONTACT:
+      switch (state)
+      {
+        case LOW_EVENT:  sprintf_P(eventType, PSTR("closed")); break;
+        case HIGH_EVENT: sprintf_P(eventType, PSTR("open"));   break;
+      }
+      break;
+    case SWITCH:
+      switch (state)
+      {
+        case LOW_EVENT:  sprintf_P(eventType, PSTR("on"));  break;
+        case HIGH_EVENT: sprintf_P(eventType, PSTR("off")); break;
+      }
+      break;
+  }
+
+  json["gpio"] = gpio;
+  json["type"] = inputType;
+  json["event"] = eventType;
+}
+
+// Events cycled through by both strategies
+static const uint8_t EVENT_TYPES[][2] =
+{
+  { SWITCH, LOW_EVENT }, { SWITCH, HIGH_EVENT },
+  { CONTACT, LOW_EVENT }, { CONTACT, HIGH_EVENT },
+  { BUTTON, 1 }, { BUTTON, 2 }, { BUTTON, HOLD_EVENT },
+};
+#define       EVENT_TYPE_COUNT      (sizeof(EVENT_TYPES) / sizeof(EVENT_TYPES[0]))
+
+void benchEvents(void)
+{
+  printf("-- status event serialization --\n");
+
+  // Default config - every pin is a 'switch' input
+  benchResetConfig();
+
+  char payload[128];
+  volatile size_t sink = 0;
+
+  // Check the firmware publishes the same payloads as the reference
+  uint8_t mismatches = 0;
+  for (uint8_t i = 0; i < EVENT_TYPE_COUNT; i++)
+  {
+    StaticJsonDocument<EVENT_SPRINTF_SIZE> json;
+    addEventJsonSprintf(json.to<JsonObject>(), BENCH_PINS[0], EVENT_TYPES[i][0], EVENT_TYPES[i][1]);
+    serializeJson(json, payload, sizeof(payload));
+
+    inputEvent(0, 0, EVENT_TYPES[i][0], EVENT_TYPES[i][1]);
+    if (strcmp(oxrs.getLastStatus(), payload) != 0) { mismatches++; }
+  }
+  printf("%-32s  %u mismatches\n", "event.check", mismatches);
+
+  // Reference document built and serialized just like publishStatus()
+  uint64_t start = benchNanos();
+  for (uint32_t i = 0; i < EVENT_PASSES; i++)
+  {
+    const uint8_t * type = EVENT_TYPES[i % EVENT_TYPE_COUNT];
+
+    StaticJsonDocument<EVENT_SPRINTF_SIZE> json;
+    addEventJsonSprintf(json.to<JsonObject>(), BENCH_PINS[0], type[0], type[1]);
+    sink = sink + serializeJson(json, payload, sizeof(payload));
+  }
+  benchThroughput("event.sprintf", EVENT_PASSES, benchNanos() - start);
+
+  // Names looked up from the firmware tables and stored by pointer
+  start = benchNanos();
+  for (uint32_t i = 0; i < EVENT_PASSES; i++)
+  {
+    const uint8_t * type = EVENT_TYPES[i % EVENT_TYPE_COUNT];
+
+    StaticJsonDocument<EVENT_JSON_SIZE> json;
+    json["gpio"] = BENCH_PINS[0];
+    json["type"] = getInputType(type[0]);
+    json["event"] = getInputEventType(type[0], type[1]);
+    sink = sink + serializeJson(json, payload, sizeof(payload));
+  }
+  benchThroughput("event.table", EVENT_PASSES, benchNanos() - start);
+
+  // Full firmware path, from the input callback to the published payload
+  start = benchNanos();
+  for (uint32_t i = 0; i < EVENT_PASSES; i++)
+  {
+    const uint8_t * type = EVENT_TYPES[i % EVENT_TYPE_COUNT];
+    inputEvent(0, 0, type[0], type[1]);
+  }
+  benchThroughput("event.publish", EVENT_PASSES, benchNanos() - start);
+
+  printf("\n");
+}
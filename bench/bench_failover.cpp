@@ -0,0 +1,78 @@
+/**
+  Host-native benchmark suite - failover queue and replay after reconnect
+*/
+
+#include "bench.h"
+
+// Replayed events seen since the capture was started
+static uint32_t _withDelay = 0;
+static uint32_t _outOfOrder = 0;
+static char _lastEvent[8];
+
+static void benchFailoverStatus(const char * payload)
+{
+  int32_t delayMs;
+  if (BenchStatus::number(payload, "delayMs", delayMs)) { _withDelay++; }
+
+  // Every other event on a 'switch' input should alternate on/off
+  char current[8];
+  if (!BenchStatus::text(payload, "event", current, sizeof(current))) return;
+
+  if (_lastEvent[0] && strcmp(current, _lastEvent) == 0) { _outOfOrder++; }
+  strcpy(_lastEvent, current);
+}
+
+static void benchFailoverRun(const char * name, uint32_t presses)
+{
+  benchResetConfig();
+
+  // Broker goes away while a contact is pressed repeatedly
+  oxrs.setConnected(false);
+  for (uint32_t press = 0; press < presses; press++)
+  {
+    nativeSetPin(BENCH_PINS[0], LOW);
+    for (uint8_t pass = 0; pass < 50; pass++) { loop(); }
+    nativeSetPin(BENCH_PINS[0], HIGH);
+    for (uint8_t pass = 0; pass < 50; pass++) { loop(); }
+  }
+
+  // Broker comes back, time how long the backlog takes to drain
+  _withDelay = 0;
+  _outOfOrder = 0;
+  _lastEvent[0] = 0;
+
+  benchStatus.begin(benchFailoverStatus);
+  oxrs.setConnected(true);
+
+  uint32_t startMs = millis();
+  uint32_t idleMs = 0;
+  uint32_t lastCount = 0;
+  while (idleMs < 1000)
+  {
+    loop();
+    if (benchStatus.publishes() != lastCount)
+    {
+      lastCount = benchStatus.publishes();
+      idleMs = 0;
+    }
+    else
+    {
+      idleMs++;
+    }
+  }
+  benchStatus.end();
+
+  printf("%-32s  raised=%u replayed=%u withDelay=%u outOfOrder=%u drainMs=%u\n",
+    name, presses * 2, benchStatus.publishes(), _withDelay, _outOfOrder, millis() - startMs - idleMs);
+}
+
+void benchFailover(void)
+{
+  printf("-- failover queue --\n");
+
+  benchFailoverRun("failover.within-capacity", 16);
+  benchFailoverRun("failover.overflow", 64);
+
+  benchResetConfig();
+  printf("\n");
+}
@@ -0,0 +1,87 @@
+/**
+  Host-native benchmark suite - input scan (readInputs) strategies
+*/
+
+#include "bench.h"
+
+// Number of scans timed per strategy
+#define       SCAN_PASSES           1000000
+
+// Number of random pin patterns checked against the reference scan
+#define       SCAN_CHECKS           10000
+
+// Reference - the original per-pin loop using digitalRead (ESP8266 path)
+static gpioWord_t readInputsDigitalRead(void)
+{
+  gpioWord_t result = (gpioWord_t)~0;
+
+  for (uint8_t index = 0; index < BENCH_PIN_COUNT; index++)
+  {
+    if (gpioTypes[index] == 0)
+    {
+      if (!digitalRead(BENCH_PINS[index])) { bitClear(result, index); }
+    }
+  }
+
+  return result;
+}
+
+// Reference - the original per-pin loop over GPIO_IN_REG (ESP32 path)
+static gpioWord_t readInputsBitRead(void)
+{
+  gpioWord_t result = (gpioWord_t)~0;
+  uint32_t inReg = nativeReadRegister(0);
+
+  for (uint8_t index = 0; index < BENCH_PIN_COUNT; index++)
+  {
+    if (gpioTypes[index] == 0)
+    {
+      if (!bitRead(inReg, BENCH_PINS[index])) { bitClear(result, index); }
+    }
+  }
+
+  return result;
+}
+
+static void benchScan(const char * name, gpioWord_t (*scan)(void))
+{
+  volatile gpioWord_t sink = 0;
+
+  uint64_t start = benchNanos();
+  for (uint32_t pass = 0; pass < SCAN_PASSES; pass++)
+  {
+    sink = sink ^ scan();
+  }
+  benchThroughput(name, SCAN_PASSES, benchNanos() - start);
+}
+
+void benchInputs(void)
+{
+  printf("-- input scan --\n");
+
+  // Alternate inputs/outputs, so the input mask matters
+  char payload[4096];
+  benchFullConfig(payload, sizeof(payload));
+  oxrs.injectConfig(payload);
+
+  // Check the register tables agree with the reference scan
+  uint32_t mismatches = 0;
+  srand(1);
+  for (uint32_t check = 0; check < SCAN_CHECKS; check++)
+  {
+    for (uint8_t index = 0; index < BENCH_PIN_COUNT; index++)
+    {
+      nativeSetPin(BENCH_PINS[index], rand() & 1);
+    }
+
+    if (readInputs() != readInputsDigitalRead()) { mismatches++; }
+  }
+  printf("%-32s  %u/%u\n", "scan.mismatches", mismatches, SCAN_CHECKS);
+
+  benchScan("scan.legacy.digitalRead", readInputsDigitalRead);
+  benchScan("scan.legacy.bitRead", readInputsBitRead);
+  benchScan("scan.register-runs", readInputs);
+
+  benchResetConfig();
+  printf("\n");
+}
@@ -0,0 +1,199 @@
+/**
+  Host-native benchmark suite - config and command parse throughput
+*/
+
+#include "bench.h"
+#include <Preferences.h>
+
+// Number of payloads parsed per scenario
+#define       JSON_ITERATIONS       20000
+
+// Number of times the schemas are loaded, as done once at boot
+#define       SCHEMA_ITERATIONS     1000
+
+void benchConfig(void)
+{
+  printf("-- config parse/apply --\n");
+
+  char payload[4096];
+  benchFullConfig(payload, sizeof(payload));
+
+  uint32_t writes = nativeGetStorageWrites();
+  uint64_t start = benchNanos();
+  for (uint32_t i = 0; i < JSON_ITERATIONS; i++)
+  {
+    oxrs.injectConfig(payload);
+  }
+  benchThroughput("config.full", JSON_ITERATIONS, benchNanos() - start);
+
+  // The same config re-sent (e.g. retained on reconnect) shouldn't touch flash
+  printf("%-32s  %u writes for %u payloads\n", "config.full.flash-writes",
+    nativeGetStorageWrites() - writes, JSON_ITERATIONS);
+
+  // ...nor any pins, so outputs that are on stay on
+  char on[1024];
+  size_t length = snprintf(on, sizeof(on), "{\"gpios\":[");
+  for (uint8_t index = 1; index < BENCH_PIN_COUNT; index += 2)
+  {
+    length += snprintf(on + length, sizeof(on) - length,
+      "%s{\"gpio\":%u,\"command\":\"on\"}", index > 1 ? "," : "", BENCH_PINS[index]);
+  }
+  snprintf(on + length, sizeof(on) - length, "]}");
+  oxrs.injectCommand(on);
+
+  uint32_t pinWrites = nativeGetWriteCount();
+  for (uint32_t i = 0; i < JSON_ITERATIONS; i++)
+  {
+    oxrs.injectConfig(payload);
+  }
+  pinWrites = nativeGetWriteCount() - pinWrites;
+
+  uint8_t stillOn = 0;
+  for (uint8_t index = 1; index < BENCH_PIN_COUNT; index += 2)
+  {
+    if (nativeGetPin(BENCH_PINS[index]) == RELAY_ON) { stillOn++; }
+  }
+  printf("%-32s  %u pin writes for %u payloads, outputs=%u/%u still on\n", "config.full.redeliver",
+    pinWrites, JSON_ITERATIONS, stillOn, BENCH_PIN_COUNT / 2);
+
+  // Every other pin flipping input/output on each payload, for comparison
+  char inputs[4096];
+  length = snprintf(inputs, sizeof(inputs), "{\"gpios\":[");
+  for (uint8_t index = 0; index < BENCH_PIN_COUNT; index++)
+  {
+    length += snprintf(inputs + length, sizeof(inputs) - length,
+      "%s{\"gpio\":%u,\"type\":\"input\",\"input\":{\"type\":\"button\"}}",
+      index ? "," : "", BENCH_PINS[index]);
+  }
+  snprintf(inputs + length, sizeof(inputs) - length, "]}");
+
+  start = benchNanos();
+  for (uint32_t i = 0; i < JSON_ITERATIONS; i++)
+  {
+    oxrs.injectConfig(i & 1 ? payload : inputs);
+  }
+  benchThroughput("config.full.changing", JSON_ITERATIONS, benchNanos() - start);
+  oxrs.injectConfig(payload);
+
+  // Single pin update, as sent when editing one GPIO in the admin UI
+  snprintf(payload, sizeof(payload),
+    "{\"gpios\":[{\"gpio\":%u,\"type\":\"input\",\"input\":{\"type\":\"contact\"}}]}",
+    BENCH_PINS[0]);
+
+  start = benchNanos();
+  for (uint32_t i = 0; i < JSON_ITERATIONS; i++)
+  {
+    oxrs.injectConfig(payload);
+  }
+  benchThroughput("config.single", JSON_ITERATIONS, benchNanos() - start);
+
+  start = benchNanos();
+  for (uint32_t i = 0; i < SCHEMA_ITERATIONS; i++)
+  {
+    setConfigSchema();
+    setCommandSchema();
+  }
+  benchThroughput("config.schema-load", SCHEMA_ITERATIONS, benchNanos() - start);
+
+  printf("\n");
+}
+
+void benchCommand(void)
+{
+  printf("-- command parse/apply --\n");
+
+  // Alternate inputs/outputs so there are outputs to command
+  char payload[4096];
+  benchFullConfig(payload, sizeof(payload));
+  oxrs.injectConfig(payload);
+
+  // Two payloads switching every output on/off
+  char on[1024], off[1024];
+  size_t onLength = snprintf(on, sizeof(on), "{\"gpios\":[");
+  size_t offLength = snprintf(off, sizeof(off), "{\"gpios\":[");
+  for (uint8_t index = 1; index < BENCH_PIN_COUNT; index += 2)
+  {
+    onLength += snprintf(on + onLength, sizeof(on) - onLength,
+      "%s{\"gpio\":%u,\"command\":\"on\"}", index > 1 ? "," : "", BENCH_PINS[index]);
+    offLength += snprintf(off + offLength, sizeof(off) - offLength,
+      "%s{\"gpio\":%u,\"command\":\"off\"}", index > 1 ? "," : "", BENCH_PINS[index]);
+  }
+  snprintf(on + onLength, sizeof(on) - onLength, "]}");
+  snprintf(off + offLength, sizeof(off) - offLength, "]}");
+
+  // Check every output actually switched
+  oxrs.injectCommand(on);
+  uint8_t wrong = 0;
+  for (uint8_t index = 1; index < BENCH_PIN_COUNT; index += 2)
+  {
+    if (nativeGetPin(BENCH_PINS[index]) != RELAY_ON) { wrong++; }
+  }
+  printf("%-32s  %u outputs not switched\n", "command.all-outputs.check", wrong);
+
+  uint32_t writes = nativeGetWriteCount();
+  uint64_t start = benchNanos();
+  for (uint32_t i = 0; i < JSON_ITERATIONS; i++)
+  {
+    oxrs.injectCommand((i & 1) ? off : on);
+  }
+  benchThroughput("command.all-outputs", JSON_ITERATIONS, benchNanos() - start);
+  printf("%-32s  %.1f hardware writes per command\n", "command.all-outputs.writes",
+    (double)(nativeGetWriteCount() - writes) / JSON_ITERATIONS);
+
+  snprintf(payload, sizeof(payload),
+    "{\"gpios\":[{\"gpio\":%u,\"command\":\"query\"}]}", BENCH_PINS[1]);
+
+  start = benchNanos();
+  for (uint32_t i = 0; i < JSON_ITERATIONS; i++)
+  {
+    oxrs.injectCommand(payload);
+  }
+  benchThroughput("command.query", JSON_ITERATIONS, benchNanos() - start);
+
+  // Every output switched by a single mask, rather than a gpios array
+  gpioWord_t outputs = 0;
+  for (uint8_t index = 1; index < BENCH_PIN_COUNT; index += 2) { outputs |= 1 << index; }
+  snprintf(on, sizeof(on), "{\"mask\":\"0x%04llx\",\"command\":\"on\"}", (unsigned long long)outputs);
+  snprintf(off, sizeof(off), "{\"mask\":\"0x%04llx\",\"command\":\"off\"}", (unsigned long long)outputs);
+
+  uint32_t published = oxrs.getStatusCount();
+  start = benchNanos();
+  for (uint32_t i = 0; i < JSON_ITERATIONS; i++)
+  {
+    oxrs.injectCommand((i & 1) ? on : off);
+  }
+  benchThroughput("command.mask", JSON_ITERATIONS, benchNanos() - start);
+  printf("%-32s  %.1f publishes per command\n", "command.mask.publishes",
+    (double)(oxrs.getStatusCount() - published) / JSON_ITERATIONS);
+
+  // Resync every pin - one query per output vs a single snapshot
+  size_t queryLength = snprintf(on, sizeof(on), "{\"gpios\":[");
+  for (uint8_t index = 1; index < BENCH_PIN_COUNT; index += 2)
+  {
+    queryLength += snprintf(on + queryLength, sizeof(on) - queryLength,
+      "%s{\"gpio\":%u,\"command\":\"query\"}", index > 1 ? "," : "", BENCH_PINS[index]);
+  }
+  snprintf(on + queryLength, sizeof(on) - queryLength, "]}");
+
+  published = oxrs.getStatusCount();
+  start = benchNanos();
+  for (uint32_t i = 0; i < JSON_ITERATIONS; i++)
+  {
+    oxrs.injectCommand(on);
+  }
+  benchThroughput("command.resync.per-pin", JSON_ITERATIONS, benchNanos() - start);
+  printf("%-32s  %.1f publishes per resync\n", "command.resync.per-pin.publishes",
+    (double)(oxrs.getStatusCount() - published) / JSON_ITERATIONS);
+
+  published = oxrs.getStatusCount();
+  start = benchNanos();
+  for (uint32_t i = 0; i < JSON_ITERATIONS; i++)
+  {
+    oxrs.injectCommand("{\"query\":\"all\"}");
+  }
+  benchThroughput("command.resync.snapshot", JSON_ITERATIONS, benchNanos() - start);
+  printf("%-32s  %.1f publishes per resync, %s\n", "command.resync.snapshot.publishes",
+    (double)(oxrs.getStatusCount() - published) / JSON_ITERATIONS, oxrs.getLastStatus());
+
+  printf("\n");
+}
@@ -0,0 +1,186 @@
+/**
+  Host-native benchmark suite - loop() cost and event-to-publish latency
+*/
+
+#include "bench.h"
+
+// Number of loop() passes timed per scenario
+#define       LOOP_PASSES           100000
+
+// Number of edges injected for the latency measurements
+#define       LATENCY_EDGES         2000
+
+// Give up waiting for a publish after this many loop() passes
+#define       LATENCY_TIMEOUT       5000
+
+// Short presses injected while the network stack stalls periodically
+#define       STALL_PRESSES         200
+#define       STALL_PRESS_MS        40
+#define       STALL_PERIOD_MS       250
+#define       STALL_EVERY_MS        500
+
+static void benchLoopPasses(const char * name, uint16_t togglePeriodMs)
+{
+  BenchSamples samples;
+  samples.reserve(LOOP_PASSES);
+
+  for (uint32_t pass = 0; pass < LOOP_PASSES; pass++)
+  {
+    // Synthetic pin stream - each pin toggles at a slightly different rate
+    if (togglePeriodMs)
+    {
+      for (uint8_t index = 0; index < BENCH_PIN_COUNT; index++)
+      {
+        uint32_t period = togglePeriodMs + index;
+        if ((pass % period) == 0)
+        {
+          uint8_t gpio = BENCH_PINS[index];
+          nativeSetPin(gpio, !nativeGetPin(gpio));
+        }
+      }
+    }
+
+    uint64_t start = benchNanos();
+    loop();
+    samples.add(benchNanos() - start);
+  }
+
+  samples.report(name, "ns");
+}
+
+#if defined(LOOP_PROFILER)
+static void benchLoopTelemetry(const char * payload, size_t length)
+{
+  printf("%-32s  %s\n", "loop.profiler", payload);
+}
+#endif
+
+void benchLoop(void)
+{
+  printf("-- loop() cost per pass --\n");
+
+  benchSettle();
+  benchLoopPasses("loop.idle", 0);
+  benchLoopPasses("loop.stream.50ms", 50);
+  benchLoopPasses("loop.stream.5ms", 5);
+  benchSettle();
+
+  // Raw input scan on its own
+  BenchSamples samples;
+  samples.reserve(LOOP_PASSES);
+  volatile gpioWord_t sink = 0;
+  for (uint32_t pass = 0; pass < LOOP_PASSES; pass++)
+  {
+    uint64_t start = benchNanos();
+    sink = sink ^ readInputs();
+    samples.add(benchNanos() - start);
+  }
+  samples.report("readInputs", "ns");
+
+  // The firmware's own view of the passes above
+  #if defined(LOOP_PROFILER)
+  oxrs.setTelemetryCallback(benchLoopTelemetry);
+  oxrs.injectCommand("{\"profiler\":\"query\"}");
+  oxrs.setTelemetryCallback(NULL);
+  #endif
+
+  printf("\n");
+}
+
+// Pin stream for the stall scenario - a short press every period
+static void benchStallTick(uint32_t ms)
+{
+  nativeSetPin(BENCH_PINS[0], (ms % STALL_PERIOD_MS) < STALL_PRESS_MS ? LOW : HIGH);
+}
+
+void benchStall(void)
+{
+  printf("-- short presses during network stalls --\n");
+
+  // Default config - every pin is a 'switch' input, 2 events per press
+  benchResetConfig();
+
+  static const uint32_t stallMicros[] = { 0, 20000, 100000, 200000 };
+  for (uint32_t stall : stallMicros)
+  {
+    uint32_t published = oxrs.getStatusCount();
+    uint32_t endMs = millis() + (STALL_PRESSES * STALL_PERIOD_MS);
+
+    // Stall the network stack once per interval, e.g. an MQTT reconnect
+    uint32_t lastStall = millis();
+
+    nativeSetTickCallback(benchStallTick);
+    while (millis() < endMs)
+    {
+      bool stalled = (millis() - lastStall) >= STALL_EVERY_MS;
+      if (stalled) { lastStall = millis(); }
+
+      oxrs.setLoopMicros(stalled ? stall : 0);
+      loop();
+    }
+    nativeSetTickCallback(NULL);
+
+    char name[40];
+    snprintf(name, sizeof(name), "stall.%ums", stall / 1000);
+    printf("%-32s  events=%u/%u\n", name, oxrs.getStatusCount() - published, STALL_PRESSES * 2);
+
+    oxrs.setLoopMicros(0);
+    benchSettle();
+  }
+
+  printf("\n");
+}
+
+void benchEventLatency(void)
+{
+  printf("-- input edge to status publish --\n");
+
+  // Default config - every pin is a 'switch' input
+  benchResetConfig();
+
+  BenchSamples virtualLatency;
+  BenchSamples hostLatency;
+  uint32_t missed = 0;
+
+  for (uint32_t edge = 0; edge < LATENCY_EDGES; edge++)
+  {
+    uint8_t gpio = BENCH_PINS[edge % BENCH_PIN_COUNT];
+    uint32_t published = oxrs.getStatusCount();
+
+    nativeSetPin(gpio, !nativeGetPin(gpio));
+
+    uint32_t edgeMicros = micros();
+    uint64_t hostNanos = 0;
+    uint16_t pass;
+
+    for (pass = 0; pass < LATENCY_TIMEOUT; pass++)
+    {
+      uint64_t start = benchNanos();
+      loop();
+      hostNanos += benchNanos() - start;
+
+      if (oxrs.getStatusCount() != published) break;
+    }
+
+    if (pass == LATENCY_TIMEOUT)
+    {
+      missed++;
+      continue;
+    }
+
+    virtualLatency.add(micros() - edgeMicros);
+    hostLatency.add(hostNanos);
+  }
+
+  virtualLatency.report("latency.edge-to-publish", "us (device time)");
+  hostLatency.report("latency.edge-to-publish.cpu", "ns (host cpu)");
+  if (missed) { printf("latency.missed                    %u edges\n", missed); }
+
+  // The firmware's own histograms, as served on the REST API
+  #if defined(LATENCY_STATS)
+  const char * stats = oxrs.injectApiGet("/latency");
+  printf("%-32s  %s\n", "latency.api", stats ? stats : "no route");
+  #endif
+
+  printf("\n");
+}
@@ -0,0 +1,199 @@
+/**
+  Host-native benchmark suite - entry point and helpers (see bench.h)
+*/
+
+#include "bench.h"
+#include <algorithm>
+#include <chrono>
+
+uint64_t benchNanos(void)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void BenchSamples::report(const char * name, const char * unit)
+{
+  if (_samples.empty())
+  {
+    printf("%-32s  no samples\n", name);
+    return;
+  }
+
+  std::sort(_samples.begin(), _samples.end());
+
+  uint64_t total = 0;
+  for (uint64_t sample : _samples) { total += sample; }
+
+  size_t count = _samples.size();
+  printf("%-32s  n=%-8zu mean=%-10.1f p50=%-8llu p99=%-8llu max=%-8llu %s\n",
+    name,
+    count,
+    (double)total / count,
+    (unsigned long long)_samples[count / 2],
+    (unsigned long long)_samples[(count * 99) / 100],
+    (unsigned long long)_samples[count - 1],
+    unit);
+}
+
+BenchStatus benchStatus;
+
+void BenchStatus::begin(handler_t handler, int gpio)
+{
+  _handler = handler;
+  _publishes = 0;
+  _bytes = 0;
+
+  _gpio[0] = 0;
+  if (gpio >= 0) { snprintf(_gpio, sizeof(_gpio), "\"gpio\":%d,", gpio); }
+
+  oxrs.setStatusCallback(capture);
+}
+
+void BenchStatus::end(void)
+{
+  oxrs.setStatusCallback(NULL);
+  _handler = NULL;
+}
+
+void BenchStatus::capture(const char * payload, size_t length)
+{
+  BenchStatus & status = benchStatus;
+  if (status._gpio[0] && !strstr(payload, status._gpio)) return;
+
+  status._publishes++;
+  status._bytes += length;
+  if (status._handler) { status._handler(payload); }
+}
+
+bool BenchStatus::number(const char * payload, const char * key, int32_t & value)
+{
+  char field[32];
+  snprintf(field, sizeof(field), "\"%s\":", key);
+
+  const char * found = strstr(payload, field);
+  if (!found) return false;
+
+  value = strtol(found + strlen(field), NULL, 10);
+  return true;
+}
+
+bool BenchStatus::text(const char * payload, const char * key, char * value, size_t size)
+{
+  char field[32];
+  snprintf(field, sizeof(field), "\"%s\":\"", key);
+
+  const char * found = strstr(payload, field);
+  if (!found) return false;
+
+  found += strlen(field);
+  snprintf(value, size, "%.*s", (int)strcspn(found, "\""), found);
+  return true;
+}
+
+void benchThroughput(const char * name, uint32_t operations, uint64_t nanos)
+{
+  double seconds = (double)nanos / 1e9;
+  printf("%-32s  n=%-8u %12.0f ops/s  %10.1f ns/op\n",
+    name,
+    operations,
+    operations / seconds,
+    (double)nanos / operations);
+}
+
+void benchFullConfig(char * payload, size_t size)
+{
+  size_t length = snprintf(payload, size, "{\"gpios\":[");
+
+  for (uint8_t index = 0; index < BENCH_PIN_COUNT; index++)
+  {
+    if (index & 1)
+    {
+      length += snprintf(payload + length, size - length,
+        "%s{\"gpio\":%u,\"type\":\"output\",\"output\":{\"type\":\"relay\",\"timerSeconds\":60}}",
+        index ? "," : "", BENCH_PINS[index]);
+    }
+    else
+    {
+      length += snprintf(payload + length, size - length,
+        "%s{\"gpio\":%u,\"type\":\"input\",\"input\":{\"type\":\"button\",\"invert\":false}}",
+        index ? "," : "", BENCH_PINS[index]);
+    }
+  }
+
+  snprintf(payload + length, size - length, "]}");
+}
+
+void benchSettle(void)
+{
+  for (uint8_t index = 0; index < BENCH_PIN_COUNT; index++)
+  {
+    nativeSetPin(BENCH_PINS[index], HIGH);
+  }
+
+  // Long enough for any debounce/hold/multi-click timers to expire
+  for (uint16_t pass = 0; pass < 2000; pass++)
+  {
+    loop();
+  }
+}
+
+void benchResetConfig(void)
+{
+  char payload[4096];
+  size_t length = snprintf(payload, sizeof(payload), "{\"gpios\":[");
+
+  for (uint8_t index = 0; index < BENCH_PIN_COUNT; index++)
+  {
+    length += snprintf(payload + length, sizeof(payload) - length,
+      "%s{\"gpio\":%u,\"type\":\"input\",\"input\":{\"type\":\"switch\",\"invert\":false}}",
+      index ? "," : "", BENCH_PINS[index]);
+  }
+
+  snprintf(payload + length, sizeof(payload) - length, "]}");
+  oxrs.injectConfig(payload);
+
+  benchSettle();
+}
+
+int main(int argc, char * argv[])
+{
+  // Keep firmware logging out of the results
+  nativeSetQuiet(true);
+
+  // The firmware probes for expanders in setup()
+  benchAttachExpanders();
+
+  setup();
+
+  if (argc > 2 && strcmp(argv[1], "replay") == 0)
+  {
+    return benchReplayFile(argv[2], argc > 3 ? argv[3] : NULL);
+  }
+
+  printf("OXRS digital I/O host benchmarks (%u pins)\n", BENCH_PIN_COUNT);
+  printf("config schema %zu bytes, command schema %zu bytes\n\n",
+    oxrs.getConfigSchemaSize(),
+    oxrs.getCommandSchemaSize());
+
+  benchLoop();
+  benchInputs();
+  benchEventLatency();
+  benchStall();
+  benchRules();
+  benchRotary();
+  benchCounter();
+  benchPwm();
+  benchStorm();
+  benchExpanders();
+  benchTrace();
+  benchFailover();
+  benchBatch();
+  benchEvents();
+  benchConfig();
+  benchCommand();
+  benchStream();
+  benchMemory();
+
+  return 0;
+}
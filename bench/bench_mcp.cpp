@@ -0,0 +1,156 @@
+/**
+  Host-native benchmark suite - MCP23017 expanders (MCP_EXPANDERS)
+*/
+
+#include "bench.h"
+
+// Idle for this many loop passes, then toggle an expander input every
+// TOGGLE_MS for STREAM_MS
+#define       MCP_IDLE_PASSES       10000
+#define       MCP_STREAM_MS         10000
+#define       MCP_TOGGLE_MS         50
+
+#if defined(MCP_EXPANDERS)
+#include <Wire.h>
+
+static const uint8_t BENCH_MCP_INT_PINS[] = NATIVE_MCP_INT_PINS;
+
+// Input streamed on the last expander, and outputs on the first
+static const uint8_t MCP_INPUT_EXPANDER   = MCP_EXPANDERS - 1;
+static const uint8_t MCP_INPUT_PIN        = 5;
+static const uint8_t MCP_OUTPUT_FIRST     = 8;
+
+static uint8_t benchMcpGpio(uint8_t expander, uint8_t pin)
+{
+  return 100 + (16 * expander) + pin;
+}
+
+static uint32_t mcpChanges = 0;
+static uint32_t mcpChangedMs = 0;
+static BenchSamples mcpLag;
+
+// Toggle the streamed input on every TOGGLE_MS boundary
+static void benchMcpTick(uint32_t ms)
+{
+  if (ms % MCP_TOGGLE_MS) return;
+
+  mcpChanges++;
+  mcpChangedMs = ms;
+  nativeMcpSetPin(NATIVE_MCP23017_ADDRESS + MCP_INPUT_EXPANDER, MCP_INPUT_PIN, mcpChanges & 1 ? LOW : HIGH);
+}
+
+// Time the events raised by the streamed input
+static void benchMcpStatus(const char * payload)
+{
+  (void)payload;
+  mcpLag.add(millis() - mcpChangedMs);
+}
+#endif
+
+void benchAttachExpanders(void)
+{
+  #if defined(MCP_EXPANDERS)
+  for (uint8_t expander = 0; expander < MCP_EXPANDERS; expander++)
+  {
+    nativeMcpAttach(NATIVE_MCP23017_ADDRESS + expander, BENCH_MCP_INT_PINS[expander]);
+  }
+  #endif
+}
+
+void benchExpanders(void)
+{
+  #if defined(MCP_EXPANDERS)
+  printf("-- MCP23017 expanders --\n");
+
+  char payload[2048];
+  size_t length = snprintf(payload, sizeof(payload), "{\"gpios\":[");
+  for (uint8_t pin = MCP_OUTPUT_FIRST; pin < 16; pin++)
+  {
+    length += snprintf(payload + length, sizeof(payload) - length,
+      "%s{\"gpio\":%u,\"type\":\"output\",\"output\":{\"type\":\"relay\"}}",
+      pin > MCP_OUTPUT_FIRST ? "," : "", benchMcpGpio(0, pin));
+  }
+  snprintf(payload + length, sizeof(payload) - length, "]}");
+  oxrs.injectConfig(payload);
+  benchSettle();
+
+  // Nothing changing, so nothing should go over the bus
+  uint32_t transfers = nativeI2cGetTransfers();
+  uint32_t busUs = nativeI2cGetBusMicros();
+  for (uint32_t pass = 0; pass < MCP_IDLE_PASSES; pass++) { loop(); }
+
+  printf("%-32s  passes=%u transfers=%u busUs=%u\n", "mcp.idle",
+    MCP_IDLE_PASSES, nativeI2cGetTransfers() - transfers, nativeI2cGetBusMicros() - busUs);
+
+  // One input on the last expander changing, read only when it raises INT
+  mcpChanges = 0;
+  mcpLag.clear();
+  benchStatus.begin(benchMcpStatus, benchMcpGpio(MCP_INPUT_EXPANDER, MCP_INPUT_PIN));
+  nativeSetTickCallback(benchMcpTick);
+
+  transfers = nativeI2cGetTransfers();
+  busUs = nativeI2cGetBusMicros();
+  uint32_t passes = 0;
+  uint32_t endMs = millis() + MCP_STREAM_MS;
+  while (millis() < endMs)
+  {
+    loop();
+    passes++;
+  }
+
+  nativeSetTickCallback(NULL);
+  for (uint16_t pass = 0; pass < 200; pass++) { loop(); }
+  benchStatus.end();
+
+  transfers = nativeI2cGetTransfers() - transfers;
+  busUs = nativeI2cGetBusMicros() - busUs;
+
+  printf("%-32s  changes=%u events=%u transfers=%u (%.1f per change) busUs=%u (%.1f per change, %.2f%% of the bus)\n",
+    "mcp.stream", mcpChanges, benchStatus.publishes(), transfers,
+    (double)transfers / mcpChanges, busUs, (double)busUs / mcpChanges,
+    (100.0 * busUs) / (MCP_STREAM_MS * 1000.0));
+  mcpLag.report("mcp.stream.lag", "ms");
+
+  // Polling instead would read every expander on every pass (a read is
+  // the register write then the 2-byte read, i.e. 2 transfers)
+  double readUs = (2.0 * busUs) / transfers;
+  printf("%-32s  passes=%u transfers=%u busUs=%.0f (%.2f%% of the bus)\n",
+    "mcp.stream.poll-all", passes, passes * MCP_EXPANDERS * 2,
+    passes * MCP_EXPANDERS * readUs,
+    (100.0 * passes * MCP_EXPANDERS * readUs) / (MCP_STREAM_MS * 1000.0));
+
+  // Switching 8 outputs on one expander with one command
+  length = snprintf(payload, sizeof(payload), "{\"gpios\":[");
+  for (uint8_t pin = MCP_OUTPUT_FIRST; pin < 16; pin++)
+  {
+    length += snprintf(payload + length, sizeof(payload) - length,
+      "%s{\"gpio\":%u,\"command\":\"on\"}", pin > MCP_OUTPUT_FIRST ? "," : "", benchMcpGpio(0, pin));
+  }
+  snprintf(payload + length, sizeof(payload) - length, "]}");
+
+  transfers = nativeI2cGetTransfers();
+  oxrs.injectCommand(payload);
+  transfers = nativeI2cGetTransfers() - transfers;
+
+  uint8_t on = 0;
+  for (uint8_t pin = MCP_OUTPUT_FIRST; pin < 16; pin++)
+  {
+    if (nativeMcpGetPin(NATIVE_MCP23017_ADDRESS, pin) == RELAY_ON) { on++; }
+  }
+  printf("%-32s  outputs=%u/%u on, transfers=%u\n", "mcp.outputs", on, 16 - MCP_OUTPUT_FIRST, transfers);
+
+  // Back to inputs
+  length = snprintf(payload, sizeof(payload), "{\"gpios\":[");
+  for (uint8_t pin = MCP_OUTPUT_FIRST; pin < 16; pin++)
+  {
+    length += snprintf(payload + length, sizeof(payload) - length,
+      "%s{\"gpio\":%u,\"type\":\"input\",\"input\":{\"type\":\"switch\"}}",
+      pin > MCP_OUTPUT_FIRST ? "," : "", benchMcpGpio(0, pin));
+  }
+  snprintf(payload + length, sizeof(payload) - length, "]}");
+  oxrs.injectConfig(payload);
+
+  benchResetConfig();
+  printf("\n");
+  #endif
+}
@@ -0,0 +1,146 @@
+/**
+  Host-native benchmark suite - heap/stack telemetry (MEMORY_STATS)
+*/
+
+#include "bench.h"
+
+// Payloads pushed through each path before the stats are queried
+#define       MEMORY_ITERATIONS     1000
+
+#if defined(MEMORY_STATS)
+static const char * const MEMORY_PATHS[] = { "schema", "config", "command", "publish" };
+
+static char memoryTelemetry[NATIVE_PAYLOAD_SIZE];
+static uint32_t memoryPublishes = 0;
+
+static void benchMemoryTelemetry(const char * payload, size_t length)
+{
+  if (!strstr(payload, "\"memory\"")) return;
+
+  memoryPublishes++;
+  snprintf(memoryTelemetry, sizeof(memoryTelemetry), "%.*s", (int)length, payload);
+}
+
+// Publish the stats now, and parse what was published
+static bool benchMemoryQuery(JsonDocument & json)
+{
+  memoryTelemetry[0] = 0;
+  oxrs.injectCommand("{\"memory\":\"query\"}");
+  return !deserializeJson(json, memoryTelemetry) && json.containsKey("memory");
+}
+
+static uint32_t benchMemoryFreeHeap(void)
+{
+  StaticJsonDocument<1024> json;
+  return benchMemoryQuery(json) ? json["memory"]["freeHeap"].as<uint32_t>() : 0;
+}
+#endif
+
+void benchMemory(void)
+{
+  #if defined(MEMORY_STATS)
+  printf("-- memory stats --\n");
+
+  oxrs.setTelemetryCallback(benchMemoryTelemetry);
+  oxrs.injectCommand("{\"memory\":\"reset\"}");
+
+  // Drive every measured path
+  char payload[4096];
+  benchFullConfig(payload, sizeof(payload));
+
+  char on[1024], off[1024];
+  size_t onLength = snprintf(on, sizeof(on), "{\"gpios\":[");
+  size_t offLength = snprintf(off, sizeof(off), "{\"gpios\":[");
+  for (uint8_t index = 1; index < BENCH_PIN_COUNT; index += 2)
+  {
+    onLength += snprintf(on + onLength, sizeof(on) - onLength,
+      "%s{\"gpio\":%u,\"command\":\"on\"}", index > 1 ? "," : "", BENCH_PINS[index]);
+    offLength += snprintf(off + offLength, sizeof(off) - offLength,
+      "%s{\"gpio\":%u,\"command\":\"off\"}", index > 1 ? "," : "", BENCH_PINS[index]);
+  }
+  snprintf(on + onLength, sizeof(on) - onLength, "]}");
+  snprintf(off + offLength, sizeof(off) - offLength, "]}");
+
+  setConfigSchema();
+  setCommandSchema();
+  oxrs.injectConfig(payload);
+  oxrs.injectCommand("{\"query\":\"all\"}");
+
+  // Commands, and input events published from the loop
+  for (uint32_t i = 0; i < MEMORY_ITERATIONS; i++)
+  {
+    oxrs.injectCommand(i & 1 ? off : on);
+    nativeSetPin(BENCH_PINS[0], i & 1 ? HIGH : LOW);
+    for (uint8_t pass = 0; pass < 50; pass++) { loop(); }
+  }
+
+  StaticJsonDocument<1024> json;
+  if (benchMemoryQuery(json))
+  {
+    JsonObject memory = json["memory"];
+    printf("%-32s  freeHeap=%u largestBlock=%u minFreeHeap=%u fragmentation=%u%% stackFree=%u\n", "memory.gauges",
+      memory["freeHeap"].as<uint32_t>(), memory["largestBlock"].as<uint32_t>(),
+      memory["minFreeHeap"].as<uint32_t>(), memory["fragmentation"].as<uint32_t>(),
+      memory["stackFree"].as<uint32_t>());
+
+    for (const char * path : MEMORY_PATHS)
+    {
+      JsonArray peak = memory["peakBytes"][path];
+
+      char name[48];
+      snprintf(name, sizeof(name), "memory.peak.%s", path);
+      printf("%-32s  heap=%u stack=%u\n", name, peak[0].as<uint32_t>(), peak[1].as<uint32_t>());
+    }
+  }
+  else
+  {
+    printf("%-32s  no telemetry published\n", "memory.gauges");
+  }
+
+  // Repeated config pushes shouldn't leak (the host heap doesn't fragment,
+  // so this only catches allocations that are never freed)
+  char inputs[4096];
+  size_t length = snprintf(inputs, sizeof(inputs), "{\"gpios\":[");
+  for (uint8_t index = 0; index < BENCH_PIN_COUNT; index++)
+  {
+    length += snprintf(inputs + length, sizeof(inputs) - length,
+      "%s{\"gpio\":%u,\"type\":\"input\",\"input\":{\"type\":\"button\"}}",
+      index ? "," : "", BENCH_PINS[index]);
+  }
+  snprintf(inputs + length, sizeof(inputs) - length, "]}");
+
+  uint32_t before = benchMemoryFreeHeap();
+  for (uint32_t i = 0; i < MEMORY_ITERATIONS; i++)
+  {
+    oxrs.injectConfig(i & 1 ? payload : inputs);
+    setConfigSchema();
+  }
+  uint32_t after = benchMemoryFreeHeap();
+
+  printf("%-32s  payloads=%u freeHeap before=%u after=%u (%d bytes)\n", "memory.config-churn",
+    MEMORY_ITERATIONS, before, after, (int)(after - before));
+
+  // An alarm over the current free heap is raised within a check, and
+  // cleared once the threshold is dropped
+  snprintf(payload, sizeof(payload), "{\"memory\":{\"freeHeap\":%u}}", after + 65536);
+  oxrs.injectConfig(payload);
+
+  memoryPublishes = 0;
+  uint32_t start = millis();
+  while (!strstr(memoryTelemetry, "\"alarms\":[\"freeHeap\"]") && (millis() - start) < 5000) { loop(); }
+  uint32_t raisedMs = millis() - start;
+  uint32_t raised = memoryPublishes;
+
+  oxrs.injectConfig("{\"memory\":{\"freeHeap\":null}}");
+  start = millis();
+  while (!strstr(memoryTelemetry, "\"alarms\":[]") && (millis() - start) < 5000) { loop(); }
+  uint32_t clearedMs = millis() - start;
+
+  printf("%-32s  raised in %ums (%u publishes), cleared in %ums\n", "memory.alarm",
+    raisedMs, raised, clearedMs);
+
+  oxrs.setTelemetryCallback(NULL);
+  benchResetConfig();
+  printf("\n");
+  #endif
+}
@@ -0,0 +1,71 @@
+/**
+  Host-native benchmark suite - PWM outputs and fades
+*/
+
+#include "bench.h"
+
+// A one second fade, as used to ramp an LED strip on/off
+#define       PWM_FADE_MS           1000
+
+static int32_t _level = 0;
+
+static void benchPwmStatus(const char * payload)
+{
+  BenchStatus::number(payload, "level", _level);
+}
+
+static void benchPwmCommand(const char * name, uint8_t gpio, const char * command, uint32_t runMs)
+{
+  _level = 0;
+  benchStatus.begin(benchPwmStatus);
+
+  uint32_t writes = nativeGetWriteCount();
+  uint64_t start = benchNanos();
+  oxrs.injectCommand(command);
+
+  uint32_t endMs = millis() + runMs;
+  uint32_t passes = 0;
+  while (millis() < endMs)
+  {
+    loop();
+    passes++;
+  }
+  uint64_t nanos = benchNanos() - start;
+
+  benchStatus.end();
+
+  printf("%-32s  publishes=%u level=%d duty=%d writes=%u %.1f ns/loop\n",
+    name, benchStatus.publishes(), _level, nativeGetAnalog(gpio),
+    nativeGetWriteCount() - writes, (double)nanos / passes);
+}
+
+void benchPwm(void)
+{
+  printf("-- pwm outputs --\n");
+
+  uint8_t gpio = BENCH_PINS[1];
+  char payload[256];
+  snprintf(payload, sizeof(payload),
+    "{\"gpios\":[{\"gpio\":%u,\"type\":\"output\",\"output\":{\"type\":\"pwm\",\"resolutionBits\":10}}]}",
+    gpio);
+  oxrs.injectConfig(payload);
+
+  snprintf(payload, sizeof(payload),
+    "{\"gpios\":[{\"gpio\":%u,\"command\":\"level\",\"level\":50}]}", gpio);
+  benchPwmCommand("pwm.level", gpio, payload, 100);
+
+  // Software fade here (one duty write per step), the LEDC fade engine
+  // does the steps on an ESP32 - either way only one publish at the end
+  snprintf(payload, sizeof(payload),
+    "{\"gpios\":[{\"gpio\":%u,\"command\":\"fade\",\"level\":100,\"fadeMs\":%u}]}",
+    gpio, PWM_FADE_MS);
+  benchPwmCommand("pwm.fade", gpio, payload, PWM_FADE_MS + 100);
+
+  snprintf(payload, sizeof(payload),
+    "{\"gpios\":[{\"gpio\":%u,\"command\":\"fade\",\"level\":0,\"fadeMs\":%u}]}",
+    gpio, PWM_FADE_MS);
+  benchPwmCommand("pwm.fade-off", gpio, payload, PWM_FADE_MS + 100);
+
+  benchResetConfig();
+  printf("\n");
+}
@@ -0,0 +1,103 @@
+/**
+  Host-native benchmark suite - hardware rotary counters (PCNT_ROTARY)
+*/
+
+#include "bench.h"
+
+// Spin the encoder for this long, a step every STEP_US, while the network
+// stack stalls for STALL_US every STALL_EVERY_MS
+#define       ROTARY_SPIN_MS        5000
+#define       ROTARY_STEP_US        250
+#define       ROTARY_STALL_US       50000
+#define       ROTARY_STALL_EVERY_MS 500
+
+#if defined(PCNT_ROTARY)
+static int32_t rotarySteps = 0;
+
+// Sum the steps reported in every rotary event
+static void benchRotaryStatus(const char * payload)
+{
+  int32_t steps;
+  if (!BenchStatus::number(payload, "count", steps)) return;
+
+  char event[8] = "";
+  BenchStatus::text(payload, "event", event, sizeof(event));
+  rotarySteps += strcmp(event, "up") == 0 ? steps : -steps;
+}
+
+// A full quadrature cycle on A/B, up or down
+static void benchRotaryStep(uint8_t pinA, uint8_t pinB, bool up)
+{
+  uint8_t first = up ? pinA : pinB;
+  uint8_t second = up ? pinB : pinA;
+
+  nativeSetPin(first, LOW);
+  nativeAdvanceMicros(ROTARY_STEP_US / 4);
+  nativeSetPin(second, LOW);
+  nativeAdvanceMicros(ROTARY_STEP_US / 4);
+  nativeSetPin(first, HIGH);
+  nativeAdvanceMicros(ROTARY_STEP_US / 4);
+  nativeSetPin(second, HIGH);
+  nativeAdvanceMicros(ROTARY_STEP_US / 4);
+}
+#endif
+
+void benchRotary(void)
+{
+  #if defined(PCNT_ROTARY)
+  printf("-- hardware rotary counters --\n");
+
+  uint8_t pinA = BENCH_PINS[0];
+  uint8_t pinB = BENCH_PINS[1];
+
+  char payload[256];
+  snprintf(payload, sizeof(payload),
+    "{\"pcnt\":{\"intervalMs\":100},\"gpios\":["
+      "{\"gpio\":%u,\"type\":\"input\",\"input\":{\"type\":\"rotary\",\"pcnt\":true}},"
+      "{\"gpio\":%u,\"type\":\"input\",\"input\":{\"type\":\"rotary\"}}]}",
+    pinA, pinB);
+  oxrs.injectConfig(payload);
+  benchSettle();
+
+  static const bool directions[] = { true, false };
+  for (bool up : directions)
+  {
+    rotarySteps = 0;
+    benchStatus.begin(benchRotaryStatus);
+
+    // Step the encoder between (and through) loop passes and stalls
+    uint32_t injected = 0;
+    uint32_t endMs = millis() + ROTARY_SPIN_MS;
+    uint32_t lastStall = millis();
+    while (millis() < endMs)
+    {
+      bool stalled = (millis() - lastStall) >= ROTARY_STALL_EVERY_MS;
+      if (stalled) { lastStall = millis(); }
+
+      // Steps landing during the stall
+      for (uint32_t us = 0; stalled && us < ROTARY_STALL_US; us += ROTARY_STEP_US)
+      {
+        benchRotaryStep(pinA, pinB, up);
+        injected++;
+      }
+
+      benchRotaryStep(pinA, pinB, up);
+      injected++;
+      loop();
+    }
+
+    // Let the last interval report
+    for (uint16_t pass = 0; pass < 200; pass++) { loop(); }
+    benchStatus.end();
+
+    printf("%-32s  steps=%d/%d publishes=%u (%.1f steps per publish)\n",
+      up ? "rotary.pcnt.up" : "rotary.pcnt.down",
+      rotarySteps, up ? (int32_t)injected : -(int32_t)injected,
+      benchStatus.publishes(),
+      (double)injected / benchStatus.publishes());
+  }
+
+  benchResetConfig();
+  printf("\n");
+  #endif
+}
@@ -0,0 +1,93 @@
+/**
+  Host-native benchmark suite - local rules, input edge to output switch
+*/
+
+#include "bench.h"
+
+// Number of presses timed
+#define       RULE_PRESSES          500
+
+// Give up waiting for the output after this many loop() passes
+#define       RULE_TIMEOUT          5000
+
+// Rules sent for a single input, to overflow its table
+#define       RULE_OVERFLOW         8
+
+void benchRules(void)
+{
+  printf("-- local rules --\n");
+
+  // A button on the first pin toggling a relay on the second, and pulsing
+  // a relay on the fourth when held
+  uint8_t input = BENCH_PINS[0];
+  uint8_t output = BENCH_PINS[1];
+  uint8_t pulse = BENCH_PINS[3];
+
+  char payload[512];
+  snprintf(payload, sizeof(payload),
+    "{\"gpios\":["
+      "{\"gpio\":%u,\"type\":\"input\",\"input\":{\"type\":\"switch\"}},"
+      "{\"gpio\":%u,\"type\":\"output\",\"output\":{\"type\":\"relay\"}},"
+      "{\"gpio\":%u,\"type\":\"output\",\"output\":{\"type\":\"relay\"}}],"
+    "\"rules\":["
+      "{\"inputGpio\":%u,\"event\":\"on\",\"outputGpio\":%u,\"action\":\"toggle\"},"
+      "{\"inputGpio\":%u,\"event\":\"off\",\"outputGpio\":%u,\"action\":\"pulse\",\"pulseMs\":200}]}",
+    input, output, pulse, input, output, input, pulse);
+  oxrs.injectConfig(payload);
+  printf("%-32s  %s\n", "rules.result", oxrs.getLastStatus());
+  benchSettle();
+
+  // Press (switch on) toggles the output, release pulses the other one
+  BenchSamples latency;
+  uint32_t missed = 0;
+  uint32_t pulses = 0;
+
+  for (uint32_t press = 0; press < RULE_PRESSES; press++)
+  {
+    uint8_t before = nativeGetPin(output);
+    nativeSetPin(input, LOW);
+
+    uint32_t edgeMicros = micros();
+    uint16_t pass;
+    for (pass = 0; pass < RULE_TIMEOUT; pass++)
+    {
+      loop();
+      if (nativeGetPin(output) != before) break;
+    }
+
+    if (pass == RULE_TIMEOUT) { missed++; }
+    else { latency.add(micros() - edgeMicros); }
+
+    nativeSetPin(input, HIGH);
+    for (pass = 0; pass < 100; pass++) { loop(); }
+    if (nativeGetPin(pulse) == RELAY_ON) { pulses++; }
+
+    // Let the pulse end before the next press
+    for (pass = 0; pass < 200; pass++) { loop(); }
+  }
+
+  latency.report("rules.edge-to-output", "us (device time)");
+  printf("%-32s  %u/%u pulses seen, %u presses missed, pulse relay %s after\n",
+    "rules.check", pulses, RULE_PRESSES, missed,
+    nativeGetPin(pulse) == RELAY_OFF ? "off" : "ON");
+
+  // More rules than an input has room for, each pulsing for a different
+  // time so none of them merge - those over RULES_PER_INPUT are rejected
+  char overflow[1024];
+  int length = snprintf(overflow, sizeof(overflow), "{\"rules\":[");
+  for (uint8_t rule = 0; rule < RULE_OVERFLOW; rule++)
+  {
+    length += snprintf(overflow + length, sizeof(overflow) - length,
+      "%s{\"inputGpio\":%u,\"event\":\"on\",\"outputGpio\":%u,\"action\":\"pulse\",\"pulseMs\":%u}",
+      rule ? "," : "", input, pulse, 100 * (rule + 1));
+  }
+  snprintf(overflow + length, sizeof(overflow) - length, "]}");
+  oxrs.injectConfig(overflow);
+  printf("%-32s  %u rules sent, %s\n", "rules.overflow", RULE_OVERFLOW, oxrs.getLastStatus());
+
+  // Leave no rules behind for anything that follows
+  oxrs.injectConfig("{\"rules\":[]}");
+  benchResetConfig();
+
+  printf("\n");
+}
@@ -0,0 +1,135 @@
+/**
+  Host-native benchmark suite - input storm protection (rateLimit/burst)
+*/
+
+#include "bench.h"
+
+// A faulty contact flapping every FLAP_MS for STORM_MS, and a healthy one
+// changing every STEADY_MS, under a limit of RATE_LIMIT events per second
+#define       STORM_MS              10000
+#define       STORM_FLAP_MS         20
+#define       STORM_STEADY_MS       500
+#define       STORM_RATE_LIMIT      5
+#define       STORM_BURST           10
+
+// Give up waiting for a release after this long
+#define       STORM_RELEASE_MS      30000
+
+static uint8_t stormPin = 0;
+static uint16_t stormPeriodMs = 0;
+static uint32_t stormChanges = 0;
+
+static uint32_t stormSuppressed = 0;
+static uint32_t stormReleased = 0;
+static int32_t stormCount = 0;
+static int32_t stormSeconds = 0;
+
+// Event published next after the release, the state it was left in
+static char stormAfter[16];
+
+static void benchStormTick(uint32_t ms)
+{
+  if (ms % stormPeriodMs) return;
+
+  stormChanges++;
+  nativeSetPin(stormPin, stormChanges & 1 ? LOW : HIGH);
+}
+
+static void benchStormStatus(const char * payload)
+{
+  char event[16] = "";
+  BenchStatus::text(payload, "event", event, sizeof(event));
+
+  if (stormReleased && !stormAfter[0])
+  {
+    strcpy(stormAfter, event);
+  }
+
+  if (strcmp(event, "suppressed") == 0)
+  {
+    stormSuppressed++;
+  }
+  else if (strcmp(event, "released") == 0)
+  {
+    stormReleased++;
+    BenchStatus::number(payload, "count", stormCount);
+    BenchStatus::number(payload, "durationSeconds", stormSeconds);
+  }
+}
+
+// Configure the first pin as a contact, with a rate limit (0 for none)
+static void benchStormConfig(uint8_t rateLimit)
+{
+  char payload[256];
+  snprintf(payload, sizeof(payload),
+    "{\"gpios\":[{\"gpio\":%u,\"type\":\"input\",\"input\":{\"type\":\"contact\",\"rateLimit\":%u,\"burst\":%u}}]}",
+    stormPin, rateLimit, STORM_BURST);
+  oxrs.injectConfig(payload);
+  benchSettle();
+}
+
+// Change the pin every periodMs for STORM_MS, then wait for any release
+static void benchStormRun(const char * name, uint16_t periodMs)
+{
+  stormPeriodMs = periodMs;
+  stormChanges = 0;
+  stormSuppressed = stormReleased = 0;
+  stormCount = stormSeconds = 0;
+  stormAfter[0] = 0;
+
+  benchStatus.begin(benchStormStatus, stormPin);
+  nativeSetTickCallback(benchStormTick);
+
+  uint32_t passes = 0;
+  uint64_t start = benchNanos();
+  uint32_t endMs = millis() + STORM_MS;
+  while (millis() < endMs)
+  {
+    loop();
+    passes++;
+  }
+  uint64_t nanos = benchNanos() - start;
+
+  nativeSetTickCallback(NULL);
+  nativeSetPin(stormPin, HIGH);
+
+  // Quiet again, so a suppressed input should be released
+  uint32_t quietMs = millis();
+  uint32_t releasedMs = 0;
+  while ((millis() - quietMs) < STORM_RELEASE_MS)
+  {
+    loop();
+    if (stormReleased && !releasedMs) { releasedMs = millis() - quietMs; }
+    if (!stormSuppressed || releasedMs) break;
+  }
+
+  // Any trailing debounced edge
+  for (uint16_t pass = 0; pass < 200; pass++) { loop(); }
+  benchStatus.end();
+
+  printf("%-32s  changes=%u publishes=%u suppressed=%u released=%u count=%d seconds=%d releaseMs=%u after=%s %.1f ns/loop\n",
+    name, stormChanges, benchStatus.publishes(), stormSuppressed, stormReleased, stormCount, stormSeconds,
+    releasedMs, stormAfter[0] ? stormAfter : "-", (double)nanos / passes);
+}
+
+void benchStorm(void)
+{
+  printf("-- input storm protection --\n");
+
+  stormPin = BENCH_PINS[0];
+
+  // No limit, every change is published
+  benchStormConfig(0);
+  benchStormRun("storm.flapping.unlimited", STORM_FLAP_MS);
+
+  // Limited, one burst then a single suppressed/released pair
+  benchStormConfig(STORM_RATE_LIMIT);
+  benchStormRun("storm.flapping.limited", STORM_FLAP_MS);
+
+  // A healthy input under the limit is never suppressed
+  benchStormRun("storm.steady.limited", STORM_STEADY_MS);
+
+  benchStormConfig(0);
+  benchResetConfig();
+  printf("\n");
+}
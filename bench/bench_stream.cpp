@@ -0,0 +1,190 @@
+/**
+  Host-native benchmark suite - streamed vs document config/command parsing
+  (STREAM_CONFIG)
+*/
+
+#include "bench.h"
+#include <Preferences.h>
+
+// Payloads parsed per scenario
+#define       STREAM_ITERATIONS     200
+
+// Number of entries in the gpios lists - cycling through the pins, so the
+// longer ones stand in for a device with more GPIOs than the host has
+static const uint16_t STREAM_ENTRIES[] = { 16, 64, 256, 1024 };
+
+#if defined(STREAM_CONFIG)
+static size_t benchStreamConfig(char * payload, size_t size, uint16_t entries)
+{
+  size_t length = snprintf(payload, size, "{\"batch\":{\"windowMs\":0},\"gpios\":[");
+
+  for (uint16_t entry = 0; entry < entries; entry++)
+  {
+    uint8_t index = entry % BENCH_PIN_COUNT;
+    if (index & 1)
+    {
+      length += snprintf(payload + length, size - length,
+        "%s{\"gpio\":%u,\"type\":\"output\",\"output\":{\"type\":\"relay\",\"timerSeconds\":60}}",
+        entry ? "," : "", BENCH_PINS[index]);
+    }
+    else
+    {
+      length += snprintf(payload + length, size - length,
+        "%s{\"gpio\":%u,\"type\":\"input\",\"input\":{\"type\":\"button\",\"invert\":false}}",
+        entry ? "," : "", BENCH_PINS[index]);
+    }
+  }
+
+  length += snprintf(payload + length, size - length, "]}");
+  return length;
+}
+
+static size_t benchStreamCommand(char * payload, size_t size, uint16_t entries, const char * command)
+{
+  size_t length = snprintf(payload, size, "{\"gpios\":[");
+
+  for (uint16_t entry = 0; entry < entries; entry++)
+  {
+    uint8_t index = (entry * 2 + 1) % BENCH_PIN_COUNT;
+    length += snprintf(payload + length, size - length,
+      "%s{\"gpio\":%u,\"command\":\"%s\"}", entry ? "," : "", BENCH_PINS[index], command);
+  }
+
+  length += snprintf(payload + length, size - length, "]}");
+  return length;
+}
+
+// The persisted GPIO config, to check both paths applied the same thing
+static std::vector<uint8_t> benchStreamStored(void)
+{
+  Preferences preferences;
+  preferences.begin("digio", true);
+  std::vector<uint8_t> store(preferences.getBytesLength("digio"));
+  preferences.getBytes("digio", store.data(), store.size());
+  preferences.end();
+  return store;
+}
+
+// Parse into a document big enough for the whole payload, as the MQTT
+// library does, and return how much of it was used (0 on failure)
+static size_t benchStreamDocument(JsonDocument & json, const char * payload)
+{
+  DeserializationError error = deserializeJson(json, payload);
+  return error ? 0 : json.memoryUsage();
+}
+
+static void benchStreamReport(const char * name, uint16_t entries, size_t length, size_t maxSize,
+  size_t documentBytes, uint64_t documentNanos, uint64_t streamNanos, const char * result)
+{
+  char label[48];
+  snprintf(label, sizeof(label), "%s.%u", name, entries);
+
+  printf("%-32s  payload=%u doc=%u%s stream=%u  %.1f vs %.1f us/payload  %s\n", label,
+    (uint32_t)length, (uint32_t)documentBytes, documentBytes > maxSize ? " (too big)" : "",
+    STREAM_MEMBERS_SIZE + STREAM_ELEMENT_SIZE,
+    (double)documentNanos / STREAM_ITERATIONS / 1000, (double)streamNanos / STREAM_ITERATIONS / 1000,
+    result);
+}
+#endif
+
+void benchStream(void)
+{
+  #if defined(STREAM_CONFIG)
+  printf("-- streamed config/command parsing (doc/stream in bytes) --\n");
+
+  const size_t size = 128 * 1024;
+  char * payload = (char *)malloc(size);
+
+  // Sized for the longest payload, so the document path can be timed even
+  // where a device couldn't hold it
+  DynamicJsonDocument json(512 * 1024);
+
+  for (uint16_t entries : STREAM_ENTRIES)
+  {
+    size_t length = benchStreamConfig(payload, size, entries);
+
+    benchResetConfig();
+    size_t documentBytes = 0;
+    uint64_t start = benchNanos();
+    for (uint32_t i = 0; i < STREAM_ITERATIONS; i++)
+    {
+      documentBytes = benchStreamDocument(json, payload);
+      jsonConfig(json.as<JsonVariant>());
+    }
+    uint64_t documentNanos = benchNanos() - start;
+    std::vector<uint8_t> documentStored = benchStreamStored();
+
+    benchResetConfig();
+    start = benchNanos();
+    for (uint32_t i = 0; i < STREAM_ITERATIONS; i++)
+    {
+      oxrs.injectConfig(payload);
+    }
+    uint64_t streamNanos = benchNanos() - start;
+    std::vector<uint8_t> streamStored = benchStreamStored();
+
+    bool same = !documentStored.empty() && documentStored == streamStored;
+    benchStreamReport("stream.config", entries, length, JSON_CONFIG_MAX_SIZE,
+      documentBytes, documentNanos, streamNanos, same ? "same config" : "CONFIG DIFFERS");
+  }
+
+  // Commands, to the outputs configured above
+  char * off = (char *)malloc(size);
+  for (uint16_t entries : STREAM_ENTRIES)
+  {
+    size_t length = benchStreamCommand(payload, size, entries, "on");
+    benchStreamCommand(off, size, entries, "off");
+
+    size_t documentBytes = 0;
+    uint32_t documentOn = 0;
+    uint64_t start = benchNanos();
+    for (uint32_t i = 0; i < STREAM_ITERATIONS; i++)
+    {
+      documentBytes = benchStreamDocument(json, i & 1 ? off : payload);
+      jsonCommand(json.as<JsonVariant>());
+    }
+    uint64_t documentNanos = benchNanos() - start;
+
+    // Finish on 'on', and count the outputs that are
+    benchStreamDocument(json, payload);
+    jsonCommand(json.as<JsonVariant>());
+    for (uint8_t index = 1; index < BENCH_PIN_COUNT; index += 2)
+    {
+      if (nativeGetPin(BENCH_PINS[index]) == RELAY_ON) { documentOn++; }
+    }
+    oxrs.injectCommand(off);
+
+    uint32_t streamOn = 0;
+    start = benchNanos();
+    for (uint32_t i = 0; i < STREAM_ITERATIONS; i++)
+    {
+      oxrs.injectCommand(i & 1 ? off : payload);
+    }
+    uint64_t streamNanos = benchNanos() - start;
+
+    oxrs.injectCommand(payload);
+    for (uint8_t index = 1; index < BENCH_PIN_COUNT; index += 2)
+    {
+      if (nativeGetPin(BENCH_PINS[index]) == RELAY_ON) { streamOn++; }
+    }
+    oxrs.injectCommand(off);
+
+    char result[48];
+    snprintf(result, sizeof(result), "outputs on doc=%u stream=%u of %u",
+      documentOn, streamOn, BENCH_PIN_COUNT / 2);
+    benchStreamReport("stream.command", entries, length, JSON_COMMAND_MAX_SIZE,
+      documentBytes, documentNanos, streamNanos, result);
+  }
+
+  free(off);
+  free(payload);
+
+  // Commands without a gpios list are left to the library to parse
+  uint32_t statuses = oxrs.getStatusCount();
+  oxrs.injectCommand("{\"query\":\"all\"}");
+  printf("%-32s  %s\n", "stream.forward", oxrs.getStatusCount() > statuses ? "query handled" : "QUERY LOST");
+
+  benchResetConfig();
+  printf("\n");
+  #endif
+}
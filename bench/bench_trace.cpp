@@ -0,0 +1,418 @@
+/**
+  Host-native benchmark suite - input trace replay
+
+  A trace is the input words handed to the input handlers, as recorded on
+  a device built with INPUT_TRACE and fetched from its REST API (/trace),
+  one sample per line:
+    <timestamp ms> <inputs, hex> <gap ms>
+  where gap is how long since the handlers were last called before this
+  sample (they are assumed to have been called every ms otherwise).
+
+  Replay one through the firmware's input handlers, and the inputEvent()
+  path that names and publishes each event, with
+    .pio/build/native/program replay trace.txt [config.json]
+  which lists every event detected, its latency from the input edge
+  which caused it, and the replay throughput.
+*/
+
+#include "bench.h"
+#include <string>
+
+// Synthetic double-clicks - press/release times, and how far apart
+#define       TRACE_CLICK_MS        80
+#define       TRACE_CLICK_EVERY_MS  2000
+#define       TRACE_CLICKS          20
+
+// Stall between the two presses of every other double-click - short
+// enough that the two presses must still be seen as a double-click
+#define       TRACE_STALL_MS        250
+
+// Samples in the throughput trace
+#define       TRACE_THROUGHPUT_SAMPLES  20000
+
+// Replay past the last sample long enough for any hold/multi-click timers
+#define       TRACE_SETTLE_MS       2000
+
+struct benchTraceSample_t
+{
+  uint32_t timestamp;
+  uint16_t gapMs;
+  gpioWord_t value;
+};
+
+struct benchTrace_t
+{
+  std::vector<uint8_t> gpios;
+  std::vector<benchTraceSample_t> samples;
+};
+
+struct benchTraceEvent_t
+{
+  uint32_t timestamp;
+  uint8_t gpio;
+  std::string type;
+  std::string event;
+  uint32_t latencyMs;
+};
+
+struct benchTraceResult_t
+{
+  std::vector<benchTraceEvent_t> events;
+  uint32_t calls;
+  uint64_t nanos;
+};
+
+/*--------------------------- Parsing ---------------------------------*/
+// Parse a trace as served by /trace, using our own pin map if it has none
+static bool benchParseTrace(const char * text, benchTrace_t & trace)
+{
+  trace.gpios.clear();
+  trace.samples.clear();
+
+  while (*text)
+  {
+    const char * end = strchr(text, '\n');
+    std::string line(text, end ? end - text : strlen(text));
+    text = end ? end + 1 : text + line.size();
+
+    if (line.compare(0, 8, "# gpios ") == 0)
+    {
+      const char * gpio = line.c_str() + 8;
+      while (*gpio)
+      {
+        char * end;
+        trace.gpios.push_back(strtoul(gpio, &end, 10));
+        gpio = *end ? end + 1 : end;
+      }
+      continue;
+    }
+
+    if (line.empty() || line[0] == '#') continue;
+
+    benchTraceSample_t sample;
+    unsigned long timestamp;
+    unsigned long long value;
+    unsigned gap;
+    if (sscanf(line.c_str(), "%lu %llx %u", &timestamp, &value, &gap) != 3) return false;
+
+    sample.timestamp = timestamp;
+    sample.value = (gpioWord_t)value;
+    sample.gapMs = gap;
+    trace.samples.push_back(sample);
+  }
+
+  if (trace.gpios.empty())
+  {
+    trace.gpios.assign(BENCH_PINS, BENCH_PINS + BENCH_PIN_COUNT);
+  }
+
+  return !trace.samples.empty();
+}
+
+/*--------------------------- Replay ----------------------------------*/
+static benchTrace_t * replayTrace = NULL;
+static benchTraceResult_t * replayResult = NULL;
+static std::vector<uint32_t> replayEdgeMs;
+
+// Pick every event out of a status publish (batches hold several)
+static void benchTraceStatus(const char * payload)
+{
+  for (const char * event = strstr(payload, "\"gpio\":"); event; event = strstr(event + 1, "\"gpio\":"))
+  {
+    int32_t gpio = 0;
+    BenchStatus::number(event, "gpio", gpio);
+
+    benchTraceEvent_t detected;
+    detected.timestamp = millis();
+    detected.gpio = gpio;
+
+    char type[16] = "";
+    char name[16] = "";
+    BenchStatus::text(event, "type", type, sizeof(type));
+    BenchStatus::text(event, "event", name, sizeof(name));
+    detected.type = type;
+    detected.event = name;
+
+    // From the last edge seen on this GPIO
+    detected.latencyMs = 0;
+    for (size_t index = 0; index < replayTrace->gpios.size(); index++)
+    {
+      if (replayTrace->gpios[index] != detected.gpio) continue;
+      detected.latencyMs = millis() - replayEdgeMs[index];
+    }
+
+    replayResult->events.push_back(detected);
+  }
+}
+
+// Call the input handlers with each sample at its recorded time, and
+// with the previous one every ms in between (except across a gap)
+static void benchProcess(gpioWord_t value, benchTraceResult_t & result)
+{
+  uint64_t start = benchNanos();
+  processInputs(value);
+  result.nanos += benchNanos() - start;
+  result.calls++;
+}
+
+static benchTraceResult_t benchReplay(benchTrace_t & trace)
+{
+  benchTraceResult_t result = {};
+
+  replayTrace = &trace;
+  replayResult = &result;
+  replayEdgeMs.assign(trace.gpios.size(), millis());
+  benchStatus.begin(benchTraceStatus);
+
+  uint32_t offset = millis() - trace.samples[0].timestamp + 1;
+  gpioWord_t value = trace.samples[0].value;
+
+  for (const benchTraceSample_t & sample : trace.samples)
+  {
+    uint32_t due = sample.timestamp + offset;
+    while ((int32_t)(due - sample.gapMs - millis()) > 0)
+    {
+      nativeAdvanceMicros(1000);
+      benchProcess(value, result);
+    }
+    if ((int32_t)(due - millis()) > 0) { nativeAdvanceMicros((due - millis()) * 1000); }
+
+    gpioWord_t changed = sample.value ^ value;
+    for (size_t index = 0; index < trace.gpios.size(); index++)
+    {
+      if ((changed >> index) & 1) { replayEdgeMs[index] = millis(); }
+    }
+
+    value = sample.value;
+    benchProcess(value, result);
+  }
+
+  for (uint32_t ms = 0; ms < TRACE_SETTLE_MS; ms++)
+  {
+    nativeAdvanceMicros(1000);
+    benchProcess(value, result);
+  }
+
+  benchStatus.end();
+  return result;
+}
+
+static void benchPrintEvents(const benchTraceResult_t & result)
+{
+  uint32_t first = result.events.empty() ? 0 : result.events[0].timestamp;
+  for (const benchTraceEvent_t & event : result.events)
+  {
+    printf("%8u ms  gpio %-3u  %-8s %-8s  latency %u ms\n",
+      event.timestamp - first, event.gpio, event.type.c_str(), event.event.c_str(), event.latencyMs);
+  }
+}
+
+// Count the events of one type (e.g. 'double')
+static uint32_t benchCountEvents(const benchTraceResult_t & result, const char * name)
+{
+  uint32_t count = 0;
+  for (const benchTraceEvent_t & event : result.events)
+  {
+    if (event.event == name) { count++; }
+  }
+  return count;
+}
+
+static void benchReportReplay(const char * name, const benchTrace_t & trace, const benchTraceResult_t & result)
+{
+  BenchSamples latency;
+  for (const benchTraceEvent_t & event : result.events) { latency.add(event.latencyMs); }
+
+  double seconds = (double)result.nanos / 1e9;
+  printf("%-32s  samples=%zu calls=%u events=%zu  %.0f samples/s %.0f calls/s\n",
+    name, trace.samples.size(), result.calls, result.events.size(),
+    trace.samples.size() / seconds, result.calls / seconds);
+
+  char label[48];
+  snprintf(label, sizeof(label), "%s.latency", name);
+  latency.report(label, "ms");
+}
+
+/*--------------------------- Synthetic traces ------------------------*/
+// Double-clicks on the first GPIO, with the handlers stalled between the
+// presses of every other one if asked (as a recorded trace would show
+// it, the second press is first seen already held when the stall ends)
+static void benchDoubleClicks(benchTrace_t & trace, bool stalls)
+{
+  trace.gpios.assign(BENCH_PINS, BENCH_PINS + BENCH_PIN_COUNT);
+  trace.samples.clear();
+
+  gpioWord_t idle = (gpioWord_t)~0ULL;
+  gpioWord_t pressed = idle & ~(gpioWord_t)1;
+  uint32_t now = 1000;
+
+  trace.samples.push_back({ now, 1, idle });
+  for (uint16_t click = 0; click < TRACE_CLICKS; click++)
+  {
+    uint32_t start = now + TRACE_CLICK_EVERY_MS;
+    bool stalled = stalls && (click & 1);
+
+    uint32_t second = start + 2 * TRACE_CLICK_MS;
+    if (stalled) { second = start + TRACE_CLICK_MS + TRACE_STALL_MS; }
+
+    trace.samples.push_back({ start, 1, pressed });
+    trace.samples.push_back({ start + TRACE_CLICK_MS, 1, idle });
+    trace.samples.push_back({ second, (uint16_t)(stalled ? TRACE_STALL_MS : 1), pressed });
+    trace.samples.push_back({ second + TRACE_CLICK_MS, 1, idle });
+
+    now = start;
+  }
+}
+
+/*--------------------------- Entry points ----------------------------*/
+int benchReplayFile(const char * tracePath, const char * configPath)
+{
+  if (configPath)
+  {
+    FILE * file = fopen(configPath, "r");
+    if (!file)
+    {
+      fprintf(stderr, "can't open %s\n", configPath);
+      return 1;
+    }
+
+    std::string config;
+    char buffer[1024];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) { config.append(buffer, length); }
+    fclose(file);
+
+    oxrs.injectConfig(config.c_str());
+    benchSettle();
+  }
+
+  FILE * file = fopen(tracePath, "r");
+  if (!file)
+  {
+    fprintf(stderr, "can't open %s\n", tracePath);
+    return 1;
+  }
+
+  std::string text;
+  char buffer[1024];
+  size_t length;
+  while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) { text.append(buffer, length); }
+  fclose(file);
+
+  benchTrace_t trace;
+  if (!benchParseTrace(text.c_str(), trace))
+  {
+    fprintf(stderr, "%s isn't a valid trace\n", tracePath);
+    return 1;
+  }
+
+  benchTraceResult_t result = benchReplay(trace);
+  benchPrintEvents(result);
+  printf("\n");
+  benchReportReplay("trace", trace, result);
+  return 0;
+}
+
+void benchTrace(void)
+{
+  printf("-- input trace replay --\n");
+
+  char payload[256];
+  snprintf(payload, sizeof(payload),
+    "{\"gpios\":[{\"gpio\":%u,\"type\":\"input\",\"input\":{\"type\":\"button\"}}]}",
+    BENCH_PINS[0]);
+  oxrs.injectConfig(payload);
+  benchSettle();
+
+  // A stall between the presses of a double-click, as seen under load
+  benchTrace_t trace;
+  static const bool stalls[] = { false, true };
+  for (bool stalled : stalls)
+  {
+    benchDoubleClicks(trace, stalled);
+    benchTraceResult_t result = benchReplay(trace);
+
+    // Every click is a double-click, stalled or not
+    uint32_t doubles = benchCountEvents(result, "double");
+    uint32_t singles = benchCountEvents(result, "single");
+    printf("%-32s  clicks=%u double=%u single=%u (expected double=%u single=0, %s)\n",
+      stalled ? "trace.double-click.stalled" : "trace.double-click",
+      TRACE_CLICKS, doubles, singles, TRACE_CLICKS,
+      doubles == TRACE_CLICKS && singles == 0 ? "ok" : "FAILED");
+  }
+
+  // Throughput, on a long trace of clicks
+  trace.samples.clear();
+  gpioWord_t idle = (gpioWord_t)~0ULL;
+  for (uint32_t i = 0; i < TRACE_THROUGHPUT_SAMPLES; i++)
+  {
+    trace.samples.push_back({ 1000 + i * 40, 1, (i & 1) ? idle & ~(gpioWord_t)1 : idle });
+  }
+  benchReportReplay("trace.throughput", trace, benchReplay(trace));
+
+  #if defined(INPUT_TRACE)
+  // Record double-clicks live (through loop() and a stall), fetch the
+  // trace over the API and check the replay detects the same events
+  benchTraceResult_t live = {};
+  replayTrace = &trace;
+  replayResult = &live;
+  trace.gpios.assign(BENCH_PINS, BENCH_PINS + BENCH_PIN_COUNT);
+  replayEdgeMs.assign(trace.gpios.size(), millis());
+  benchStatus.begin(benchTraceStatus);
+
+  uint32_t liveStart = millis();
+  for (uint16_t click = 0; click < 8; click++)
+  {
+    for (uint8_t edge = 0; edge < 4; edge++)
+    {
+      nativeSetPin(BENCH_PINS[0], (edge & 1) ? HIGH : LOW);
+      for (uint16_t pass = 0; pass < TRACE_CLICK_MS; pass++) { loop(); }
+
+      // Stall between the presses of every other click
+      if (edge == 1 && (click & 1))
+      {
+        nativeAdvanceMicros((TRACE_STALL_MS - TRACE_CLICK_MS) * 1000);
+        nativeSetPin(BENCH_PINS[0], LOW);
+        nativeAdvanceMicros(TRACE_CLICK_MS * 1000);
+        edge++;
+      }
+    }
+    for (uint16_t pass = 0; pass < TRACE_CLICK_EVERY_MS; pass++) { loop(); }
+  }
+  benchStatus.end();
+
+  const char * body = oxrs.injectApiGet("/trace");
+  bool parsed = body && benchParseTrace(body, trace);
+  benchSettle();
+
+  // The trace holds the replays above too, keep from the last sample
+  // before recording started (the state it started in)
+  size_t first = 0;
+  while (first + 1 < trace.samples.size() && trace.samples[first + 1].timestamp < liveStart) { first++; }
+  trace.samples.erase(trace.samples.begin(), trace.samples.begin() + first);
+
+  uint32_t mismatches = 0;
+  size_t replayed = 0;
+  if (parsed)
+  {
+    benchTraceResult_t result = benchReplay(trace);
+    replayed = result.events.size();
+    for (size_t i = 0; i < max(live.events.size(), result.events.size()); i++)
+    {
+      if (i >= live.events.size() || i >= result.events.size() ||
+          live.events[i].gpio != result.events[i].gpio ||
+          live.events[i].event != result.events[i].event)
+      {
+        mismatches++;
+      }
+    }
+  }
+
+  printf("%-32s  samples=%zu live=%zu replayed=%zu mismatches=%u%s\n",
+    "trace.roundtrip", parsed ? trace.samples.size() : 0, live.events.size(), replayed, mismatches,
+    parsed ? "" : " (no trace)");
+  #endif
+
+  benchResetConfig();
+  printf("\n");
+}
@@ -0,0 +1,80 @@
+/**
+  GPIO pin map for each board, and the GPIO word sized to fit it
+
+  Shared by the firmware and the host-native benchmarks, so both agree
+  on how many GPIOs a build has and so how wide a GPIO word is.
+*/
+
+#ifndef GPIO_PINS_H
+#define GPIO_PINS_H
+
+#include <Arduino.h>
+#include <type_traits>                // For sizing the GPIO word
+
+// Native GPIOs on each board, a list per line - scripts/schema_extra.py
+// reads these, so the schemas always list the same pins as the firmware
+#define       OXRS_ESP32_GPIOS      2, 4, 5, 13, 14, 15, 16, 17, 18, 19, 21, 22, 23, 25, 26, 27
+#define       OXRS_ESP32_MCP_GPIOS  2, 4, 5, 13, 14, 15, 16, 17, 18, 19, 23, 25, 26, 27
+#define       OXRS_ESP8266_GPIOS    2, 4, 5, 12, 13, 14, 15, 16
+#define       OXRS_LILYGO_GPIOS     2, 4, 12, 14, 15, 16, 32, 33, 34, 35, 36, 39
+
+// The native target mirrors the ESP32 (its mock I2C bus doesn't take any
+// pins, so it keeps them all with expanders)
+#define       OXRS_NATIVE_GPIOS     2, 4, 5, 13, 14, 15, 16, 17, 18, 19, 21, 22, 23, 25, 26, 27
+
+#if defined(MCP_EXPANDERS)
+// Each MCP23017 adds 16 GPIOs, numbered from 100 + 16n for expander n
+// (GPA0-7 then GPB0-7), which follow the native GPIOs in the pin map
+#define       MCP_PIN_BASE          100
+#define       MCP_PINS(n)           MCP_PIN_BASE + 16 * (n) + 0,  MCP_PIN_BASE + 16 * (n) + 1,  \
+                                    MCP_PIN_BASE + 16 * (n) + 2,  MCP_PIN_BASE + 16 * (n) + 3,  \
+                                    MCP_PIN_BASE + 16 * (n) + 4,  MCP_PIN_BASE + 16 * (n) + 5,  \
+                                    MCP_PIN_BASE + 16 * (n) + 6,  MCP_PIN_BASE + 16 * (n) + 7,  \
+                                    MCP_PIN_BASE + 16 * (n) + 8,  MCP_PIN_BASE + 16 * (n) + 9,  \
+                                    MCP_PIN_BASE + 16 * (n) + 10, MCP_PIN_BASE + 16 * (n) + 11, \
+                                    MCP_PIN_BASE + 16 * (n) + 12, MCP_PIN_BASE + 16 * (n) + 13, \
+                                    MCP_PIN_BASE + 16 * (n) + 14, MCP_PIN_BASE + 16 * (n) + 15
+
+// Limited by the 64-bit GPIO word
+#if MCP_EXPANDERS == 1
+#define       MCP_GPIO_PINS         MCP_PINS(0)
+#elif MCP_EXPANDERS == 2
+#define       MCP_GPIO_PINS         MCP_PINS(0), MCP_PINS(1)
+#elif MCP_EXPANDERS == 3
+#define       MCP_GPIO_PINS         MCP_PINS(0), MCP_PINS(1), MCP_PINS(2)
+#else
+#error "MCP_EXPANDERS must be between 1 and 3"
+#endif
+#endif
+
+#if defined(OXRS_ESP32)
+#if defined(MCP_EXPANDERS)
+// GPIO 21/22 are the I2C bus
+constexpr uint8_t GPIO_PINS[]     = { OXRS_ESP32_MCP_GPIOS, MCP_GPIO_PINS };
+#else
+constexpr uint8_t GPIO_PINS[]     = { OXRS_ESP32_GPIOS };
+#endif
+
+#elif defined(OXRS_ESP8266)
+constexpr uint8_t GPIO_PINS[]     = { OXRS_ESP8266_GPIOS };
+
+#elif defined(OXRS_LILYGO)
+constexpr uint8_t GPIO_PINS[]     = { OXRS_LILYGO_GPIOS };
+
+#elif defined(OXRS_NATIVE)
+#if defined(MCP_EXPANDERS)
+constexpr uint8_t GPIO_PINS[]     = { OXRS_NATIVE_GPIOS, MCP_GPIO_PINS };
+#else
+constexpr uint8_t GPIO_PINS[]     = { OXRS_NATIVE_GPIOS };
+#endif
+#endif
+
+constexpr uint8_t GPIO_COUNT      = sizeof(GPIO_PINS);
+
+static_assert(GPIO_COUNT <= 64, "GPIO_PINS must fit in a 64-bit GPIO word");
+
+// Bit per GPIO index, in a word wide enough for every bank (the native
+// register width, unless there are more than 32 GPIOs)
+typedef std::conditional<(GPIO_COUNT <= 32), uint32_t, uint64_t>::type gpioWord_t;
+
+#endif
@@ -0,0 +1,343 @@
+/**
+  Host-native stand-in for the Arduino core (see Arduino.h)
+*/
+
+#include <Arduino.h>
+#include <malloc.h>
+
+HardwareSerial Serial;
+
+/*--------------------------- Global Variables ------------------------*/
+// Virtual clock, in microseconds since boot
+static uint64_t _nowMicros = 0;
+
+// Simulated pin levels (inputs idle high, as with INPUT_PULLUP)
+static uint8_t _pinLevel[NATIVE_GPIO_COUNT];
+static uint8_t _pinMode[NATIVE_GPIO_COUNT];
+static int _pinAnalog[NATIVE_GPIO_COUNT];
+static bool _pinInit = false;
+
+// The same levels packed like the ESP32 input registers
+static uint32_t _registers[2];
+
+static voidFuncPtr _isr[NATIVE_GPIO_COUNT];
+static uint8_t _isrMode[NATIVE_GPIO_COUNT];
+
+static nativeTickCallback _onTick = NULL;
+
+static voidFuncPtr _timer = NULL;
+static uint32_t _timerPeriod = 0;
+static uint64_t _timerNext = 0;
+static uint32_t _notified = 0;
+
+struct _pcnt_t
+{
+  uint8_t pulsePin;
+  uint8_t ctrlPin;
+  int16_t count;
+};
+
+static _pcnt_t _pcnt[NATIVE_PCNT_UNITS];
+static bool _pcntInit = false;
+
+// Allocated before main(), i.e. not counted against NATIVE_HEAP_SIZE
+static size_t _heapBase = mallinfo2().uordblks;
+
+static uint32_t _writeCount = 0;
+static bool _quiet = false;
+
+/*--------------------------- Program ---------------------------------*/
+static void _initPins(void)
+{
+  if (_pinInit) return;
+  memset(_pinLevel, HIGH, sizeof(_pinLevel));
+  memset(_pinMode, INPUT, sizeof(_pinMode));
+  _registers[0] = 0xffffffff;
+  _registers[1] = 0x000000ff;
+  _pinInit = true;
+}
+
+static void _setLevel(uint8_t pin, uint8_t level)
+{
+  _pinLevel[pin] = level;
+  bitWrite(_registers[pin >> 5], pin & 31, level);
+}
+
+static void _advance(uint64_t us, bool untilNotified = false)
+{
+  if (!_onTick && !_timer)
+  {
+    _nowMicros += us;
+    return;
+  }
+
+  // Step through each millisecond boundary so the tick callback can
+  // change pin states (and fire interrupts) part way through, and each
+  // timer expiry so it samples them at its own rate
+  uint64_t end = _nowMicros + us;
+  while (_nowMicros < end)
+  {
+    if (untilNotified && _notified) break;
+
+    uint64_t next = end;
+    if (_onTick) { next = min(next, ((_nowMicros / 1000) + 1) * 1000); }
+    if (_timer)  { next = min(next, _timerNext); }
+
+    _nowMicros = next;
+
+    if (_onTick && (_nowMicros % 1000) == 0)
+    {
+      _onTick((uint32_t)(_nowMicros / 1000));
+    }
+
+    if (_timer && _nowMicros >= _timerNext)
+    {
+      _timerNext += _timerPeriod;
+      _timer();
+    }
+  }
+}
+
+uint32_t millis(void)
+{
+  return (uint32_t)(_nowMicros / 1000);
+}
+
+uint32_t micros(void)
+{
+  return (uint32_t)_nowMicros;
+}
+
+void delay(uint32_t ms)
+{
+  _advance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+  _advance(us);
+}
+
+void yield(void)
+{
+}
+
+void nativeAdvanceMicros(uint32_t us)
+{
+  _advance(us);
+}
+
+void nativeSetTickCallback(nativeTickCallback callback)
+{
+  _onTick = callback;
+}
+
+void nativeStartTimer(uint32_t periodUs, voidFuncPtr callback)
+{
+  _timerPeriod = periodUs ? periodUs : 1;
+  _timerNext = _nowMicros + _timerPeriod;
+  _timer = callback;
+}
+
+void nativeStopTimer(void)
+{
+  _timer = NULL;
+}
+
+void nativeNotify(void)
+{
+  _notified++;
+}
+
+uint32_t nativeWaitNotify(uint32_t timeoutUs)
+{
+  if (!_notified)
+  {
+    _advance(timeoutUs, true);
+  }
+
+  uint32_t notified = _notified;
+  _notified = 0;
+  return notified;
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  _initPins();
+  if (pin >= NATIVE_GPIO_COUNT) return;
+  _pinMode[pin] = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+  _initPins();
+  _writeCount++;
+  if (pin >= NATIVE_GPIO_COUNT) return;
+  _setLevel(pin, val ? HIGH : LOW);
+}
+
+void analogWrite(uint8_t pin, int value)
+{
+  _initPins();
+  _writeCount++;
+  if (pin >= NATIVE_GPIO_COUNT) return;
+  _pinAnalog[pin] = value;
+}
+
+int digitalRead(uint8_t pin)
+{
+  _initPins();
+  if (pin >= NATIVE_GPIO_COUNT) return LOW;
+  return _pinLevel[pin];
+}
+
+void attachInterrupt(uint8_t pin, voidFuncPtr handler, int mode)
+{
+  if (pin >= NATIVE_GPIO_COUNT) return;
+  _isr[pin] = handler;
+  _isrMode[pin] = mode;
+}
+
+void detachInterrupt(uint8_t pin)
+{
+  if (pin >= NATIVE_GPIO_COUNT) return;
+  _isr[pin] = NULL;
+}
+
+void nativeSetPin(uint8_t pin, uint8_t level)
+{
+  _initPins();
+  if (pin >= NATIVE_GPIO_COUNT) return;
+
+  level = level ? HIGH : LOW;
+  if (_pinLevel[pin] == level) return;
+  _setLevel(pin, level);
+
+  if (_pcntInit && level == HIGH)
+  {
+    for (uint8_t unit = 0; unit < NATIVE_PCNT_UNITS; unit++)
+    {
+      if (_pcnt[unit].pulsePin != pin) continue;
+      _pcnt[unit].count += _pinLevel[_pcnt[unit].ctrlPin] ? -1 : 1;
+    }
+  }
+
+  if (!_isr[pin]) return;
+  if ((_isrMode[pin] == CHANGE) ||
+      (_isrMode[pin] == RISING && level == HIGH) ||
+      (_isrMode[pin] == FALLING && level == LOW))
+  {
+    _isr[pin]();
+  }
+}
+
+void nativePcntConfig(uint8_t unit, uint8_t pulsePin, uint8_t ctrlPin)
+{
+  if (!_pcntInit)
+  {
+    for (uint8_t i = 0; i < NATIVE_PCNT_UNITS; i++)
+    {
+      _pcnt[i] = { NATIVE_PCNT_NO_PIN, NATIVE_PCNT_NO_PIN, 0 };
+    }
+    _pcntInit = true;
+  }
+
+  if (unit >= NATIVE_PCNT_UNITS) return;
+  if (pulsePin >= NATIVE_GPIO_COUNT || ctrlPin >= NATIVE_GPIO_COUNT)
+  {
+    pulsePin = ctrlPin = NATIVE_PCNT_NO_PIN;
+  }
+  _pcnt[unit] = { pulsePin, ctrlPin, 0 };
+}
+
+int16_t nativePcntTake(uint8_t unit)
+{
+  if (!_pcntInit || unit >= NATIVE_PCNT_UNITS) return 0;
+
+  int16_t count = _pcnt[unit].count;
+  _pcnt[unit].count = 0;
+  return count;
+}
+
+uint8_t nativeGetPin(uint8_t pin)
+{
+  _initPins();
+  if (pin >= NATIVE_GPIO_COUNT) return LOW;
+  return _pinLevel[pin];
+}
+
+int nativeGetAnalog(uint8_t pin)
+{
+  if (pin >= NATIVE_GPIO_COUNT) return 0;
+  return _pinAnalog[pin];
+}
+
+uint32_t nativeReadRegister(uint8_t reg)
+{
+  _initPins();
+  return reg < 2 ? _registers[reg] : 0;
+}
+
+void nativeWriteRegister(uint8_t reg, uint32_t set, uint32_t clear)
+{
+  _initPins();
+  if (reg >= 2) return;
+
+  if (set)   { _writeCount++; }
+  if (clear) { _writeCount++; }
+
+  for (uint8_t bit = 0; bit < 32; bit++)
+  {
+    uint8_t pin = (reg * 32) + bit;
+    if (pin >= NATIVE_GPIO_COUNT) break;
+
+    if (bitRead(set, bit))   { _setLevel(pin, HIGH); }
+    if (bitRead(clear, bit)) { _setLevel(pin, LOW); }
+  }
+}
+
+uint32_t nativeGetWriteCount(void)
+{
+  return _writeCount;
+}
+
+uint32_t nativeGetFreeHeap(void)
+{
+  size_t used = mallinfo2().uordblks;
+  used = used > _heapBase ? used - _heapBase : 0;
+  return used < NATIVE_HEAP_SIZE ? NATIVE_HEAP_SIZE - used : 0;
+}
+
+uint32_t nativeGetStackFree(void)
+{
+  return NATIVE_STACK_SIZE;
+}
+
+void nativeSetQuiet(bool quiet)
+{
+  _quiet = quiet;
+}
+
+bool nativeGetQuiet(void)
+{
+  return _quiet;
+}
+
+size_t Print::write(const uint8_t * buffer, size_t size)
+{
+  size_t n = 0;
+  while (size--) { n += write(*buffer++); }
+  return n;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  if (!_quiet) { fputc(c, stdout); }
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t * buffer, size_t size)
+{
+  if (!_quiet) { fwrite(buffer, 1, size, stdout); }
+  return size;
+}
@@ -0,0 +1,206 @@
+/**
+  Host-native stand-in for the Arduino core
+
+  Just enough of the Arduino API for the firmware to compile and run on
+  a Linux host (see [env:native] in platformio.ini). Time is virtual, so
+  the benchmarks can drive the input/output handlers deterministically
+  without waiting on a real clock.
+*/
+
+#ifndef ARDUINO_NATIVE_H
+#define ARDUINO_NATIVE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+typedef bool    boolean;
+
+/*--------------------------- Constants -------------------------------*/
+#define       LOW                   0x0
+#define       HIGH                  0x1
+
+#define       INPUT                 0x01
+#define       OUTPUT                0x03
+#define       INPUT_PULLUP          0x05
+
+#define       RISING                0x01
+#define       FALLING               0x02
+#define       CHANGE                0x03
+
+// Number of simulated GPIOs (covers the ESP32 range 0-39)
+#define       NATIVE_GPIO_COUNT     40
+
+// Number of simulated pulse counter units (as on the ESP32), and the pin
+// number which leaves a unit unbound
+#define       NATIVE_PCNT_UNITS     8
+#define       NATIVE_PCNT_NO_PIN    0xff
+
+// Heap and loop task stack sizes reported to the firmware (mirrors the
+// ESP32 build - free internal heap after boot, and the Arduino loop task)
+#define       NATIVE_HEAP_SIZE      (256 * 1024)
+#define       NATIVE_STACK_SIZE     (8 * 1024)
+
+/*--------------------------- Flash/IRAM ------------------------------*/
+class __FlashStringHelper;
+
+#define       PROGMEM
+#define       IRAM_ATTR
+#define       PSTR(s)               (s)
+#define       F(s)                  (reinterpret_cast<const __FlashStringHelper *>(s))
+#define       sprintf_P             sprintf
+#define       snprintf_P            snprintf
+#define       strcmp_P              strcmp
+#define       strlen_P              strlen
+#define       memcpy_P              memcpy
+#define       pgm_read_byte(addr)   (*(const uint8_t *)(addr))
+#define       pgm_read_word(addr)   (*(const uint16_t *)(addr))
+#define       pgm_read_dword(addr)  (*(const uint32_t *)(addr))
+#define       pgm_read_ptr(addr)    (*(void * const *)(addr))
+
+/*--------------------------- Bit helpers -----------------------------*/
+#define       bitRead(value, bit)             (((value) >> (bit)) & 0x01)
+#define       bitSet(value, bit)              ((value) |= (1UL << (bit)))
+#define       bitClear(value, bit)            ((value) &= ~(1UL << (bit)))
+#define       bitWrite(value, bit, bitvalue)  ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+
+#define       constrain(amt, low, high)       ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+/*--------------------------- Time ------------------------------------*/
+uint32_t millis(void);
+uint32_t micros(void);
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield(void);
+
+/*--------------------------- GPIO ------------------------------------*/
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+
+/*--------------------------- Interrupts ------------------------------*/
+typedef void (*voidFuncPtr)(void);
+
+#define       digitalPinToInterrupt(p)  (p)
+
+void attachInterrupt(uint8_t pin, voidFuncPtr handler, int mode);
+void detachInterrupt(uint8_t pin);
+
+// Handlers are called from nativeSetPin(), never in the middle of
+// anything else, so there is nothing to hold off
+inline void noInterrupts(void) {}
+inline void interrupts(void) {}
+
+/*--------------------------- Print -----------------------------------*/
+class Print
+{
+  public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t * buffer, size_t size);
+    size_t write(const char * str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+
+    size_t print(const __FlashStringHelper * str) { return write(reinterpret_cast<const char *>(str)); }
+    size_t print(const char * str) { return write(str); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int n) { return printNumber("%d", n); }
+    size_t print(unsigned int n) { return printNumber("%u", n); }
+    size_t print(long n) { return printNumber("%ld", n); }
+    size_t print(unsigned long n) { return printNumber("%lu", n); }
+
+    size_t println(void) { return write("\r\n"); }
+    template <typename T>
+    size_t println(T value) { size_t n = print(value); return n + println(); }
+
+  private:
+    template <typename T>
+    size_t printNumber(const char * format, T n)
+    {
+      char buffer[24];
+      snprintf(buffer, sizeof(buffer), format, n);
+      return write(buffer);
+    }
+};
+
+class HardwareSerial : public Print
+{
+  public:
+    void begin(unsigned long baud) { (void)baud; }
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t * buffer, size_t size) override;
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+/*--------------------------- Simulation hooks ------------------------*/
+// Advance the virtual clock (delay() does this too)
+void nativeAdvanceMicros(uint32_t us);
+
+// Called once per elapsed millisecond as the virtual clock advances, so
+// pin streams can change state in the middle of a long delay or stall
+typedef void (*nativeTickCallback)(uint32_t ms);
+void nativeSetTickCallback(nativeTickCallback callback);
+
+// Periodic timer driven by the virtual clock, standing in for esp_timer
+// (ESP32) or os_timer (ESP8266) - one timer, restarted on each call
+void nativeStartTimer(uint32_t periodUs, voidFuncPtr callback);
+void nativeStopTimer(void);
+
+// Wake a nativeWaitNotify(), standing in for a FreeRTOS task notification
+void nativeNotify(void);
+
+// Advance the virtual clock until notified (returning immediately if
+// already) or the timeout expires, like ulTaskNotifyTake(pdTRUE, timeout)
+uint32_t nativeWaitNotify(uint32_t timeoutUs);
+
+// Drive the level seen by digitalRead() on a simulated input pin, firing
+// any interrupt attached to it
+void nativeSetPin(uint8_t pin, uint8_t level);
+
+// Pulse counter unit standing in for the ESP32 PCNT in quadrature mode -
+// counts rising edges of the pulse pin, up while the control pin is low
+// and down while it's high (there is no glitch filter)
+void nativePcntConfig(uint8_t unit, uint8_t pulsePin, uint8_t ctrlPin);
+
+// Read and clear a pulse counter unit
+int16_t nativePcntTake(uint8_t unit);
+
+// Read back the level last written to a simulated pin
+uint8_t nativeGetPin(uint8_t pin);
+
+// Read back the duty last written to a simulated pin with analogWrite()
+int nativeGetAnalog(uint8_t pin);
+
+// Pin levels packed like the ESP32 input registers (0 = GPIO 0-31, 1 = 32-39)
+uint32_t nativeReadRegister(uint8_t reg);
+
+// Set/clear pins like the ESP32 GPIO_OUT_W1TS/W1TC registers
+void nativeWriteRegister(uint8_t reg, uint32_t set, uint32_t clear);
+
+// Number of digitalWrite() calls and register writes since boot
+uint32_t nativeGetWriteCount(void);
+
+// Free heap - NATIVE_HEAP_SIZE less what the process has allocated since
+// startup (there is no fragmentation, so it is all one free block)
+uint32_t nativeGetFreeHeap(void);
+
+// Loop task stack never used - not simulated (host frames bear no relation
+// to the ESP32's), so always NATIVE_STACK_SIZE
+uint32_t nativeGetStackFree(void);
+
+// Silence everything printed to Serial (benchmarks run with this on)
+void nativeSetQuiet(bool quiet);
+bool nativeGetQuiet(void);
+
+#endif
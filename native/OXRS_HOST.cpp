@@ -0,0 +1,222 @@
+/**
+  Host-native stand-in for the OXRS hardware libraries (see OXRS_HOST.h)
+*/
+
+#include <OXRS_HOST.h>
+
+/*--------------------------- Global Variables ------------------------*/
+PubSubClient _mqttClient;
+OXRS_MQTT _mqtt;
+
+/*--------------------------- Program ---------------------------------*/
+static void _mqttCallback(char * topic, byte * payload, unsigned int length)
+{
+  // Pass down to the MQTT handler and check it was processed ok
+  int state = _mqtt.receive(topic, payload, length);
+  if (state == MQTT_RECEIVE_JSON_ERROR)
+  {
+    Serial.println(F("[native] failed to deserialise JSON"));
+  }
+}
+
+void Response::set(const char * name, const char * value)
+{
+}
+
+void Response::sendStatus(int code)
+{
+  _status = code;
+}
+
+size_t Response::write(uint8_t character)
+{
+  if (_length >= sizeof(_body) - 1) return 0;
+
+  _body[_length++] = character;
+  _body[_length] = 0;
+  return 1;
+}
+
+void Response::reset(void)
+{
+  _status = 200;
+  _length = 0;
+  _body[0] = 0;
+}
+
+int Response::getStatus(void)
+{
+  return _status;
+}
+
+const char * Response::getBody(void)
+{
+  return _body;
+}
+
+OXRS_HOST_API::OXRS_HOST_API()
+{
+  _count = 0;
+}
+
+void OXRS_HOST_API::get(const char * path, Middleware * middleware)
+{
+  if (_count >= NATIVE_API_ROUTES) return;
+
+  _paths[_count] = path;
+  _middleware[_count] = middleware;
+  _count++;
+}
+
+Middleware * OXRS_HOST_API::find(const char * path)
+{
+  for (uint8_t i = 0; i < _count; i++)
+  {
+    if (strcmp(_paths[i], path) == 0) return _middleware[i];
+  }
+  return NULL;
+}
+
+OXRS_HOST::OXRS_HOST()
+{
+  _onStatus = NULL;
+  _onTelemetry = NULL;
+
+  _connected = true;
+  _loopMicros = 0;
+
+  _statusCount = 0;
+  _telemetryCount = 0;
+  _lastStatus[0] = 0;
+
+  _configSchemaSize = 0;
+  _commandSchemaSize = 0;
+}
+
+void OXRS_HOST::begin(jsonCallback config, jsonCallback command)
+{
+  _mqtt.onConfig(config);
+  _mqtt.onCommand(command);
+  _mqttClient.setCallback(_mqttCallback);
+}
+
+void OXRS_HOST::loop(void)
+{
+  // Simulate the time the network stack would take on a real device
+  nativeAdvanceMicros(_loopMicros);
+}
+
+void OXRS_HOST::setConfigSchema(JsonVariant json)
+{
+  _configSchemaSize = measureJson(json);
+}
+
+void OXRS_HOST::setCommandSchema(JsonVariant json)
+{
+  _commandSchemaSize = measureJson(json);
+}
+
+boolean OXRS_HOST::publishStatus(JsonVariant json)
+{
+  if (!_connected) return false;
+
+  // Serialise just like the MQTT library would before handing off
+  size_t length = serializeJson(json, _lastStatus, sizeof(_lastStatus));
+  _statusCount++;
+
+  if (_onStatus) { _onStatus(_lastStatus, length); }
+  return true;
+}
+
+boolean OXRS_HOST::publishTelemetry(JsonVariant json)
+{
+  if (!_connected) return false;
+
+  char payload[NATIVE_PAYLOAD_SIZE];
+  size_t length = serializeJson(json, payload, sizeof(payload));
+  _telemetryCount++;
+
+  if (_onTelemetry) { _onTelemetry(payload, length); }
+  return true;
+}
+
+OXRS_HOST_API * OXRS_HOST::getAPI(void)
+{
+  return &_api;
+}
+
+size_t OXRS_HOST::write(uint8_t character)
+{
+  return Serial.write(character);
+}
+
+void OXRS_HOST::setConnected(bool connected)
+{
+  _connected = connected;
+}
+
+void OXRS_HOST::setLoopMicros(uint32_t us)
+{
+  _loopMicros = us;
+}
+
+void OXRS_HOST::setStatusCallback(publishCallback callback)
+{
+  _onStatus = callback;
+}
+
+void OXRS_HOST::setTelemetryCallback(publishCallback callback)
+{
+  _onTelemetry = callback;
+}
+
+void OXRS_HOST::injectConfig(const char * payload)
+{
+  _inject(NATIVE_CONFIG_TOPIC, payload);
+}
+
+void OXRS_HOST::injectCommand(const char * payload)
+{
+  _inject(NATIVE_COMMAND_TOPIC, payload);
+}
+
+const char * OXRS_HOST::injectApiGet(const char * path)
+{
+  Middleware * middleware = _api.find(path);
+  if (!middleware) return NULL;
+
+  Request request;
+  _response.reset();
+  middleware(request, _response);
+  return _response.getBody();
+}
+
+uint32_t OXRS_HOST::getStatusCount(void)
+{
+  return _statusCount;
+}
+
+uint32_t OXRS_HOST::getTelemetryCount(void)
+{
+  return _telemetryCount;
+}
+
+const char * OXRS_HOST::getLastStatus(void)
+{
+  return _lastStatus;
+}
+
+size_t OXRS_HOST::getConfigSchemaSize(void)
+{
+  return _configSchemaSize;
+}
+
+size_t OXRS_HOST::getCommandSchemaSize(void)
+{
+  return _commandSchemaSize;
+}
+
+void OXRS_HOST::_inject(const char * topic, const char * payload)
+{
+  nativeDeliverMqtt(_mqttClient, topic, payload, strlen(payload));
+}
@@ -0,0 +1,141 @@
+/**
+  Host-native stand-in for the OXRS hardware libraries
+
+  Mirrors the public API of OXRS_32/OXRS_8266/OXRS_LILYGOPOE that the
+  firmware uses, with hooks so a benchmark harness can inject config and
+  command payloads, capture status publishes and simulate the network.
+*/
+
+#ifndef OXRS_HOST_H
+#define OXRS_HOST_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <PubSubClient.h>
+#include <OXRS_MQTT.h>
+
+/*--------------------------- Constants -------------------------------*/
+// INT line of each simulated MCP23017 expander (mirrors the ESP32 build)
+#define       NATIVE_MCP_INT_PINS   { 34, 35, 36 }
+
+// Size of the buffer used to capture the last published payload
+#define       NATIVE_PAYLOAD_SIZE   1024
+
+// Number of REST API routes, and size of the captured response body (big
+// enough for a full input trace)
+#define       NATIVE_API_ROUTES     8
+#define       NATIVE_API_BODY_SIZE  16384
+
+/*--------------------------- Callbacks -------------------------------*/
+typedef void (*publishCallback)(const char * payload, size_t length);
+
+/*--------------------------- REST API --------------------------------*/
+// Just enough of the aWOT request/response used by OXRS_API handlers
+class Request
+{
+};
+
+class Response : public Print
+{
+  public:
+    void set(const char * name, const char * value);
+    void sendStatus(int code);
+
+    virtual size_t write(uint8_t);
+    using Print::write;
+
+    void reset(void);
+    int getStatus(void);
+    const char * getBody(void);
+
+  private:
+    int _status;
+    size_t _length;
+    char _body[NATIVE_API_BODY_SIZE];
+};
+
+typedef void Middleware(Request & request, Response & response);
+
+// Stand-in for OXRS_API, as returned by getAPI()
+class OXRS_HOST_API
+{
+  public:
+    OXRS_HOST_API();
+
+    void get(const char * path, Middleware * middleware);
+    Middleware * find(const char * path);
+
+  private:
+    const char * _paths[NATIVE_API_ROUTES];
+    Middleware * _middleware[NATIVE_API_ROUTES];
+    uint8_t _count;
+};
+
+class OXRS_HOST : public Print
+{
+  public:
+    OXRS_HOST();
+
+    void begin(jsonCallback config, jsonCallback command);
+    void loop(void);
+
+    // Firmware can define the config/commands it supports - for device discovery and adoption
+    void setConfigSchema(JsonVariant json);
+    void setCommandSchema(JsonVariant json);
+
+    // Helpers for publishing to stat/ and tele/ topics
+    boolean publishStatus(JsonVariant json);
+    boolean publishTelemetry(JsonVariant json);
+
+    // REST API, for firmware specific endpoints
+    OXRS_HOST_API * getAPI(void);
+
+    // Implement Print.h wrapper
+    virtual size_t write(uint8_t);
+    using Print::write;
+
+    // Simulation hooks
+    void setConnected(bool connected);
+    void setLoopMicros(uint32_t us);
+    void setStatusCallback(publishCallback callback);
+    void setTelemetryCallback(publishCallback callback);
+
+    // Delivered to the MQTT client as if from the broker, on the config
+    // or command topic
+    void injectConfig(const char * payload);
+    void injectCommand(const char * payload);
+
+    // GET a REST API path, returns the response body (NULL if no route)
+    const char * injectApiGet(const char * path);
+
+    uint32_t getStatusCount(void);
+    uint32_t getTelemetryCount(void);
+    const char * getLastStatus(void);
+    size_t getConfigSchemaSize(void);
+    size_t getCommandSchemaSize(void);
+
+  private:
+    publishCallback _onStatus;
+    publishCallback _onTelemetry;
+
+    bool _connected;
+    uint32_t _loopMicros;
+
+    uint32_t _statusCount;
+    uint32_t _telemetryCount;
+    char _lastStatus[NATIVE_PAYLOAD_SIZE];
+
+    size_t _configSchemaSize;
+    size_t _commandSchemaSize;
+
+    OXRS_HOST_API _api;
+    Response _response;
+
+    void _inject(const char * topic, const char * payload);
+};
+
+// The MQTT client and handler, globals just as in the OXRS libraries
+extern PubSubClient _mqttClient;
+extern OXRS_MQTT _mqtt;
+
+#endif
@@ -0,0 +1,51 @@
+/**
+  Host-native stand-in for the OXRS MQTT handler (see OXRS_MQTT.h)
+*/
+
+#include <OXRS_MQTT.h>
+
+OXRS_MQTT::OXRS_MQTT()
+{
+  _onConfig = NULL;
+  _onCommand = NULL;
+}
+
+char * OXRS_MQTT::getConfigTopic(char topic[])
+{
+  strcpy(topic, NATIVE_CONFIG_TOPIC);
+  return topic;
+}
+
+char * OXRS_MQTT::getCommandTopic(char topic[])
+{
+  strcpy(topic, NATIVE_COMMAND_TOPIC);
+  return topic;
+}
+
+void OXRS_MQTT::onConfig(jsonCallback callback)
+{
+  _onConfig = callback;
+}
+
+void OXRS_MQTT::onCommand(jsonCallback callback)
+{
+  _onCommand = callback;
+}
+
+int OXRS_MQTT::receive(char * topic, byte * payload, unsigned int length)
+{
+  if (length == 0) return MQTT_RECEIVE_ZERO_LENGTH;
+
+  bool config = strcmp(topic, NATIVE_CONFIG_TOPIC) == 0;
+  jsonCallback callback = config ? _onConfig : _onCommand;
+  if (!callback) return config ? MQTT_RECEIVE_NO_CONFIG_HANDLER : MQTT_RECEIVE_NO_COMMAND_HANDLER;
+
+  // Same as the library - parse into a document sized for the largest
+  // payload and hand it over
+  DynamicJsonDocument json(config ? JSON_CONFIG_MAX_SIZE : JSON_COMMAND_MAX_SIZE);
+  DeserializationError error = deserializeJson(json, payload, length);
+  if (error) return MQTT_RECEIVE_JSON_ERROR;
+
+  callback(json.as<JsonVariant>());
+  return MQTT_RECEIVE_OK;
+}
@@ -0,0 +1,56 @@
+/**
+  Host-native stand-in for the OXRS MQTT handler
+
+  Mirrors the part of OXRS_MQTT's API the firmware uses - the config and
+  command topics, and receive(), which parses a payload into a document
+  and hands it to the config/command callback just as the library does.
+*/
+
+#ifndef OXRS_MQTT_NATIVE_H
+#define OXRS_MQTT_NATIVE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/*--------------------------- Constants -------------------------------*/
+#ifndef JSON_CONFIG_MAX_SIZE
+#define       JSON_CONFIG_MAX_SIZE  16384
+#endif
+
+#ifndef JSON_COMMAND_MAX_SIZE
+#define       JSON_COMMAND_MAX_SIZE 16384
+#endif
+
+// Topics the stand-in's config/commands arrive on
+#define       NATIVE_CONFIG_TOPIC   "conf/native"
+#define       NATIVE_COMMAND_TOPIC  "cmnd/native"
+
+// Results of receive()
+#define       MQTT_RECEIVE_OK                   0
+#define       MQTT_RECEIVE_ZERO_LENGTH          1
+#define       MQTT_RECEIVE_JSON_ERROR           2
+#define       MQTT_RECEIVE_NO_CONFIG_HANDLER    3
+#define       MQTT_RECEIVE_NO_COMMAND_HANDLER   4
+
+/*--------------------------- Callbacks -------------------------------*/
+typedef void (*jsonCallback)(JsonVariant);
+
+class OXRS_MQTT
+{
+  public:
+    OXRS_MQTT();
+
+    char * getConfigTopic(char topic[]);
+    char * getCommandTopic(char topic[]);
+
+    void onConfig(jsonCallback callback);
+    void onCommand(jsonCallback callback);
+
+    int receive(char * topic, byte * payload, unsigned int length);
+
+  private:
+    jsonCallback _onConfig;
+    jsonCallback _onCommand;
+};
+
+#endif
@@ -0,0 +1,72 @@
+/**
+  Host-native stand-in for the ESP32 Preferences library (see Preferences.h)
+*/
+
+#include <Preferences.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/*--------------------------- Global Variables ------------------------*/
+// Stored blobs, keyed by "namespace/key"
+static std::map<std::string, std::vector<uint8_t>> _storage;
+
+static uint32_t _writes = 0;
+
+/*--------------------------- Program ---------------------------------*/
+static std::string _path(const char * name, const char * key)
+{
+  return std::string(name) + "/" + key;
+}
+
+bool Preferences::begin(const char * name, bool readOnly)
+{
+  snprintf(_name, sizeof(_name), "%s", name);
+  _readOnly = readOnly;
+  return true;
+}
+
+void Preferences::end(void)
+{
+}
+
+size_t Preferences::getBytesLength(const char * key)
+{
+  auto blob = _storage.find(_path(_name, key));
+  return blob == _storage.end() ? 0 : blob->second.size();
+}
+
+size_t Preferences::getBytes(const char * key, void * buffer, size_t maxLength)
+{
+  auto blob = _storage.find(_path(_name, key));
+  if (blob == _storage.end() || blob->second.size() > maxLength) return 0;
+
+  memcpy(buffer, blob->second.data(), blob->second.size());
+  return blob->second.size();
+}
+
+size_t Preferences::putBytes(const char * key, const void * value, size_t length)
+{
+  if (_readOnly) return 0;
+
+  const uint8_t * bytes = (const uint8_t *)value;
+  _storage[_path(_name, key)].assign(bytes, bytes + length);
+  _writes++;
+  return length;
+}
+
+bool Preferences::remove(const char * key)
+{
+  if (_readOnly) return false;
+  return _storage.erase(_path(_name, key)) > 0;
+}
+
+uint32_t nativeGetStorageWrites(void)
+{
+  return _writes;
+}
+
+void nativeClearStorage(void)
+{
+  _storage.clear();
+}
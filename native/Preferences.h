@@ -0,0 +1,36 @@
+/**
+  Host-native stand-in for the ESP32 Preferences (NVS) library
+
+  Keeps key/value blobs in memory for the life of the process, enough
+  to exercise the firmware's persisted config on the host.
+*/
+
+#ifndef PREFERENCES_NATIVE_H
+#define PREFERENCES_NATIVE_H
+
+#include <Arduino.h>
+
+class Preferences
+{
+  public:
+    bool begin(const char * name, bool readOnly = false);
+    void end(void);
+
+    size_t getBytesLength(const char * key);
+    size_t getBytes(const char * key, void * buffer, size_t maxLength);
+    size_t putBytes(const char * key, const void * value, size_t length);
+    bool remove(const char * key);
+
+  private:
+    char _name[16];
+    bool _readOnly;
+};
+
+/*--------------------------- Simulation hooks ------------------------*/
+// Number of putBytes() calls since boot (i.e. flash writes on a device)
+uint32_t nativeGetStorageWrites(void);
+
+// Forget everything stored, like erasing the NVS partition
+void nativeClearStorage(void);
+
+#endif
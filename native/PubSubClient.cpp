@@ -0,0 +1,21 @@
+/**
+  Host-native stand-in for the PubSubClient MQTT client (see PubSubClient.h)
+*/
+
+#include <PubSubClient.h>
+#include <vector>
+
+PubSubClient & PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE)
+{
+  this->callback = callback;
+  return *this;
+}
+
+void nativeDeliverMqtt(PubSubClient & client, const char * topic, const char * payload, size_t length)
+{
+  if (!client.callback) return;
+
+  std::vector<char> topicBuffer(topic, topic + strlen(topic) + 1);
+  std::vector<uint8_t> buffer(payload, payload + length);
+  client.callback(topicBuffer.data(), buffer.data(), length);
+}
@@ -0,0 +1,33 @@
+/**
+  Host-native stand-in for the PubSubClient MQTT client
+
+  Just the message callback the OXRS library registers, which firmware
+  can replace to see a payload in the client's buffer before it is
+  parsed, and a hook to deliver messages as if from the broker.
+*/
+
+#ifndef PUBSUBCLIENT_NATIVE_H
+#define PUBSUBCLIENT_NATIVE_H
+
+#include <Arduino.h>
+#include <functional>
+
+#define       MQTT_CALLBACK_SIGNATURE std::function<void(char *, uint8_t *, unsigned int)> callback
+
+class PubSubClient
+{
+  public:
+    PubSubClient & setCallback(MQTT_CALLBACK_SIGNATURE);
+
+  private:
+    MQTT_CALLBACK_SIGNATURE;
+
+    friend void nativeDeliverMqtt(PubSubClient & client, const char * topic, const char * payload, size_t length);
+};
+
+/*--------------------------- Simulation hooks ------------------------*/
+// Hand a message to the client's callback, from a copy of the payload
+// (not null terminated) like the client's own receive buffer
+void nativeDeliverMqtt(PubSubClient & client, const char * topic, const char * payload, size_t length);
+
+#endif
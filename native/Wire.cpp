@@ -0,0 +1,292 @@
+/**
+  Host-native stand-in for the Arduino Wire (I2C) library (see Wire.h)
+*/
+
+#include <Wire.h>
+
+TwoWire Wire;
+
+/*--------------------------- Constants -------------------------------*/
+// MCP23017 registers (IOCON.BANK = 0, so each A/B pair is adjacent)
+#define       MCP_REGISTERS         0x16
+#define       MCP_IODIRA            0x00
+#define       MCP_IPOLA             0x02
+#define       MCP_GPINTENA          0x04
+#define       MCP_IOCON             0x0A
+#define       MCP_IOCONB            0x0B
+#define       MCP_INTFA             0x0E
+#define       MCP_INTCAPA           0x10
+#define       MCP_GPIOA             0x12
+#define       MCP_OLATA             0x14
+
+#define       MCP_IOCON_MIRROR      0x40
+
+/*--------------------------- Global Variables ------------------------*/
+struct _mcp_t
+{
+  uint8_t address;
+  uint8_t intPin;
+  uint8_t reg[MCP_REGISTERS];
+  uint16_t external;
+  uint8_t pointer;
+};
+
+static _mcp_t _mcp[NATIVE_I2C_DEVICES];
+static uint8_t _mcpCount = 0;
+
+static uint32_t _transfers = 0;
+static uint64_t _busNanos = 0;
+static uint64_t _busNanosAdvanced = 0;
+
+/*--------------------------- Program ---------------------------------*/
+static _mcp_t * _findMcp(uint8_t address)
+{
+  for (uint8_t i = 0; i < _mcpCount; i++)
+  {
+    if (_mcp[i].address == address) return &_mcp[i];
+  }
+  return NULL;
+}
+
+static uint16_t _getPair(_mcp_t * mcp, uint8_t reg)
+{
+  return mcp->reg[reg] | (mcp->reg[reg + 1] << 8);
+}
+
+static void _setPair(_mcp_t * mcp, uint8_t reg, uint16_t value)
+{
+  mcp->reg[reg] = value & 0xff;
+  mcp->reg[reg + 1] = value >> 8;
+}
+
+// Level on each pin as read through GPIO - inputs see the external level
+// (inverted by IPOL), outputs read back their latch
+static uint16_t _readGpio(_mcp_t * mcp)
+{
+  uint16_t iodir = _getPair(mcp, MCP_IODIRA);
+  uint16_t inputs = _getPair(mcp, MCP_IPOLA) ^ mcp->external;
+  return (inputs & iodir) | (_getPair(mcp, MCP_OLATA) & ~iodir);
+}
+
+// INT is active low, and with MIRROR set reflects both ports
+static void _updateInt(_mcp_t * mcp)
+{
+  bool active = mcp->reg[MCP_INTFA] ||
+    ((mcp->reg[MCP_IOCON] & MCP_IOCON_MIRROR) && mcp->reg[MCP_INTFA + 1]);
+
+  nativeSetPin(mcp->intPin, active ? LOW : HIGH);
+}
+
+static void _writeRegister(_mcp_t * mcp, uint8_t reg, uint8_t value)
+{
+  switch (reg)
+  {
+    // IOCON has two addresses for the same register
+    case MCP_IOCON:
+    case MCP_IOCONB:
+      mcp->reg[MCP_IOCON] = mcp->reg[MCP_IOCONB] = value;
+      break;
+
+    // Read only
+    case MCP_INTFA:
+    case MCP_INTFA + 1:
+    case MCP_INTCAPA:
+    case MCP_INTCAPA + 1:
+      break;
+
+    // Writing GPIO writes the output latch
+    case MCP_GPIOA:
+    case MCP_GPIOA + 1:
+      mcp->reg[reg + 2] = value;
+      break;
+
+    default:
+      mcp->reg[reg] = value;
+      break;
+  }
+}
+
+static uint8_t _readRegister(_mcp_t * mcp, uint8_t reg)
+{
+  uint8_t port = reg & 1;
+
+  switch (reg)
+  {
+    // Reading GPIO or INTCAP clears the port's interrupt
+    case MCP_GPIOA:
+    case MCP_GPIOA + 1:
+      mcp->reg[MCP_INTFA + port] = 0;
+      _updateInt(mcp);
+      return (_readGpio(mcp) >> (8 * port)) & 0xff;
+
+    case MCP_INTCAPA:
+    case MCP_INTCAPA + 1:
+      mcp->reg[MCP_INTFA + port] = 0;
+      _updateInt(mcp);
+      return mcp->reg[reg];
+
+    default:
+      return mcp->reg[reg];
+  }
+}
+
+// A start (or repeated start), the address and data bytes each with their
+// ack bit, then an optional stop - all at the bus clock rate
+void TwoWire::busTime(uint8_t bytes, bool stop)
+{
+  _transfers++;
+
+  uint32_t bits = 1 + (9 * (1 + bytes)) + (stop ? 1 : 0);
+  _busNanos += ((uint64_t)bits * 1000000000) / _frequency;
+
+  uint64_t micros = (_busNanos - _busNanosAdvanced) / 1000;
+  _busNanosAdvanced += micros * 1000;
+  nativeAdvanceMicros((uint32_t)micros);
+}
+
+bool TwoWire::begin(int sda, int scl, uint32_t frequency)
+{
+  (void)sda;
+  (void)scl;
+  if (frequency) { setClock(frequency); }
+  return true;
+}
+
+void TwoWire::setClock(uint32_t frequency)
+{
+  if (frequency) { _frequency = frequency; }
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+  _address = address;
+  _txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+  if (_txLength >= NATIVE_I2C_BUFFER) return 0;
+  _txBuffer[_txLength++] = data;
+  return 1;
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop)
+{
+  _mcp_t * mcp = _findMcp(_address);
+  if (!mcp)
+  {
+    // Address NACK
+    busTime(0, true);
+    return 2;
+  }
+
+  busTime(_txLength, sendStop);
+
+  // First byte sets the register pointer, the rest are written from there
+  // with the pointer incrementing (and wrapping) after each
+  for (uint8_t i = 0; i < _txLength; i++)
+  {
+    if (i == 0)
+    {
+      mcp->pointer = _txBuffer[0] % MCP_REGISTERS;
+      continue;
+    }
+
+    _writeRegister(mcp, mcp->pointer, _txBuffer[i]);
+    mcp->pointer = (mcp->pointer + 1) % MCP_REGISTERS;
+  }
+
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, bool sendStop)
+{
+  _rxLength = 0;
+  _rxIndex = 0;
+
+  _mcp_t * mcp = _findMcp(address);
+  if (!mcp)
+  {
+    busTime(0, true);
+    return 0;
+  }
+
+  quantity = min(quantity, (uint8_t)NATIVE_I2C_BUFFER);
+  busTime(quantity, sendStop);
+
+  while (_rxLength < quantity)
+  {
+    _rxBuffer[_rxLength++] = _readRegister(mcp, mcp->pointer);
+    mcp->pointer = (mcp->pointer + 1) % MCP_REGISTERS;
+  }
+
+  return _rxLength;
+}
+
+int TwoWire::available(void)
+{
+  return _rxLength - _rxIndex;
+}
+
+int TwoWire::read(void)
+{
+  if (_rxIndex >= _rxLength) return -1;
+  return _rxBuffer[_rxIndex++];
+}
+
+void nativeMcpAttach(uint8_t address, uint8_t intPin)
+{
+  if (_findMcp(address) || _mcpCount >= NATIVE_I2C_DEVICES) return;
+
+  // Power-on state - every pin an input, pulled high externally
+  _mcp_t * mcp = &_mcp[_mcpCount++];
+  memset(mcp, 0, sizeof(_mcp_t));
+  mcp->address = address;
+  mcp->intPin = intPin;
+  _setPair(mcp, MCP_IODIRA, 0xffff);
+  mcp->external = 0xffff;
+
+  nativeSetPin(intPin, HIGH);
+}
+
+void nativeMcpSetPin(uint8_t address, uint8_t pin, uint8_t level)
+{
+  _mcp_t * mcp = _findMcp(address);
+  if (!mcp || pin > 15) return;
+
+  uint16_t before = _readGpio(mcp);
+  bitWrite(mcp->external, pin, level ? 1 : 0);
+  uint16_t after = _readGpio(mcp);
+
+  // Interrupt-on-change (INTCON = 0) compares against the previous level,
+  // capturing the port as it was when the first change was flagged
+  uint16_t changed = (before ^ after) & _getPair(mcp, MCP_GPINTENA) & _getPair(mcp, MCP_IODIRA);
+  if (!changed) return;
+
+  uint8_t port = pin >> 3;
+  if (!mcp->reg[MCP_INTFA + port])
+  {
+    mcp->reg[MCP_INTCAPA + port] = (after >> (8 * port)) & 0xff;
+  }
+  mcp->reg[MCP_INTFA + port] |= (changed >> (8 * port)) & 0xff;
+
+  _updateInt(mcp);
+}
+
+uint8_t nativeMcpGetPin(uint8_t address, uint8_t pin)
+{
+  _mcp_t * mcp = _findMcp(address);
+  if (!mcp || pin > 15) return LOW;
+
+  return bitRead(_readGpio(mcp), pin);
+}
+
+uint32_t nativeI2cGetTransfers(void)
+{
+  return _transfers;
+}
+
+uint32_t nativeI2cGetBusMicros(void)
+{
+  return (uint32_t)(_busNanos / 1000);
+}
@@ -0,0 +1,73 @@
+/**
+  Host-native stand-in for the Arduino Wire (I2C) library
+
+  A mock bus with simulated MCP23017 expanders on it, so the expander
+  scan path can run without hardware. Every transfer advances the
+  virtual clock by the time it would take on the wire at the configured
+  clock rate, so bus time shows up in loop() timing like it would on a
+  real device (Wire blocks until the transfer completes).
+*/
+
+#ifndef WIRE_NATIVE_H
+#define WIRE_NATIVE_H
+
+#include <Arduino.h>
+
+/*--------------------------- Constants -------------------------------*/
+// Most devices on the mock bus
+#define       NATIVE_I2C_DEVICES    8
+
+// Address of an MCP23017 with A0-A2 tied low
+#define       NATIVE_MCP23017_ADDRESS 0x20
+
+// Bytes buffered per transfer, as on the ESP32
+#define       NATIVE_I2C_BUFFER     128
+
+/*--------------------------- Wire ------------------------------------*/
+class TwoWire
+{
+  public:
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0);
+    void setClock(uint32_t frequency);
+
+    void beginTransmission(uint8_t address);
+    size_t write(uint8_t data);
+    uint8_t endTransmission(bool sendStop = true);
+
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, bool sendStop = true);
+    int available(void);
+    int read(void);
+
+  private:
+    uint32_t _frequency = 100000;
+
+    uint8_t _address = 0;
+    uint8_t _txBuffer[NATIVE_I2C_BUFFER];
+    uint8_t _txLength = 0;
+
+    uint8_t _rxBuffer[NATIVE_I2C_BUFFER];
+    uint8_t _rxLength = 0;
+    uint8_t _rxIndex = 0;
+
+    void busTime(uint8_t bytes, bool stop);
+};
+
+extern TwoWire Wire;
+
+/*--------------------------- Simulation hooks ------------------------*/
+// Put a simulated MCP23017 on the bus, with its (mirrored, active low,
+// push-pull) INT output driving a simulated GPIO
+void nativeMcpAttach(uint8_t address, uint8_t intPin);
+
+// Drive the level on an expander pin (0-7 = GPA0-7, 8-15 = GPB0-7),
+// raising INT if it's an input with interrupt-on-change enabled
+void nativeMcpSetPin(uint8_t address, uint8_t pin, uint8_t level);
+
+// Read back the level an expander is driving on an output pin
+uint8_t nativeMcpGetPin(uint8_t address, uint8_t pin);
+
+// Transfers (a start or repeated start) and time on the wire since boot
+uint32_t nativeI2cGetTransfers(void);
+uint32_t nativeI2cGetBusMicros(void);
+
+#endif
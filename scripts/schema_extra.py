@@ -0,0 +1,388 @@
+#
+# Generates the config and command JSON schemas at build time
+#
+# The firmware used to build these with ArduinoJson calls at every boot,
+# into documents of the library's largest payload size. Instead they are
+# rendered here, for the pin map of the board being built, into a header
+# of PROGMEM JSON blobs. The OXRS library still takes each schema as a
+# JsonVariant, so the firmware deserializes the blob into a document at
+# boot - exactly sized for it, and freed once handed over - it is just no
+# longer built by hand.
+#
+# The ESP8266 still gets a cut-down schema (no titles, descriptions or
+# per-type dependencies), as the full one doesn't fit the OXRS library's
+# buffers there.
+#
+# This is the source of truth for both schemas - edit them here.
+#
+# Can also be run standalone, e.g. for a host build outside PlatformIO:
+#   python scripts/schema_extra.py <output dir> [-DDEFINE[=VALUE] ...]
+#
+import json
+import os
+import re
+import sys
+
+# The pin map, shared with the firmware - each board's native GPIOs are
+# listed in <board>_GPIOS (or <board>_MCP_GPIOS, if expanders take some
+# for I2C), followed by 16 more per MCP23017 expander from MCP_PIN_BASE
+PIN_MAP_HEADER = "gpio_pins.h"
+
+# Defaults for any build flags the schemas depend on
+DEFAULTS = {
+  "BATCH_MAX_EVENTS": 16,
+  "RULES_PER_INPUT": 4,
+}
+
+INPUT_TYPES = ["button", "contact", "press", "rotary", "security", "switch", "toggle", "counter"]
+OUTPUT_TYPES = ["relay", "motor", "timer", "pwm"]
+
+# Every event an input can raise, by input type (see INPUT_NAMES in src/main.cpp)
+INPUT_EVENTS = [
+  "hold", "single", "double", "triple", "quad", "penta",
+  "closed", "open",
+  "press",
+  "up", "down",
+  "normal", "alarm", "tamper", "short", "fault",
+  "on", "off",
+  "toggle",
+]
+
+RULE_ACTIONS = ["on", "off", "toggle", "pulse"]
+
+def read_pin_map(include_dir):
+  with open(os.path.join(include_dir, PIN_MAP_HEADER)) as header:
+    return {name: value.strip() for name, value in re.findall(r"^#define\s+(\w+)[ \t]+(.*)$", header.read(), re.M)}
+
+def pin_list(pin_map, name):
+  return [int(pin) for pin in pin_map[name].split(",")]
+
+def gpio_pins(pin_map, board, defines):
+  if "MCP_EXPANDERS" not in defines:
+    return pin_list(pin_map, board + "_GPIOS")
+
+  pins = pin_list(pin_map, board + "_MCP_GPIOS" if board + "_MCP_GPIOS" in pin_map else board + "_GPIOS")
+  expanders = int(defines["MCP_EXPANDERS"] or 1)
+  base = int(pin_map["MCP_PIN_BASE"])
+  return pins + [base + 16 * expander + pin for expander in range(expanders) for pin in range(16)]
+
+def titled(title, schema, description=None):
+  result = {"title": title}
+  if description:
+    result["description"] = description
+  result.update(schema)
+  return result
+
+def input_config_schema(defines):
+  schema = {
+    "type": titled("Type (defaults to 'switch')", {"enum": INPUT_TYPES}),
+    "invert": titled("Invert", {"type": "boolean"}),
+    "disabled": titled("Disabled", {"type": "boolean"}),
+    "rateLimit": titled("Rate limit (events per second, defaults to 0 - disabled)", {"type": "integer", "minimum": 0, "maximum": 255},
+      "An input raising events faster than this (after its burst) is suppressed, with a 'suppressed' event, and its events are dropped and not run through any local rules. Once its rate has stayed under the limit for long enough to refill its burst it is released, with a 'released' event reporting the 'count' of events dropped and 'durationSeconds' suppressed."),
+    "burst": titled("Burst (events, defaults to 10)", {"type": "integer", "minimum": 1, "maximum": 255}),
+  }
+
+  if "PCNT_ROTARY" in defines:
+    schema["pcnt"] = titled("Hardware Counter", {"type": "boolean"},
+      "Decode a 'rotary' input with a hardware pulse counter, using this GPIO and the next one in the list (which must also be an input). Steps are reported as 'up'/'down' events with a 'count', once per interval.")
+
+  return schema
+
+def output_config_schema(defines, pins):
+  return {
+    "type": titled("Type (defaults to 'relay')", {"enum": OUTPUT_TYPES}),
+    "timerSeconds": titled("Timer (seconds, defaults to 60s)", {"type": "integer", "minimum": 1}),
+    "interlockGpio": titled("Interlock GPIO", {"enum": pins}),
+    "frequencyHz": titled("PWM Frequency (Hz, defaults to 5000Hz)", {"type": "integer", "minimum": 1, "maximum": 40000}),
+    "resolutionBits": titled("PWM Resolution (bits, defaults to 10)", {"type": "integer", "minimum": 1, "maximum": 14}),
+  }
+
+def failover_config_schema(defines):
+  return {
+    "dropPolicy": titled("When full, drop (defaults to 'oldest')", {"enum": ["oldest", "newest"]}),
+    "replayIntervalMs": titled("Replay interval (milliseconds, defaults to 20ms)", {"type": "integer", "minimum": 0}),
+  }
+
+def counter_config_schema(defines):
+  return {
+    "intervalSeconds": titled("Publish interval (seconds, defaults to 60s, 0 to only publish on delta)", {"type": "integer", "minimum": 0}),
+    "delta": titled("Publish after this many pulses (defaults to 0 - disabled)", {"type": "integer", "minimum": 0}),
+    "debounceMs": titled("Debounce (milliseconds, defaults to 10ms)", {"type": "integer", "minimum": 0, "maximum": 1000}),
+  }
+
+def batch_config_schema(defines):
+  return {
+    "windowMs": titled("Window (milliseconds, defaults to 0 - disabled)", {"type": "integer", "minimum": 0, "maximum": 1000}),
+    "maxEvents": titled("Max events per publish", {"type": "integer", "minimum": 1, "maximum": int(defines["BATCH_MAX_EVENTS"])}),
+  }
+
+def rule_config_schema(defines, pins):
+  return {
+    "inputGpio": titled("Input GPIO", {"enum": pins}),
+    "event": titled("Input Event", {"enum": INPUT_EVENTS}),
+    "outputGpio": titled("Output GPIO", {"enum": pins}),
+    "action": titled("Action", {"enum": RULE_ACTIONS}),
+    "pulseMs": titled("Pulse (milliseconds, defaults to 500ms)", {"type": "integer", "minimum": 1, "maximum": 65535}),
+  }
+
+def profiler_config_schema(defines):
+  return {
+    "deadlineUs": titled("Loop deadline (microseconds, defaults to 10000us)", {"type": "integer", "minimum": 1}),
+    "intervalSeconds": titled("Publish interval (seconds, defaults to 60s, 0 to only publish on demand)", {"type": "integer", "minimum": 0}),
+  }
+
+def memory_config_schema(defines):
+  return {
+    "intervalSeconds": titled("Publish interval (seconds, defaults to 60s, 0 to only publish on demand or alarm)", {"type": "integer", "minimum": 0}),
+    "freeHeap": titled("Free heap alarm (bytes, defaults to 0 - disabled)", {"type": "integer", "minimum": 0}),
+    "largestBlock": titled("Largest free block alarm (bytes, defaults to 0 - disabled)", {"type": "integer", "minimum": 0}),
+    "stackFree": titled("Loop stack alarm (bytes, defaults to 0 - disabled)", {"type": "integer", "minimum": 0}),
+  }
+
+def pcnt_config_schema(defines):
+  return {
+    "intervalMs": titled("Report interval (milliseconds, defaults to 100ms)", {"type": "integer", "minimum": 10, "maximum": 60000}),
+  }
+
+def gpio_type_dependency(gpio_type, schema):
+  return {
+    "properties": {
+      "type": {"enum": [gpio_type]},
+      gpio_type: schema,
+    }
+  }
+
+def config_schema(defines, pins):
+  input_schema = titled("Input", {"type": "object", "properties": input_config_schema(defines)})
+  output_schema = titled("Output", {"type": "object", "properties": output_config_schema(defines, pins)})
+
+  gpio_schema = {
+    "type": "object",
+    "properties": {
+      "gpio": titled("GPIO Pin", {"enum": pins}),
+      "type": titled("GPIO Type", {"enum": ["input", "output"]}),
+    },
+    "dependencies": {
+      "type": {
+        "oneOf": [
+          gpio_type_dependency("input", input_schema),
+          gpio_type_dependency("output", output_schema),
+        ]
+      }
+    },
+    "required": ["gpio", "type"],
+  }
+
+  # The UI schema dependencies are too big for an ESP8266, list input and
+  # output as plain (optional) properties instead
+  if "OXRS_ESP8266" in defines:
+    del gpio_schema["dependencies"]
+    gpio_schema["properties"]["input"] = input_schema
+    gpio_schema["properties"]["output"] = output_schema
+
+  schema = {
+    "gpios": titled("GPIO Configuration", {
+      "type": "array",
+      "items": gpio_schema,
+    }, "Add configuration for each GPIO in use on your device."),
+    "rules": titled("Local Rules", {
+      "type": "array",
+      "items": {
+        "type": "object",
+        "properties": rule_config_schema(defines, pins),
+        "required": ["inputGpio", "event", "outputGpio", "action"],
+      },
+    }, "Drive outputs directly from input events on this device, without a round trip through MQTT, so they keep working while the broker is unavailable. Rules for the same input, event and action may list several outputs, as may rules for the same input, action and outputs list several events. Each input can have up to %d such rules. Sending 'rules' replaces all existing rules." % int(defines["RULES_PER_INPUT"])),
+    "failover": titled("Failover Queue", {
+      "type": "object",
+      "properties": failover_config_schema(defines),
+    }, "Status events which fail to publish are queued and replayed, in order, once publishing succeeds again."),
+    "counter": titled("Counter Inputs", {
+      "type": "object",
+      "properties": counter_config_schema(defines),
+    }, "Inputs of type 'counter' count pulses (e.g. from S0 energy or water meters) and publish their 'total', the 'delta' since the last publish and the 'rate' (pulses/hour). Totals are persisted across reboots."),
+    "batch": titled("Batch Publishing", {
+      "type": "object",
+      "properties": batch_config_schema(defines),
+    }, "Coalesce status events raised within the window (or up to the max events) into a single publish, with an 'events' array."),
+  }
+
+  if "PCNT_ROTARY" in defines:
+    schema["pcnt"] = titled("Hardware Rotary Counters", {
+      "type": "object",
+      "properties": pcnt_config_schema(defines),
+    }, "Rotary inputs decoded by a hardware pulse counter report their accumulated steps once per interval.")
+
+  if "LOOP_PROFILER" in defines:
+    schema["profiler"] = titled("Loop Profiler", {
+      "type": "object",
+      "properties": profiler_config_schema(defines),
+    }, "Per-stage loop timings, deadline overruns and input scan jitter, published as telemetry.")
+
+  if "MEMORY_STATS" in defines:
+    schema["memory"] = titled("Memory Stats", {
+      "type": "object",
+      "properties": memory_config_schema(defines),
+    }, "Free heap, largest free block, minimum free heap, loop stack high-water mark and the peak heap/stack used by the schema, config, command and publish paths, published as telemetry. An alarm is raised (and the stats published) when a gauge falls below its threshold, and cleared when it recovers.")
+
+  return schema
+
+def command_schema(defines, pins):
+  schema = {
+    "gpios": titled("GPIO Commands", {
+      "type": "array",
+      "items": {
+        "type": "object",
+        "properties": {
+          "gpio": titled("GPIO Pin", {"enum": pins}),
+          "type": titled("Type", {"enum": OUTPUT_TYPES}),
+          "command": titled("Command", {"type": "string", "enum": ["query", "on", "off", "level", "fade"]}),
+          "level": titled("Level (%)", {"type": "integer", "minimum": 0, "maximum": 100}),
+          "fadeMs": titled("Fade Time (milliseconds)", {"type": "integer", "minimum": 0}),
+        },
+        "required": ["gpio", "command"],
+      },
+    }, "Send commands to one or more GPIOs on your device. You can only send commands to GPIOs which have been configured as 'output'. The type is used to validate the configuration for this output matches the command. Supported commands are 'on' or 'off' to change the output state, or 'query' to publish the current state to MQTT. 'pwm' outputs also accept 'level' (set immediately) and 'fade' (over 'fadeMs'), with the level published once it has been reached."),
+    "counters": titled("Counter Totals", {
+      "type": "array",
+      "items": {
+        "type": "object",
+        "properties": {
+          "gpio": titled("GPIO Pin", {"enum": pins}),
+          "total": titled("Total", {"type": "integer", "minimum": 0, "maximum": 4294967295}),
+        },
+        "required": ["gpio", "total"],
+      },
+    }, "Set the total of one or more 'counter' inputs, e.g. to match the meter reading."),
+    "mask": titled("GPIO Mask", {"type": "string", "pattern": "^(0[xX][0-9a-fA-F]+|[0-9]+)$"},
+      "Bitmap selecting GPIOs for 'command', bit 0 is the first GPIO Pin listed above, e.g. '0x00ff'. GPIOs not configured as 'output' are ignored."),
+    "command": titled("Mask Command", {"enum": ["query", "on", "off"]},
+      "Switch every output in 'mask' 'on' or 'off' (publishing their events together), or 'query' to publish a snapshot of every GPIO."),
+    "query": titled("Query", {"enum": ["all"]},
+      "Publish a snapshot of every GPIO in a single status event - bitmaps of the 'inputs' and 'outputs', and their 'state' (set if active/on)."),
+  }
+
+  if "LOOP_PROFILER" in defines:
+    schema["profiler"] = titled("Loop Profiler", {"enum": ["query", "reset"]},
+      "Publish the loop profiler stats now ('query'), or start a new window ('reset').")
+
+  if "MEMORY_STATS" in defines:
+    schema["memory"] = titled("Memory Stats", {"enum": ["query", "reset"]},
+      "Publish the memory stats now ('query'), or clear the peaks and minimum free heap ('reset').")
+
+  return schema
+
+def untitled(value, properties=False):
+  # Drop every title and description (but not properties with those names)
+  if isinstance(value, dict):
+    return {key: untitled(child, key == "properties" and not properties)
+            for key, child in value.items()
+            if properties or key not in ("title", "description")}
+  if isinstance(value, list):
+    return [untitled(child) for child in value]
+  return value
+
+def measure(value):
+  # ArduinoJson capacity - one slot per member/element, plus every key and
+  # string copied with its terminator (an upper bound, strings are deduped)
+  slots, strings, depth = 0, 0, 0
+  if isinstance(value, dict):
+    for key, child in value.items():
+      s, b, d = measure(child)
+      slots, strings, depth = slots + 1 + s, strings + len(key.encode()) + 1 + b, max(depth, d)
+    depth += 1
+  elif isinstance(value, list):
+    for child in value:
+      s, b, d = measure(child)
+      slots, strings, depth = slots + 1 + s, strings + b, max(depth, d)
+    depth += 1
+  elif isinstance(value, str):
+    strings = len(value.encode()) + 1
+  return slots, strings, depth
+
+def render_schema(name, schema):
+  text = json.dumps(schema, separators=(",", ":"))
+  assert ')json"' not in text
+  slots, strings, depth = measure(schema)
+  return "\n".join([
+    "#define       %s_CAPACITY  (JSON_ARRAY_SIZE(%d) + %d)" % (name, slots, strings),
+    "#define       %s_NESTING   %d" % (name, depth),
+    "static const char %s[] PROGMEM = R\"json(%s)json\";" % (name, text),
+  ])
+
+def render(defines, pin_map):
+  board = next((name[:-len("_GPIOS")] for name in pin_map
+                if name.endswith("_GPIOS") and name[:-len("_GPIOS")] in defines), None)
+  if board is None:
+    raise SystemExit("schema_extra.py: no OXRS_* board defined, can't pick a pin map")
+
+  # Feature flags are passed through, along with any overridden defaults
+  settings = dict(defines)
+  settings.update({key: value for key, value in DEFAULTS.items() if defines.get(key) is None})
+
+  # As in the firmware, three expanders leave the config store room for fewer rules
+  if defines.get("RULES_PER_INPUT") is None and int(defines.get("MCP_EXPANDERS") or 0) == 3:
+    settings["RULES_PER_INPUT"] = 3
+
+  pins = gpio_pins(pin_map, board, defines)
+  schemas = [config_schema(settings, pins), command_schema(settings, pins)]
+
+  # Only an ESP32 has the room for titles and descriptions
+  if board == "OXRS_ESP8266":
+    schemas = [untitled(schema) for schema in schemas]
+
+  return "\n".join([
+    "// Generated by scripts/schema_extra.py for %s - do not edit" % board,
+    "#ifndef SCHEMA_H",
+    "#define SCHEMA_H",
+    "",
+    render_schema("CONFIG_SCHEMA", schemas[0]),
+    "",
+    render_schema("COMMAND_SCHEMA", schemas[1]),
+    "",
+    "#endif",
+    "",
+  ])
+
+def write(output_dir, include_dir, defines):
+  os.makedirs(output_dir, exist_ok=True)
+  path = os.path.join(output_dir, "schema.h")
+  header = render(defines, read_pin_map(include_dir))
+
+  # Only touch the header if it changed, to avoid needless rebuilds
+  if os.path.exists(path):
+    with open(path) as existing:
+      if existing.read() == header:
+        return path
+
+  with open(path, "w") as output:
+    output.write(header)
+  return path
+
+def parse_defines(cppdefines):
+  defines = {}
+  for define in cppdefines:
+    if isinstance(define, (list, tuple)):
+      defines[define[0]] = define[1] if len(define) > 1 else None
+    else:
+      name, _, value = str(define).partition("=")
+      defines[name] = value or None
+  return defines
+
+try:
+  Import("env")
+except NameError:
+  env = None
+
+if env is not None:
+  # Pre-scripts run before build_flags are folded into CPPDEFINES
+  defines = parse_defines(env.get("CPPDEFINES", []))
+  defines.update(parse_defines(env.ParseFlags(env.get("BUILD_FLAGS", [])).get("CPPDEFINES", [])))
+
+  output_dir = os.path.join(env.subst("$BUILD_DIR"), "schema")
+  print("Schema: %s" % write(output_dir, env.subst("$PROJECT_INCLUDE_DIR"), defines))
+  env.Append(CPPPATH=[output_dir])
+elif __name__ == "__main__":
+  include_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir, "include")
+  write(sys.argv[1], include_dir, parse_defines(arg[2:] for arg in sys.argv[2:] if arg.startswith("-D")))
@@ -0,0 +1,392 @@
+/**
+  Counter inputs (see digio.h)
+*/
+
+#include "digio.h"
+
+/*--------------------------- Global Variables ------------------------*/
+// Counter input totals, as persisted across reboots
+struct counterStore_t
+{
+  uint16_t magic;
+  uint8_t version;
+  uint8_t count;
+  uint32_t totals[GPIO_COUNT];
+};
+
+counterStore_t counterStored;
+uint32_t counterLastSave = 0;
+
+// Bit per GPIO index, set if a counter input is counting, and if that
+// counter's input is active/inverted as last seen by the ISR
+volatile gpioWord_t counterMask = 0;
+volatile gpioWord_t counterActive = 0;
+volatile gpioWord_t counterInvert = 0;
+
+#if defined(ESP32)
+// Taken by the counter ISR while it counts, and by the network task to
+// change a total, the ISR may be running on the other core
+portMUX_TYPE counterMux = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+// Updated by the ISR - pulses counted, when the last pulse started, the
+// period between the last two, and when each input last went idle
+#if defined(ESP32)
+// The totals live in RTC memory, so a crash, watchdog or restart between
+// saves loses nothing (only a power cut does)
+struct counterRtc_t
+{
+  uint32_t magic;
+  uint32_t count;
+  volatile uint32_t totals[GPIO_COUNT];
+};
+
+RTC_NOINIT_ATTR counterRtc_t counterRtc;
+volatile uint32_t (&counterTotal)[GPIO_COUNT] = counterRtc.totals;
+#else
+volatile uint32_t counterTotal[GPIO_COUNT];
+#endif
+volatile uint32_t counterPulseMicros[GPIO_COUNT];
+volatile uint32_t counterPeriodMicros[GPIO_COUNT];
+volatile uint32_t counterIdleMicros[GPIO_COUNT];
+
+// Total as of the last publish for each counter
+uint32_t counterPublished[GPIO_COUNT];
+uint32_t counterLastPublish = 0;
+
+uint32_t counterIntervalMs = DEFAULT_COUNTER_INTERVAL_MS;
+uint32_t counterDelta = DEFAULT_COUNTER_DELTA;
+uint32_t counterDebounceUs = DEFAULT_COUNTER_DEBOUNCE_MS * 1000UL;
+
+/*--------------------------- Program ---------------------------------*/
+// Keep the counter ISR out while counter state it also updates is
+// changed (or read as a pair) outside it
+void lockCounters(void)
+{
+  #if defined(ESP32)
+  portENTER_CRITICAL(&counterMux);
+  #else
+  noInterrupts();
+  #endif
+}
+
+void unlockCounters(void)
+{
+  #if defined(ESP32)
+  portEXIT_CRITICAL(&counterMux);
+  #else
+  interrupts();
+  #endif
+}
+
+// Count each pulse on any counter input, once the input has been idle
+// for the debounce period (so contact bounce on either edge is ignored)
+void IRAM_ATTR counterIsr(void)
+{
+  uint32_t now = micros();
+  gpioWord_t inputs = readInputs();
+
+  #if defined(ESP32)
+  portENTER_CRITICAL_ISR(&counterMux);
+  #endif
+
+  gpioWord_t active = ~(inputs ^ counterInvert) & counterMask;
+  gpioWord_t changed = active ^ counterActive;
+  counterActive = active;
+
+  while (changed)
+  {
+    uint8_t index = gpioFirst(changed);
+    changed &= changed - 1;
+
+    if (!bitRead(active, index))
+    {
+      counterIdleMicros[index] = now;
+    }
+    else if ((now - counterIdleMicros[index]) >= counterDebounceUs)
+    {
+      counterTotal[index]++;
+      counterPeriodMicros[index] = now - counterPulseMicros[index];
+      counterPulseMicros[index] = now;
+    }
+  }
+
+  #if defined(ESP32)
+  portEXIT_CRITICAL_ISR(&counterMux);
+  #endif
+}
+
+// Hand a GPIO to (or back from) the counter ISR, to match its config
+void updateCounter(uint8_t index)
+{
+  gpioConfig_t * config = &gpioConfig[index];
+  bool counting = isInterruptGpio(index) &&
+                  config->gpioType == GPIO_INPUT &&
+                  config->inputType == COUNTER &&
+                  !bitRead(config->inputFlags, GPIO_CONFIG_DISABLED);
+  bool wasCounting = bitRead(counterMask, index);
+  uint8_t gpio = GPIO_PINS[index];
+
+  // OXRS_Input never decodes a counter
+  oxrsInput[gpioBank(index)].setDisabled(gpioBankPin(index), counting || bitRead(config->inputFlags, GPIO_CONFIG_DISABLED));
+
+  if (counting)
+  {
+    detachInterrupt(digitalPinToInterrupt(gpio));
+
+    bool invert = bitRead(config->inputFlags, GPIO_CONFIG_INVERT);
+    bool active = (digitalRead(gpio) == LOW) != invert;
+
+    // Other counters' pulses may still be arriving
+    lockCounters();
+    gpioWrite(counterInvert, index, invert);
+    gpioWrite(counterActive, index, active);
+    counterIdleMicros[index] = micros();
+    counterPeriodMicros[index] = 0;
+    counterMask |= gpioBit(index);
+    unlockCounters();
+
+    attachInterrupt(digitalPinToInterrupt(gpio), counterIsr, CHANGE);
+  }
+  else if (wasCounting)
+  {
+    lockCounters();
+    counterMask &= ~gpioBit(index);
+    unlockCounters();
+
+    #if defined(INPUT_INTERRUPTS)
+    if (config->gpioType == GPIO_INPUT)
+    {
+      attachInterrupt(digitalPinToInterrupt(gpio), inputEdgeIsr, CHANGE);
+      return;
+    }
+    #endif
+    detachInterrupt(digitalPinToInterrupt(gpio));
+  }
+}
+
+// Pulses per hour, from the period between the last two pulses (or the
+// time since the last one, if longer, so the rate decays to 0 once the
+// pulses stop)
+float getCounterRate(uint8_t index)
+{
+  lockCounters();
+  uint32_t period = counterPeriodMicros[index];
+  uint32_t pulseMicros = counterPulseMicros[index];
+  unlockCounters();
+
+  if (period == 0) return 0;
+
+  uint32_t since = micros() - pulseMicros;
+  if (since > period) { period = since; }
+
+  return 3600e6f / period;
+}
+
+void publishCounter(uint8_t index, uint32_t total)
+{
+  StaticJsonDocument<COUNTER_JSON_SIZE> json;
+  json["gpio"] = GPIO_PINS[index];
+  json["type"] = getInputType(COUNTER);
+  json["event"] = "count";
+  json["total"] = total;
+  json["delta"] = total - counterPublished[index];
+  json["rate"] = roundf(getCounterRate(index) * 10) / 10;
+
+  // Totals are cumulative, so a failed publish is made good by the next
+  // one and isn't worth queueing for failover
+  memoryCheckpoint();
+  if (oxrs.publishStatus(json.as<JsonVariant>()))
+  {
+    counterPublished[index] = total;
+  }
+}
+
+// Publish every counter each interval, and any which have counted the
+// delta since their last publish
+void publishCounters(void)
+{
+  if (!counterMask) return;
+
+  bool due = counterIntervalMs && (millis() - counterLastPublish) >= counterIntervalMs;
+  if (due) { counterLastPublish = millis(); }
+
+  for (uint8_t index = 0; index < GPIO_COUNT; index++)
+  {
+    if (!bitRead(counterMask, index)) continue;
+
+    uint32_t total = counterTotal[index];
+    if (due || (counterDelta && (total - counterPublished[index]) >= counterDelta))
+    {
+      publishCounter(index, total);
+    }
+  }
+}
+
+#if defined(ESP32)
+// Totals in RTC memory are newer than those in flash, if they survived -
+// counting only goes up, and setting a total saves it, so none can be
+// below what was stored
+bool counterRtcValid(void)
+{
+  if (counterRtc.magic != COUNTER_RTC_MAGIC || counterRtc.count != GPIO_COUNT) return false;
+
+  for (uint8_t index = 0; index < GPIO_COUNT; index++)
+  {
+    if (counterRtc.totals[index] < counterStored.totals[index]) return false;
+  }
+  return true;
+}
+#endif
+
+void restoreCounters(void)
+{
+  if (!readStore(COUNTER_STORE_NAME, COUNTER_STORE_FILE, &counterStored, sizeof(counterStored)) ||
+      counterStored.magic != COUNTER_STORE_MAGIC ||
+      counterStored.version != COUNTER_STORE_VERSION ||
+      counterStored.count != GPIO_COUNT)
+  {
+    memset(&counterStored, 0, sizeof(counterStored));
+  }
+  else
+  {
+    Serial.println(F("[digio] restored stored counter totals"));
+  }
+
+  #if defined(ESP32)
+  if (counterRtcValid())
+  {
+    Serial.println(F("[digio] restored running counter totals from RTC memory"));
+  }
+  else
+  {
+    counterRtc.magic = COUNTER_RTC_MAGIC;
+    counterRtc.count = GPIO_COUNT;
+    for (uint8_t index = 0; index < GPIO_COUNT; index++)
+    {
+      counterTotal[index] = counterStored.totals[index];
+    }
+  }
+  #else
+  for (uint8_t index = 0; index < GPIO_COUNT; index++)
+  {
+    counterTotal[index] = counterStored.totals[index];
+  }
+  #endif
+
+  for (uint8_t index = 0; index < GPIO_COUNT; index++)
+  {
+    counterPublished[index] = counterTotal[index];
+  }
+}
+
+// Whether any counter has counted enough since the last save to save early
+bool counterSaveDue(void)
+{
+  if (COUNTER_SAVE_DELTA == 0) return false;
+
+  for (uint8_t index = 0; index < GPIO_COUNT; index++)
+  {
+    if (!bitRead(counterMask, index)) continue;
+    if ((counterTotal[index] - counterStored.totals[index]) >= COUNTER_SAVE_DELTA) return true;
+  }
+  return false;
+}
+
+// Write the counter totals if any have changed, once per save interval
+// or sooner if enough pulses have been counted, unless forced (e.g. a
+// total was set by command)
+void saveCounters(bool force)
+{
+  if (!force)
+  {
+    uint32_t sinceSave = millis() - counterLastSave;
+    if (sinceSave < COUNTER_SAVE_MIN_MS) return;
+    if (sinceSave < COUNTER_SAVE_MS && !counterSaveDue()) return;
+  }
+  counterLastSave = millis();
+
+  counterStore_t store;
+  memset(&store, 0, sizeof(store));
+  store.magic = COUNTER_STORE_MAGIC;
+  store.version = COUNTER_STORE_VERSION;
+  store.count = GPIO_COUNT;
+  for (uint8_t index = 0; index < GPIO_COUNT; index++)
+  {
+    store.totals[index] = counterTotal[index];
+  }
+
+  if (memcmp(&store, &counterStored, sizeof(store)) == 0) return;
+
+  if (writeStore(COUNTER_STORE_NAME, COUNTER_STORE_FILE, &store, sizeof(store)))
+  {
+    counterStored = store;
+  }
+  else
+  {
+    oxrs.println(F("[digio] failed to persist counter totals"));
+  }
+}
+
+#if defined(ESP32)
+// Run by esp_restart(), i.e. for a restart command or an OTA update, so
+// a planned reboot (even into firmware with another layout) loses nothing
+void saveCountersOnShutdown(void)
+{
+  saveCounters(true);
+}
+#endif
+
+void jsonCounterConfig(JsonVariant json)
+{
+  if (json.containsKey("intervalSeconds"))
+  {
+    if (json["intervalSeconds"].isNull())
+    {
+      counterIntervalMs = DEFAULT_COUNTER_INTERVAL_MS;
+    }
+    else
+    {
+      counterIntervalMs = json["intervalSeconds"].as<uint32_t>() * 1000;
+    }
+  }
+
+  if (json.containsKey("delta"))
+  {
+    counterDelta = json["delta"].isNull() ? DEFAULT_COUNTER_DELTA : json["delta"].as<uint32_t>();
+  }
+
+  if (json.containsKey("debounceMs"))
+  {
+    uint32_t debounceMs = json["debounceMs"].isNull() ? DEFAULT_COUNTER_DEBOUNCE_MS : json["debounceMs"].as<uint32_t>();
+    counterDebounceUs = debounceMs * 1000;
+  }
+}
+
+// Set a counter's total, e.g. to match the meter reading when fitted
+void jsonCounterCommand(JsonVariant json)
+{
+  uint8_t index = getIndex(json);
+  if (index == INVALID_GPIO_PIN) return;
+
+  if (!bitRead(counterMask, index))
+  {
+    oxrs.println(F("[digio] command received for GPIO not configured as counter"));
+    return;
+  }
+
+  if (!json["total"].is<uint32_t>())
+  {
+    oxrs.println(F("[digio] invalid counter total"));
+    return;
+  }
+
+  // Or a pulse counted by the ISR meanwhile could overwrite it
+  uint32_t total = json["total"].as<uint32_t>();
+  lockCounters();
+  counterTotal[index] = total;
+  unlockCounters();
+
+  counterPublished[index] = total;
+  publishCounter(index, total);
+}
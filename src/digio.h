@@ -0,0 +1,791 @@
+/**
+  Declarations shared by the firmware's source files - main.cpp has the
+  I/O handling, config and commands, each optional subsystem (MCP
+  expanders, counters, PWM, rules, the stream parser and stats) its own
+  source file
+*/
+
+#ifndef DIGIO_H
+#define DIGIO_H
+
+/*--------------------------- Libraries -------------------------------*/
+#include <Arduino.h>
+#include <OXRS_Input.h>               // For input handling
+#include <OXRS_Output.h>              // For output handling
+#include <atomic>                     // For lock-free ring buffers
+
+#if defined(IO_TASK)
+#include <freertos/semphr.h>          // For the I/O task mutex
+#endif
+
+#if defined(ESP32)
+#include <driver/ledc.h>              // For PWM output fades
+#include <esp_idf_version.h>          // For stopping a running fade
+#endif
+
+#if defined(MCP_EXPANDERS) && !defined(OXRS_ESP32) && !defined(OXRS_NATIVE)
+#error "MCP_EXPANDERS is only supported on ESP32"
+#endif
+
+#if defined(OXRS_ESP32)
+#include <OXRS_32.h>                  // ESP32 support
+typedef OXRS_32 oxrs_t;
+
+#elif defined(OXRS_ESP8266)
+#include <OXRS_8266.h>                // ESP8266 support
+typedef OXRS_8266 oxrs_t;
+
+#elif defined(OXRS_LILYGO)
+#include <OXRS_LILYGOPOE.h>           // LilyGO T-ETH-POE support
+typedef OXRS_LILYGOPOE oxrs_t;
+
+#elif defined(OXRS_NATIVE)
+#include <OXRS_HOST.h>                // Host-native stand-in (benchmarks)
+typedef OXRS_HOST oxrs_t;
+#endif
+
+#include <gpio_pins.h>                // Pin map and GPIO word, shared with the benchmarks
+
+/*--------------------------- Constants -------------------------------*/
+// Serial
+#define       SERIAL_BAUD_RATE      115200
+
+// Internal constant used when GPIO pin parsing fails
+#define       INVALID_GPIO_PIN      99
+
+// Internal constant used when GPIO type parsing fails
+#define       INVALID_GPIO_TYPE     99
+
+// Internal constant used when input type parsing fails
+#define       INVALID_INPUT_TYPE    99
+
+// Internal constants used when output type parsing fails
+#define       INVALID_OUTPUT_TYPE   99
+
+// Input type counted by our own ISR, OXRS_Input never sees it
+#define       COUNTER               (TOGGLE + 1)
+
+// Number of input types, and of event states an input can raise
+#define       INPUT_TYPE_COUNT      (COUNTER + 1)
+#define       INPUT_EVENT_COUNT     (HOLD_EVENT + 1)
+
+// Event states raised when an input is suppressed for raising events too
+// fast, and when it is released again (local rules never see these)
+#define       STORM_EVENT           (INPUT_EVENT_COUNT)
+#define       STORM_RELEASE_EVENT   (INPUT_EVENT_COUNT + 1)
+
+// Default events an input with a rate limit can raise in a burst
+#define       DEFAULT_STORM_BURST   10
+
+// Output type driven by PWM (LEDC on ESP32), OXRS_Output never sees it
+#define       PWM                   (TIMER + 1)
+
+// Default PWM frequency (Hz) and resolution (bits)
+#define       DEFAULT_PWM_FREQUENCY 5000
+#define       DEFAULT_PWM_RESOLUTION  10
+
+// PWM outputs available - on ESP32 each uses every other LEDC channel,
+// so every one has its own timer (and so frequency)
+#define       PWM_CHANNELS          8
+#define       PWM_NO_CHANNEL        0xff
+
+// Fastest the LEDC timers count (the APB clock), a PWM frequency shifted
+// by its resolution can't be more
+#define       PWM_MAX_CLOCK_HZ      80000000ULL
+
+// Default ms a 'pulse' rule holds its outputs on
+#define       DEFAULT_RULE_PULSE_MS 500
+
+// Rules each input can have, every one matching any of its events (three
+// expanders leave the persisted config room for fewer)
+#if !defined(RULES_PER_INPUT)
+#if defined(MCP_EXPANDERS) && MCP_EXPANDERS == 3
+#define       RULES_PER_INPUT       3
+#else
+#define       RULES_PER_INPUT       4
+#endif
+#endif
+
+// Input edge capture buffer (samples, must be a power of 2)
+#if !defined(INPUT_CAPTURE_SIZE)
+#define       INPUT_CAPTURE_SIZE    64
+#endif
+
+// How long (ms) replay holds the last edge before catching up with real time
+#if !defined(INPUT_REPLAY_SETTLE_MS)
+#define       INPUT_REPLAY_SETTLE_MS  1000
+#endif
+
+// Input trace - the last n input words handed to the input handlers,
+// recorded on a change or after a gap of at least INPUT_TRACE_GAP_MS
+#if defined(INPUT_TRACE)
+#if !defined(INPUT_TRACE_SIZE)
+#define       INPUT_TRACE_SIZE      256
+#endif
+
+#if !defined(INPUT_TRACE_GAP_MS)
+#define       INPUT_TRACE_GAP_MS    5
+#endif
+#endif
+
+// Fixed-rate scheduler - a hardware timer samples the inputs at this rate
+// and wakes the loop at least once a ms, instead of the loop sleeping for
+// a fixed 1ms (the wait is capped in case the timer ever stops)
+#if defined(TIMER_SCHEDULER)
+#if !defined(SCHEDULER_RATE_HZ)
+#define       SCHEDULER_RATE_HZ     1000
+#endif
+
+#if !defined(SCHEDULER_MAX_WAIT_MS)
+#define       SCHEDULER_MAX_WAIT_MS 10
+#endif
+
+#define       SCHEDULER_PERIOD_US   (1000000UL / SCHEDULER_RATE_HZ)
+#define       SCHEDULER_TICKS_PER_MS  ((SCHEDULER_RATE_HZ + 999) / 1000)
+
+#if (SCHEDULER_RATE_HZ < 100) || (SCHEDULER_RATE_HZ > 5000)
+#error "SCHEDULER_RATE_HZ must be between 100 and 5000"
+#endif
+
+#if defined(ESP8266) && (SCHEDULER_RATE_HZ > 1000)
+#error "SCHEDULER_RATE_HZ is limited to 1000 on ESP8266 (os_timer has 1ms resolution)"
+#endif
+
+#if defined(INPUT_INTERRUPTS)
+#error "TIMER_SCHEDULER and INPUT_INTERRUPTS both capture inputs, enable only one"
+#endif
+
+#if defined(IO_TASK)
+#error "TIMER_SCHEDULER and IO_TASK both schedule the I/O scan, enable only one"
+#endif
+#endif
+
+// Status events queued while publishing fails, replayed on reconnect
+#if !defined(FAILOVER_QUEUE_SIZE)
+#define       FAILOVER_QUEUE_SIZE   64
+#endif
+
+#if defined(FAILOVER_RTC) && !defined(ESP32)
+#error "FAILOVER_RTC is only supported on ESP32"
+#endif
+
+// Bump if event_t changes, so RTC memory from older firmware is discarded
+#define       FAILOVER_MAGIC        0x4f585254
+
+// Default ms between replayed events once publishing succeeds again
+#define       DEFAULT_FAILOVER_REPLAY_MS  20
+
+// Most status events coalesced into a single batched publish
+#if !defined(BATCH_MAX_EVENTS)
+#define       BATCH_MAX_EVENTS      16
+#endif
+
+// Applied GPIO config is persisted, and restored at boot before the
+// network is up - bump the version if gpioConfig_t or the rules table changes
+#define       CONFIG_STORE_MAGIC    0x4443
+#define       CONFIG_STORE_VERSION  7
+
+// Most the persisted config can take - a copy is kept in RAM to compare
+// against, and it's written as one blob, so more GPIOs (expanders) or
+// rules per input must still fit
+#define       CONFIG_STORE_MAX_SIZE 4096
+#define       CONFIG_STORE_NAME     "digio"
+#define       CONFIG_STORE_FILE     "/digio.bin"
+
+// Counter input totals, persisted separately (and less often) so a
+// busy meter doesn't rewrite the GPIO config
+#define       COUNTER_STORE_MAGIC   0x4354
+#define       COUNTER_STORE_VERSION 1
+#define       COUNTER_STORE_NAME    "counters"
+#define       COUNTER_STORE_FILE    "/counters.bin"
+
+// How often (ms) changed counter totals are written to flash, or sooner
+// once any counter has counted COUNTER_SAVE_DELTA pulses (0 to only save
+// on the interval) - though never more often than COUNTER_SAVE_MIN_MS, to
+// spare the flash - i.e. the most counts lost on a power cut
+#if !defined(COUNTER_SAVE_MS)
+#define       COUNTER_SAVE_MS       600000
+#endif
+
+#if !defined(COUNTER_SAVE_DELTA)
+#define       COUNTER_SAVE_DELTA    100
+#endif
+
+#if !defined(COUNTER_SAVE_MIN_MS)
+#define       COUNTER_SAVE_MIN_MS   60000
+#endif
+
+// Running totals kept in RTC memory (ESP32 only), valid across a soft
+// reboot - bump if the layout changes
+#define       COUNTER_RTC_MAGIC     0x43525443
+
+// Default counter publishing - every 60s (or every n counts, 0 = off),
+// and how long (ms) an input must be idle before a pulse is counted
+#define       DEFAULT_COUNTER_INTERVAL_MS   60000
+#define       DEFAULT_COUNTER_DELTA         0
+#define       DEFAULT_COUNTER_DEBOUNCE_MS   10
+
+// Event names are stored by pointer, so documents only need the nodes -
+// except on ESP8266, where they are flash strings and copied (the longest
+// type and event names, see name_t)
+#if defined(ESP8266)
+#define       NAME_COPY_SIZE        (JSON_STRING_SIZE(8) + JSON_STRING_SIZE(10))
+#else
+#define       NAME_COPY_SIZE        0
+#endif
+
+#define       COUNTER_JSON_SIZE     (JSON_OBJECT_SIZE(6) + NAME_COPY_SIZE)
+#define       EVENT_JSON_SIZE       (JSON_OBJECT_SIZE(6) + NAME_COPY_SIZE)
+#define       BATCH_JSON_SIZE       (JSON_OBJECT_SIZE(1) + JSON_ARRAY_SIZE(BATCH_MAX_EVENTS) + BATCH_MAX_EVENTS * (JSON_OBJECT_SIZE(6) + NAME_COPY_SIZE))
+#define       SNAPSHOT_JSON_SIZE    (JSON_OBJECT_SIZE(1) + JSON_OBJECT_SIZE(3))
+#define       RULES_JSON_SIZE       (JSON_OBJECT_SIZE(1) + JSON_OBJECT_SIZE(2))
+#define       IO_EVENTS_JSON_SIZE   (JSON_OBJECT_SIZE(1) + JSON_OBJECT_SIZE(1))
+
+// Latency histograms (log2 buckets, in microseconds) and how often (ms)
+// they are published as telemetry
+#if defined(LATENCY_STATS)
+#define       LATENCY_BUCKETS       32
+
+#if !defined(LATENCY_TELEMETRY_MS)
+#define       LATENCY_TELEMETRY_MS  60000
+#endif
+#endif
+
+// Loop profiler - default deadline (us) for a loop pass, and how often
+// (ms) the stats are published as telemetry (0 to only publish on demand)
+#if defined(LOOP_PROFILER)
+#if !defined(DEFAULT_PROFILER_DEADLINE_US)
+#define       DEFAULT_PROFILER_DEADLINE_US  10000
+#endif
+
+#if !defined(DEFAULT_PROFILER_INTERVAL_MS)
+#define       DEFAULT_PROFILER_INTERVAL_MS  60000
+#endif
+#endif
+
+// Memory stats - how often (ms) the heap/stack gauges are checked against
+// the alarm thresholds, and by default how often (ms) they are published
+// as telemetry (0 to only publish on demand, or when an alarm changes)
+#if defined(MEMORY_STATS)
+#if !defined(MEMORY_CHECK_MS)
+#define       MEMORY_CHECK_MS       1000
+#endif
+
+#if !defined(DEFAULT_MEMORY_INTERVAL_MS)
+#define       DEFAULT_MEMORY_INTERVAL_MS  60000
+#endif
+#endif
+
+// Streamed config/command parsing - the size of the fixed documents each
+// list element, and the rest of a payload, are parsed into, and the most
+// members (besides the lists) a payload can have
+#if defined(STREAM_CONFIG)
+#if !defined(STREAM_ELEMENT_SIZE)
+#define       STREAM_ELEMENT_SIZE   512
+#endif
+
+#if !defined(STREAM_MEMBERS_SIZE)
+#define       STREAM_MEMBERS_SIZE   1024
+#endif
+
+#if !defined(STREAM_MAX_MEMBERS)
+#define       STREAM_MAX_MEMBERS    12
+#endif
+
+// Big enough for the config/command topics, with any prefix/suffix
+#if !defined(STREAM_TOPIC_SIZE)
+#define       STREAM_TOPIC_SIZE     64
+#endif
+#endif
+
+// Hardware pulse counters for rotary encoders (ESP32 only) - the glitch
+// filter (APB clock cycles, max 1023) and default ms between the counts
+// being reported
+#if defined(PCNT_ROTARY)
+#if !defined(ESP32) && !defined(OXRS_NATIVE)
+#error "PCNT_ROTARY is only supported on ESP32"
+#endif
+
+#if defined(ESP32)
+#define       PCNT_UNITS            PCNT_UNIT_MAX
+#else
+#define       PCNT_UNITS            NATIVE_PCNT_UNITS
+#endif
+
+#if !defined(PCNT_FILTER_CYCLES)
+#define       PCNT_FILTER_CYCLES    1000
+#endif
+
+#define       DEFAULT_PCNT_INTERVAL_MS  100
+#endif
+
+// Dedicated I/O task (ESP32 only) - scan period, priority and core, and
+// the size of the queues to/from the network task (must be powers of 2)
+#if defined(IO_TASK)
+#if !defined(ESP32)
+#error "IO_TASK is only supported on ESP32"
+#endif
+
+#if !defined(IO_TASK_PERIOD_MS)
+#define       IO_TASK_PERIOD_MS     1
+#endif
+
+#if !defined(IO_TASK_PRIORITY)
+#define       IO_TASK_PRIORITY      10
+#endif
+
+#if !defined(IO_TASK_CORE)
+#define       IO_TASK_CORE          0
+#endif
+
+#if !defined(IO_TASK_STACK_SIZE)
+#define       IO_TASK_STACK_SIZE    4096
+#endif
+
+#if !defined(IO_EVENT_QUEUE_SIZE)
+#define       IO_EVENT_QUEUE_SIZE   64
+#endif
+
+#if !defined(IO_COMMAND_QUEUE_SIZE)
+#define       IO_COMMAND_QUEUE_SIZE 32
+#endif
+#endif
+
+// MCP23017 expanders, at consecutive I2C addresses from MCP_BASE_ADDRESS
+// with their INT lines (mirrored across both ports) on MCP_INT_PINS
+#if defined(MCP_EXPANDERS)
+#if !defined(MCP_I2C_SDA)
+#define       MCP_I2C_SDA           21
+#endif
+
+#if !defined(MCP_I2C_SCL)
+#define       MCP_I2C_SCL           22
+#endif
+
+#if !defined(MCP_I2C_FREQUENCY)
+#define       MCP_I2C_FREQUENCY     400000
+#endif
+
+#if !defined(MCP_BASE_ADDRESS)
+#define       MCP_BASE_ADDRESS      0x20
+#endif
+
+#if !defined(MCP_INT_PINS)
+#if defined(OXRS_NATIVE)
+#define       MCP_INT_PINS          NATIVE_MCP_INT_PINS
+#else
+#define       MCP_INT_PINS          { 34, 35, 36 }
+#endif
+#endif
+
+// Registers (IOCON.BANK = 0, so each A/B pair is adjacent and read or
+// written as one 16-bit value with the address auto-incrementing)
+#define       MCP_IODIRA            0x00
+#define       MCP_GPINTENA          0x04
+#define       MCP_IOCON             0x0A
+#define       MCP_GPPUA             0x0C
+#define       MCP_GPIOA             0x12
+#define       MCP_OLATA             0x14
+
+#define       MCP_IOCON_MIRROR      0x40
+#endif
+
+/*--------------------------- Ring Buffer -----------------------------*/
+// Lock-free single-producer/single-consumer ring buffer, safe to push
+// from an ISR (or another core) while the main loop pops
+template <typename T, uint16_t SIZE>
+class SpscRing
+{
+  static_assert((SIZE & (SIZE - 1)) == 0, "ring buffer size must be a power of 2");
+
+  public:
+    inline __attribute__((always_inline)) bool push(const T & item)
+    {
+      uint16_t head = _head.load(std::memory_order_relaxed);
+      if ((uint16_t)(head - _tail.load(std::memory_order_acquire)) >= SIZE)
+      {
+        _dropped++;
+        return false;
+      }
+
+      _items[head & (SIZE - 1)] = item;
+      _head.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    bool peek(T & item)
+    {
+      uint16_t tail = _tail.load(std::memory_order_relaxed);
+      if (tail == _head.load(std::memory_order_acquire)) return false;
+
+      item = _items[tail & (SIZE - 1)];
+      return true;
+    }
+
+    bool pop(T & item)
+    {
+      if (!peek(item)) return false;
+
+      _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+      return true;
+    }
+
+    uint16_t count(void)
+    {
+      return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    uint32_t dropped(void)
+    {
+      return _dropped;
+    }
+
+  private:
+    T _items[SIZE];
+    std::atomic<uint16_t> _head { 0 };
+    std::atomic<uint16_t> _tail { 0 };
+    volatile uint32_t _dropped = 0;
+};
+
+/*--------------------------- Shared Types ----------------------------*/
+enum gpioType_t { GPIO_INPUT, GPIO_OUTPUT };
+
+// GPIOs are handled in banks of 16, each with its own OXRS_Input and
+// OXRS_Output - GPIO index n is pin n % 16 of bank n / 16
+#define       GPIO_BANK_SIZE        16
+
+constexpr uint8_t GPIO_BANKS      = (GPIO_COUNT + GPIO_BANK_SIZE - 1) / GPIO_BANK_SIZE;
+
+constexpr uint8_t gpioBank(uint8_t index) { return index / GPIO_BANK_SIZE; }
+constexpr uint8_t gpioBankPin(uint8_t index) { return index % GPIO_BANK_SIZE; }
+
+constexpr gpioWord_t gpioBit(uint8_t index) { return (gpioWord_t)1 << index; }
+
+// bitWrite() for a GPIO word, the Arduino bit macros only shift a long
+template <typename T>
+inline __attribute__((always_inline)) void gpioWrite(T & word, uint8_t index, bool value)
+{
+  word = value ? (word | gpioBit(index)) : (word & ~gpioBit(index));
+}
+
+// Lowest GPIO index set in a (non-zero) GPIO word
+inline __attribute__((always_inline)) uint8_t gpioFirst(gpioWord_t word)
+{
+  if (sizeof(gpioWord_t) > 4 && (uint32_t)word == 0)
+  {
+    return 32 + __builtin_ctz((uint32_t)((uint64_t)word >> 32));
+  }
+  return __builtin_ctz((uint32_t)word);
+}
+
+// Bit per GPIO index, all set (shifted in two steps so 64 GPIOs works)
+constexpr gpioWord_t GPIO_MASK    = (gpioWord_t)((((uint64_t)1 << (GPIO_COUNT - 1)) << 1) - 1);
+
+// GPIO indexes below this are on the chip itself, any above are on
+// expanders (so have no hardware register, interrupt, counter or PWM)
+#if defined(MCP_EXPANDERS)
+constexpr uint8_t GPIO_NATIVE_COUNT = GPIO_COUNT - 16 * MCP_EXPANDERS;
+#else
+constexpr uint8_t GPIO_NATIVE_COUNT = GPIO_COUNT;
+#endif
+
+constexpr bool isNativeGpio(uint8_t index) { return index < GPIO_NATIVE_COUNT; }
+
+// Whether a GPIO can raise an interrupt of its own (GPIO16 on an ESP8266
+// is wired to the RTC, and has none)
+#if defined(ESP8266)
+constexpr bool isInterruptGpio(uint8_t index) { return isNativeGpio(index) && GPIO_PINS[index] != 16; }
+#else
+constexpr bool isInterruptGpio(uint8_t index) { return isNativeGpio(index); }
+#endif
+
+#if defined(MCP_EXPANDERS)
+// INT line for each expander
+constexpr uint8_t MCP_INT_GPIOS[] = MCP_INT_PINS;
+static_assert(sizeof(MCP_INT_GPIOS) >= MCP_EXPANDERS, "MCP_INT_PINS needs an INT pin for every expander");
+
+// Bits of the GPIO word on expanders, expander n starts at this shift
+constexpr gpioWord_t MCP_MASK     = GPIO_MASK & ~(gpioBit(GPIO_NATIVE_COUNT) - 1);
+
+constexpr uint8_t mcpShift(uint8_t expander) { return GPIO_NATIVE_COUNT + 16 * expander; }
+#endif
+
+// Applied config for each GPIO index, as persisted across reboots (the
+// input flags are bit numbers)
+#define       GPIO_CONFIG_INVERT    0
+#define       GPIO_CONFIG_DISABLED  1
+#define       GPIO_CONFIG_PCNT      2
+
+struct gpioConfig_t
+{
+  uint8_t gpioType;
+  uint8_t inputType;
+  uint8_t inputFlags;
+  uint8_t outputType;
+  uint8_t timerSeconds;
+  uint8_t interlockIndex;
+  uint16_t pwmFrequency;
+  uint8_t pwmResolution;
+  uint8_t stormRate;        // events per second, 0 for no rate limit
+  uint8_t stormBurst;
+};
+
+// Local rules, driving outputs straight from input events so they keep
+// working without the broker - compiled into a small fixed table per
+// input, each rule with a bit per event state it matches, so matching an
+// event only checks that input's rules
+enum ruleAction_t { RULE_NONE, RULE_ON, RULE_OFF, RULE_TOGGLE, RULE_PULSE };
+
+struct rule_t
+{
+  gpioWord_t outputs;
+  uint16_t pulseMs;
+  uint16_t events;
+  uint8_t inputType;
+  uint8_t action;
+};
+
+static_assert(INPUT_EVENT_COUNT <= 16, "rule_t event mask is too small");
+
+// PWM is only on native GPIOs, so their flags fit a 32-bit word (which,
+// unlike a 64-bit one, the LEDC ISR can update lock-free)
+static_assert(GPIO_NATIVE_COUNT <= 32, "PWM flags are kept in a 32-bit word");
+constexpr uint32_t pwmBit(uint8_t index) { return 1UL << index; }
+
+// Compact record of a status event, kept until it has been published
+enum eventSource_t { EVENT_INPUT, EVENT_OUTPUT };
+
+// Flag set on events restored from RTC memory after a reboot
+#define       EVENT_PREVIOUS_BOOT   0x80
+
+struct event_t
+{
+  uint32_t timestamp;
+  uint8_t source;
+  uint8_t index;
+  uint8_t type;
+  uint8_t state;
+  uint16_t value;           // steps (rotary counters), level (pwm outputs) or events dropped (storm releases)
+  uint16_t duration;        // seconds suppressed (storm releases)
+  #if defined(LATENCY_STATS)
+  uint32_t sampledMicros;
+  uint32_t raisedMicros;
+  #endif
+};
+
+// An event raised now, with every field set (whatever the build adds)
+inline event_t makeEvent(uint8_t source, uint8_t index, uint8_t type, uint8_t state, uint16_t value = 0)
+{
+  event_t event = {};
+  event.timestamp = millis();
+  event.source = source;
+  event.index = index;
+  event.type = type;
+  event.state = state;
+  event.value = value;
+  return event;
+}
+
+#if defined(LATENCY_STATS)
+// Each stage is only ever recorded from one task
+enum latencyStage_t
+{
+  LATENCY_INPUT_SAMPLE,     // input sampled -> event raised by OXRS_Input
+  LATENCY_INPUT_QUEUE,      // event raised -> serialization starts
+  LATENCY_INPUT_PUBLISH,    // serialization starts -> publishStatus() returns
+  LATENCY_INPUT_TOTAL,      // input sampled -> publishStatus() returns
+  LATENCY_OUTPUT_COMMAND,   // command received -> output pin written
+  LATENCY_STAGES
+};
+#endif
+
+// Stages of a loop pass (inputs/outputs run in the I/O task if enabled)
+enum profileStage_t
+{
+  PROFILE_NETWORK,          // oxrs.loop()
+  PROFILE_INPUTS,           // input scan and OXRS_Input processing
+  PROFILE_OUTPUTS,          // OXRS_Output processing and output writes
+  PROFILE_PUBLISH,          // batch, failover and telemetry publishing
+  PROFILE_YIELD,            // delay() (or scheduler wait) for background processes
+  PROFILE_STAGES
+};
+
+// Paths whose peak heap/stack use is measured (a path entered while
+// another is being measured counts towards the outer one)
+enum memoryPath_t
+{
+  MEMORY_SCHEMA,            // setConfigSchema()/setCommandSchema()
+  MEMORY_CONFIG,            // jsonConfig()
+  MEMORY_COMMAND,           // jsonCommand()
+  MEMORY_PUBLISH,           // status events, batches and counters
+  MEMORY_PATHS
+};
+
+// Event names are looked up rather than formatted, and returned as
+// pointers to constant strings so ArduinoJson can store them without
+// copying into the document - on ESP8266, where constant data is copied
+// to RAM, they are kept in flash (tables too) and returned as flash strings
+#if defined(ESP8266)
+typedef const __FlashStringHelper * name_t;
+#else
+typedef const char * name_t;
+#endif
+
+/*--------------------------- Shared Globals --------------------------*/
+extern oxrs_t oxrs;
+
+extern OXRS_Input oxrsInput[GPIO_BANKS];
+extern OXRS_Output oxrsOutput[GPIO_BANKS];
+
+extern uint8_t gpioTypes[GPIO_COUNT];
+extern gpioConfig_t gpioConfig[GPIO_COUNT];
+
+// Bit per GPIO index, set if configured as an input
+extern gpioWord_t inputMask;
+
+// Bit per GPIO index, the level each output should be driven to, and
+// which of those have changed since they were last written
+extern gpioWord_t outputState;
+extern gpioWord_t outputDirty;
+
+// Rules (rules.cpp)
+extern rule_t rules[GPIO_COUNT][RULES_PER_INPUT];
+extern uint32_t rulePulseOff[GPIO_COUNT];
+
+// PWM outputs (pwm.cpp)
+extern gpioWord_t pwmMask;
+extern std::atomic<uint32_t> pwmPublish;
+
+#if defined(MCP_EXPANDERS)
+// MCP23017 expanders (mcp.cpp)
+extern gpioWord_t mcpInputs;
+extern uint8_t mcpConfigDirty;
+#endif
+
+#if defined(IO_TASK)
+extern TaskHandle_t ioTaskHandle;
+#endif
+
+#if defined(LATENCY_STATS)
+// Latency histograms (stats.cpp)
+extern gpioWord_t outputCommandPending;
+#endif
+
+#if defined(LOOP_PROFILER)
+// Loop profiler (stats.cpp)
+extern uint32_t profilerLastPublish;
+extern uint32_t profilerIntervalMs;
+#endif
+
+#if defined(MEMORY_STATS)
+// Memory stats (stats.cpp)
+extern uint32_t memoryLastCheck;
+extern uint32_t memoryLastPublish;
+extern uint32_t memoryIntervalMs;
+#endif
+
+/*--------------------------- Shared Functions ------------------------*/
+// I/O handling, config and commands (main.cpp)
+void lockIO(void);
+void unlockIO(void);
+gpioWord_t readInputs(void);
+#if defined(INPUT_INTERRUPTS)
+void inputEdgeIsr(void);
+#endif
+void processInputs(gpioWord_t value);
+void commandOutput(uint8_t index, uint8_t command);
+void publishEvent(const event_t & event);
+uint8_t getIndexFromGpio(uint8_t gpio);
+uint8_t getIndex(JsonVariant json);
+name_t getInputType(uint8_t type);
+const char * readInputEventName(uint8_t type, uint8_t state);
+bool readStore(const char * name, const char * file, void * store, size_t size);
+bool writeStore(const char * name, const char * file, const void * store, size_t size);
+void saveConfig(void);
+void jsonSettingsConfig(JsonVariant json);
+void jsonGpioConfig(JsonVariant json);
+void jsonGpioCommand(JsonVariant json);
+void jsonOtherCommands(JsonVariant json, bool gpios);
+void bindRotaryCounters(void);
+
+// Counter inputs (counters.cpp)
+void updateCounter(uint8_t index);
+void publishCounters(void);
+void restoreCounters(void);
+void saveCounters(bool force);
+#if defined(ESP32)
+void saveCountersOnShutdown(void);
+#endif
+void jsonCounterConfig(JsonVariant json);
+void jsonCounterCommand(JsonVariant json);
+
+// PWM outputs (pwm.cpp)
+void beginPwm(void);
+void updatePwm(uint8_t index);
+void setPwmLevel(uint8_t index, uint8_t level, uint32_t fadeMs);
+void processPwmFades(void);
+void publishPwmLevels(void);
+
+#if defined(MCP_EXPANDERS)
+// MCP23017 expanders (mcp.cpp)
+void beginExpanders(void);
+void scanExpanders(void);
+void writeExpanders(void);
+#endif
+
+// Local rules (rules.cpp)
+void clearRules(void);
+bool jsonRuleConfig(JsonVariant json);
+uint16_t jsonRulesConfig(JsonVariant json);
+void publishRulesResult(uint16_t accepted, uint16_t rejected);
+void processRule(uint8_t input, uint8_t type, uint8_t state);
+void processRulePulses(void);
+
+#if defined(STREAM_CONFIG)
+// Streamed config/command parser (stream.cpp)
+void beginStream(void);
+#endif
+
+#if defined(LATENCY_STATS)
+// Latency histograms (stats.cpp)
+void recordLatency(uint8_t stage, uint32_t us);
+void stampOutputCommand(uint8_t index, uint32_t receivedMicros);
+void recordOutputLatency(gpioWord_t written);
+void recordPublishLatency(const event_t & event, uint32_t serializeMicros, uint32_t publishedMicros);
+void publishLatency(void);
+void apiLatency(Request & req, Response & res);
+#endif
+
+// Loop profiler (stats.cpp), no-ops unless enabled
+#if defined(LOOP_PROFILER)
+uint32_t profileStart(void);
+uint32_t profileStage(uint8_t stage, uint32_t start);
+void profilePass(uint32_t start);
+void profileSample(uint32_t now);
+void resetProfiler(void);
+void publishProfiler(bool reset);
+void jsonProfilerConfig(JsonVariant json);
+void jsonProfilerCommand(JsonVariant json);
+#else
+inline uint32_t profileStart(void) { return 0; }
+inline uint32_t profileStage(uint8_t stage, uint32_t start) { return 0; }
+inline void profilePass(uint32_t start) {}
+inline void profileSample(uint32_t now) {}
+#endif
+
+// Memory stats (stats.cpp), no-ops unless enabled
+#if defined(MEMORY_STATS)
+void memoryBegin(uint8_t path);
+void memoryCheckpoint(void);
+void memoryEnd(uint8_t path);
+void publishMemory(void);
+void checkMemory(void);
+void jsonMemoryConfig(JsonVariant json);
+void jsonMemoryCommand(JsonVariant json);
+#else
+inline void memoryBegin(uint8_t path) {}
+inline void memoryCheckpoint(void) {}
+inline void memoryEnd(uint8_t path) {}
+#endif
+
+#endif
@@ -11,826 +11,2744 @@
 */
 
 /*--------------------------- Libraries -------------------------------*/
-#include <Arduino.h>
-#include <OXRS_Input.h>               // For input handling
-#include <OXRS_Output.h>              // For output handling
-
-#if defined(OXRS_ESP32)
-#include <OXRS_32.h>                  // ESP32 support
-OXRS_32 oxrs;
-const uint8_t GPIO_PINS[]         = { 2, 4, 5, 13, 14, 15, 16, 17, 18, 19, 21, 22, 23, 25, 26, 27 };
-
-#elif defined(OXRS_ESP8266)
-#include <OXRS_8266.h>                // ESP8266 support
-OXRS_8266 oxrs;
-const uint8_t GPIO_PINS[]         = { 2, 4, 5, 12, 13, 14, 15, 16 };
-
-#elif defined(OXRS_LILYGO)
-#include <OXRS_LILYGOPOE.h>           // LilyGO T-ETH-POE support
-OXRS_LILYGOPOE oxrs;
-const uint8_t GPIO_PINS[]         = { 2, 4, 12, 14, 15, 16, 32, 33, 34, 35, 36, 39 };
-#endif
-
-/*--------------------------- Constants -------------------------------*/
-// Serial
-#define       SERIAL_BAUD_RATE      115200
+#include "digio.h"                    // Shared with the subsystem source files
 
-// Internal constant used when GPIO pin parsing fails
-#define       INVALID_GPIO_PIN      99
+#if defined(ESP8266)
+#include <LittleFS.h>                 // For persisting GPIO config
+#else
+#include <Preferences.h>              // For persisting GPIO config (NVS)
+#endif
 
-// Internal constant used when GPIO type parsing fails
-#define       INVALID_GPIO_TYPE     99
+#if defined(PCNT_ROTARY) && defined(ESP32)
+#include <driver/pcnt.h>              // For hardware rotary counters
+#endif
 
-// Internal constant used when input type parsing fails
-#define       INVALID_INPUT_TYPE    99
+#if defined(TIMER_SCHEDULER)
+#if defined(ESP32)
+#include <esp_timer.h>                // For the sampling timer
+#elif defined(ESP8266)
+#include <coredecls.h>                // For esp_delay()/esp_schedule()
+#endif
+#endif
 
-// Internal constants used when output type parsing fails
-#define       INVALID_OUTPUT_TYPE   99
+#include <schema.h>                   // Generated by scripts/schema_extra.py
 
 /*--------------------------- Global Variables ------------------------*/
-enum gpioType_t { GPIO_INPUT, GPIO_OUTPUT };
-
-const uint8_t GPIO_COUNT          = sizeof(GPIO_PINS);
 uint8_t gpioTypes[GPIO_COUNT];
 
-/*--------------------------- Instantiate Globals ---------------------*/
-// Input handler
-OXRS_Input oxrsInput;
+gpioWord_t inputMask = 0;
+gpioWord_t outputState = 0;
+gpioWord_t outputDirty = 0;
 
-// Output handler
-OXRS_Output oxrsOutput;
+struct configStore_t
+{
+  uint16_t magic;
+  uint8_t version;
+  uint8_t count;
+  gpioConfig_t gpios[GPIO_COUNT];
+  rule_t rules[GPIO_COUNT][RULES_PER_INPUT];
+};
 
-/*--------------------------- Program ---------------------------------*/
+static_assert(sizeof(configStore_t) <= CONFIG_STORE_MAX_SIZE, "persisted config is too big, reduce RULES_PER_INPUT");
 
-// Set the type in our internal config and update the physical pin mode
-void setGpioType(uint8_t index, uint8_t type)
+gpioConfig_t gpioConfig[GPIO_COUNT];
+
+// What was last written to (or restored from) flash
+configStore_t configStored;
+
+// Token bucket for each rate limited input - the tokens left (in 1000ths
+// of an event) and when it was last refilled, and once suppressed since
+// when and how many events have been dropped
+struct storm_t
 {
-  // update the GPIO type in our internal config
-  gpioTypes[index] = type;
+  uint32_t tokens;
+  uint32_t refilled;
+  uint32_t since;
+  uint32_t count;
+  uint8_t state;            // of the last event dropped
+};
 
-  // get the GPIO pin
-  uint8_t gpio = GPIO_PINS[index];
+storm_t storm[GPIO_COUNT];
 
-  // configure the GPIO pin itself
-  switch (type)
-  {
-    case GPIO_INPUT:
-      pinMode(gpio, INPUT_PULLUP);
-      break;
+// Bit per GPIO index, set while an input is suppressed
+gpioWord_t stormMask = 0;
 
-    case GPIO_OUTPUT:
-      pinMode(gpio, OUTPUT);
-      digitalWrite(gpio, RELAY_OFF);
-      break;
-  }
-}
+// Each schema used to be built in a document of the OXRS library's payload
+// size for the board, so must still fit in one (the ESP8266 gets a cut-down
+// schema for this reason)
+static_assert(CONFIG_SCHEMA_CAPACITY <= JSON_CONFIG_MAX_SIZE, "config schema is too big for this board, trim it in scripts/schema_extra.py");
+static_assert(COMMAND_SCHEMA_CAPACITY <= JSON_COMMAND_MAX_SIZE, "command schema is too big for this board, trim it in scripts/schema_extra.py");
 
-void setTitle(JsonObject json, char * title)
+// Failover queue, in RTC memory if enabled so it survives a soft reboot
+enum failoverDrop_t { FAILOVER_DROP_OLDEST, FAILOVER_DROP_NEWEST };
+
+struct failoverQueue_t
 {
-  // Only include JSON schema titles if running on an ESP32
-  #if defined(ESP32)
-  json["title"] = title;
-  #endif
-}
+  uint32_t magic;
+  uint16_t head;
+  uint16_t count;
+  uint32_t dropped;
+  event_t events[FAILOVER_QUEUE_SIZE];
+};
+
+#if defined(FAILOVER_RTC)
+RTC_NOINIT_ATTR failoverQueue_t failover;
+#else
+failoverQueue_t failover;
+#endif
+
+uint8_t failoverDropPolicy = FAILOVER_DROP_OLDEST;
+uint16_t failoverReplayMs = DEFAULT_FAILOVER_REPLAY_MS;
+uint32_t failoverLastReplay = 0;
+
+// Events waiting to be published together (batching is off by default)
+event_t batch[BATCH_MAX_EVENTS];
+uint8_t batchCount = 0;
+uint32_t batchStart = 0;
+
+uint16_t batchWindowMs = 0;
+uint8_t batchMaxEvents = BATCH_MAX_EVENTS;
+
+// Set while a bulk command runs, so its output events are batched too
+bool batchHold = false;
+
+#if defined(PCNT_ROTARY)
+// Rotary input bound to each hardware counter unit, decoded from this
+// and the next GPIO (INVALID_GPIO_PIN if the unit is free)
+uint8_t pcntInput[PCNT_UNITS];
+
+uint16_t pcntIntervalMs = DEFAULT_PCNT_INTERVAL_MS;
+uint32_t pcntLastReport = 0;
+#endif
 
-void setDescription(JsonObject json, char * description)
+/*--------------------------- GPIO Registers --------------------------*/
+// Which hardware input register each GPIO lives in, and its bit there
+#if defined(ESP8266)
+// GPI holds GPIO 0-15, GPIO16 is in its own RTC register (GP16I)
+constexpr uint8_t gpioRegister(uint8_t gpio) { return gpio < 16 ? 0 : 1; }
+constexpr uint8_t gpioRegisterBit(uint8_t gpio) { return gpio < 16 ? gpio : gpio - 16; }
+#else
+// GPIO_IN_REG holds GPIO 0-31, GPIO_IN1_REG holds GPIO 32-39
+constexpr uint8_t gpioRegister(uint8_t gpio) { return gpio >> 5; }
+constexpr uint8_t gpioRegisterBit(uint8_t gpio) { return gpio & 31; }
+#endif
+
+// A run of GPIOs which are consecutive in both a hardware register and
+// our GPIO word, so can be moved across with a single shift and mask
+struct gpioRun_t
 {
-  // Only include JSON schema descriptions if running on an ESP32
-  #if defined(ESP32)
-  json["description"] = description;
-  #endif
-}
+  uint8_t reg;
+  uint8_t regShift;
+  uint8_t indexShift;
+  uint32_t mask;
+};
 
-// Read all input GPIOs at once and make 16-bit result (mimic MCP)
-uint16_t readInputs(void)
+struct gpioRunTable_t
 {
-  uint16_t result = 0xffff;
+  gpioRun_t runs[GPIO_COUNT];
+  uint8_t count;
+  uint8_t registers;
+};
 
-  // Not sure how to do this GPIO input register read on an ESP8266?
-  #if defined(ESP32)
-  uint32_t inReg = REG_READ(GPIO_IN_REG);
-  #endif
+constexpr gpioRunTable_t buildGpioRuns(void)
+{
+  gpioRunTable_t table {};
 
-  for (uint8_t index = 0; index < GPIO_COUNT; index++)
+  for (uint8_t index = 0; index < GPIO_NATIVE_COUNT; index++)
   {
-    if (gpioTypes[index] == GPIO_INPUT)
-    {
-      uint8_t gpio = GPIO_PINS[index];
+    uint8_t reg = gpioRegister(GPIO_PINS[index]);
+    uint8_t bit = gpioRegisterBit(GPIO_PINS[index]);
 
-      #if defined(ESP32)
-      if (!bitRead(inReg, gpio)) { bitClear(result, index); }
-      #else
-      if (!digitalRead(gpio)) { bitClear(result, index); }
-      #endif
+    // Extend the current run if this pin follows on from it
+    if (table.count > 0)
+    {
+      gpioRun_t & run = table.runs[table.count - 1];
+      if (reg == run.reg && bit == run.regShift + (index - run.indexShift))
+      {
+        run.mask = (run.mask << 1) | 1;
+        continue;
+      }
     }
+
+    table.runs[table.count++] = { reg, bit, index, 1 };
+    if (reg >= table.registers) { table.registers = reg + 1; }
   }
-  
-  return result;
+
+  return table;
 }
 
-// Convert GPIO pin (from JSON payload) to 0-based index
-uint8_t getIndexFromGpio(uint8_t gpio)
+// Generated at compile time from GPIO_PINS, e.g. the ESP32 pin map
+// becomes 5 runs, so an input scan is 5 shift/mask/or operations
+constexpr gpioRunTable_t GPIO_RUNS = buildGpioRuns();
+
+// Reverse of GPIO_PINS, so the pin in a payload is found with one lookup
+#if defined(MCP_EXPANDERS)
+#define       GPIO_PIN_LIMIT        (MCP_PIN_BASE + 16 * MCP_EXPANDERS)
+#else
+#define       GPIO_PIN_LIMIT        40
+#endif
+
+struct gpioIndexTable_t
+{
+  uint8_t index[GPIO_PIN_LIMIT];
+};
+
+constexpr gpioIndexTable_t buildGpioIndex(void)
 {
+  gpioIndexTable_t table {};
+
+  for (uint8_t gpio = 0; gpio < GPIO_PIN_LIMIT; gpio++)
+  {
+    table.index[gpio] = INVALID_GPIO_PIN;
+  }
+
   for (uint8_t index = 0; index < GPIO_COUNT; index++)
   {
-    if (gpio == GPIO_PINS[index])
-    {
-      return index;
-    }
+    table.index[GPIO_PINS[index]] = index;
   }
 
-  return INVALID_GPIO_PIN;
+  return table;
 }
 
-void createGpioPinEnum(JsonObject parent)
+constexpr bool gpioPinsInRange()
 {
-  JsonArray pinEnum = parent.createNestedArray("enum");
-
   for (uint8_t index = 0; index < GPIO_COUNT; index++)
   {
-    pinEnum.add(GPIO_PINS[index]);
+    if (GPIO_PINS[index] >= GPIO_PIN_LIMIT) return false;
   }
+  return true;
 }
 
-void createGpioTypeEnum(JsonObject parent)
+static_assert(gpioPinsInRange(), "GPIO_PINS must all be below GPIO_PIN_LIMIT");
+
+constexpr gpioIndexTable_t GPIO_INDEX = buildGpioIndex();
+
+#if defined(INPUT_INTERRUPTS) || defined(TIMER_SCHEDULER)
+// Input word captured on each GPIO edge (or timer sample which saw a
+// change), timestamped so it can be replayed with its original timing
+struct inputSample_t
 {
-  JsonArray typeEnum = parent.createNestedArray("enum");
-  
-  typeEnum.add("input");
-  typeEnum.add("output");
-}
+  uint32_t timestamp;
+  gpioWord_t value;
+  #if defined(LATENCY_STATS)
+  uint32_t sampledMicros;
+  #endif
+};
+
+SpscRing<inputSample_t, INPUT_CAPTURE_SIZE> inputCapture;
+volatile gpioWord_t inputCaptureValue = (gpioWord_t)~0ULL;
+
+// How far (ms) replay is running behind the captured edges
+uint32_t inputReplayLag = 0;
+uint32_t inputReplayTime = 0;
+gpioWord_t inputReplayValue = (gpioWord_t)~0ULL;
+#if defined(LATENCY_STATS)
+uint32_t inputReplayMicros = 0;
+#endif
+#endif
 
-JsonObject createGpioTypeDependency(JsonArray parent, uint8_t type)
+#if defined(INPUT_TRACE)
+// Ring of input words recorded by traceInputs(), overwriting the oldest
+struct inputTraceSample_t
 {
-  JsonObject element = parent.createNestedObject();
-  JsonObject elementProperties = element.createNestedObject("properties");
-  JsonObject elementType = elementProperties.createNestedObject("type");
+  uint32_t timestamp;
+  uint16_t gapMs;
+  gpioWord_t value;
+};
+
+inputTraceSample_t inputTrace[INPUT_TRACE_SIZE];
+uint16_t inputTraceHead = 0;
+uint16_t inputTraceCount = 0;
+
+uint32_t inputTraceLastCall = 0;
+gpioWord_t inputTraceValue = 0;
+volatile bool inputTracePaused = false;
+#endif
 
-  JsonArray elementTypeEnum = elementType.createNestedArray("enum");
-  switch (type)
-  {
-    case GPIO_INPUT:
-      elementTypeEnum.add("input");
-      return elementProperties.createNestedObject("input");
+#if defined(TIMER_SCHEDULER)
+// Samples taken since the loop was last woken
+volatile uint8_t schedulerTicks = 0;
 
-    case GPIO_OUTPUT:
-      elementTypeEnum.add("output");
-      return elementProperties.createNestedObject("output");
+#if defined(ESP32)
+esp_timer_handle_t schedulerTimer;
+TaskHandle_t schedulerTask;
+#elif defined(ESP8266)
+os_timer_t schedulerTimer;
+volatile bool schedulerNotified = false;
+#endif
+#endif
 
-    default:
-      // Should never get here
-      return elementProperties;
-  }
-}
+#if defined(IO_TASK)
+// Output commands received by the network task, handled by the I/O task
+enum ioCommandKind_t { IO_COMMAND_OUTPUT, IO_COMMAND_PWM };
 
-uint8_t parseGpioType(const char * gpioType)
+struct ioCommand_t
 {
-  if (strcmp(gpioType, "input")   == 0) { return GPIO_INPUT; }
-  if (strcmp(gpioType, "output")  == 0) { return GPIO_OUTPUT; }
+  uint8_t kind;
+  uint8_t index;
+  uint8_t command;          // relay on/off (outputs) or level % (pwm outputs)
+  uint32_t fadeMs;          // pwm outputs
+  #if defined(LATENCY_STATS)
+  uint32_t receivedMicros;
+  #endif
+};
 
-  oxrs.println(F("[digio] invalid GPIO type"));
-  return INVALID_GPIO_TYPE;
-}
+// Events raised by the I/O task, published by the network task
+SpscRing<event_t, IO_EVENT_QUEUE_SIZE> ioEvents;
+SpscRing<ioCommand_t, IO_COMMAND_QUEUE_SIZE> ioCommands;
 
-void createInputTypeEnum(JsonObject parent)
-{
-  JsonArray typeEnum = parent.createNestedArray("enum");
-  
-  typeEnum.add("button");
-  typeEnum.add("contact");
-  typeEnum.add("press");
-  typeEnum.add("rotary");
-  typeEnum.add("security");
-  typeEnum.add("switch");
-  typeEnum.add("toggle");
-}
+// Events dropped with ioEvents full, as of the last report
+uint32_t ioEventsDropped = 0;
 
-uint8_t parseInputType(const char * inputType)
-{
-  if (strcmp(inputType, "button")   == 0) { return BUTTON; }
-  if (strcmp(inputType, "contact")  == 0) { return CONTACT; }
-  if (strcmp(inputType, "press")    == 0) { return PRESS; }
-  if (strcmp(inputType, "rotary")   == 0) { return ROTARY; }
-  if (strcmp(inputType, "security") == 0) { return SECURITY; }
-  if (strcmp(inputType, "switch")   == 0) { return SWITCH; }
-  if (strcmp(inputType, "toggle")   == 0) { return TOGGLE; }
+// Held by the I/O task while scanning, and by the network task while
+// applying config, so handler state is never changed mid-scan
+SemaphoreHandle_t ioMutex;
 
-  oxrs.println(F("[digio] invalid input type"));
-  return INVALID_INPUT_TYPE;
-}
+// For its stack high-water mark
+TaskHandle_t ioTaskHandle = NULL;
+#endif
+
+#if defined(LATENCY_STATS)
+// When the current input scan was sampled
+uint32_t inputSampleMicros = 0;
+#endif
+
+/*--------------------------- Instantiate Globals ---------------------*/
+// Board support (see digio.h)
+oxrs_t oxrs;
+
+// Input handlers, one per bank
+OXRS_Input oxrsInput[GPIO_BANKS];
+
+// Output handlers, one per bank
+OXRS_Output oxrsOutput[GPIO_BANKS];
+
+/*--------------------------- Program ---------------------------------*/
+#if defined(INPUT_TRACE)
+void traceInputs(gpioWord_t value);
+#endif
+void resetStorm(uint8_t index);
 
-void getInputType(char inputType[], uint8_t type)
+// Set the type in our internal config and update the physical pin mode
+void setGpioType(uint8_t index, uint8_t type)
 {
-  // Determine what type of input we have
-  sprintf_P(inputType, PSTR("error"));
-  switch (type)
+  // Switch an output off in its handler before it stops being one, so it
+  // isn't left 'on' there (or with a timer running) while the pin is off
+  if (gpioTypes[index] == GPIO_OUTPUT && type != GPIO_OUTPUT && !bitRead(pwmMask, index))
   {
-    case BUTTON:
-      sprintf_P(inputType, PSTR("button"));
-      break;
-    case CONTACT:
-      sprintf_P(inputType, PSTR("contact"));
-      break;
-    case PRESS:
-      sprintf_P(inputType, PSTR("press"));
-      break;
-    case ROTARY:
-      sprintf_P(inputType, PSTR("rotary"));
-      break;
-    case SECURITY:
-      sprintf_P(inputType, PSTR("security"));
-      break;
-    case SWITCH:
-      sprintf_P(inputType, PSTR("switch"));
-      break;
-    case TOGGLE:
-      sprintf_P(inputType, PSTR("toggle"));
-      break;
+    commandOutput(index, RELAY_OFF);
   }
-}
 
-void getInputEventType(char eventType[], uint8_t type, uint8_t state)
-{
-  // Determine what event we need to publish
-  sprintf_P(eventType, PSTR("error"));
-  switch (type)
+  // Nor is a rule's pulse left to switch it off later
+  rulePulseOff[index] = 0;
+
+  // update the GPIO type in our internal config
+  gpioTypes[index] = type;
+  gpioConfig[index].gpioType = type;
+  gpioWrite(inputMask, index, type == GPIO_INPUT);
+
+  #if defined(MCP_EXPANDERS)
+  // Expander pins are (re)configured over I2C by writeExpanders(), an
+  // output's latch is written first so it comes up off
+  if (!isNativeGpio(index))
   {
-    case BUTTON:
-      switch (state)
-      {
-        case HOLD_EVENT:
-          sprintf_P(eventType, PSTR("hold"));
-          break;
-        case 1:
-          sprintf_P(eventType, PSTR("single"));
-          break;
-        case 2:
-          sprintf_P(eventType, PSTR("double"));
-          break;
-        case 3:
-          sprintf_P(eventType, PSTR("triple"));
-          break;
-        case 4:
-          sprintf_P(eventType, PSTR("quad"));
-          break;
-        case 5:
-          sprintf_P(eventType, PSTR("penta"));
-          break;
-      }
-      break;
-    case CONTACT:
-      switch (state)
-      {
-        case LOW_EVENT:
-          sprintf_P(eventType, PSTR("closed"));
-          break;
-        case HIGH_EVENT:
-          sprintf_P(eventType, PSTR("open"));
-          break;
-      }
-      break;
-    case PRESS:
-      sprintf_P(eventType, PSTR("press"));
-      break;
-    case ROTARY:
-      switch (state)
-      {
-        case LOW_EVENT:
-          sprintf_P(eventType, PSTR("up"));
-          break;
-        case HIGH_EVENT:
-          sprintf_P(eventType, PSTR("down"));
-          break;
-      }
-      break;
-    case SECURITY:
-      switch (state)
+    bitSet(mcpConfigDirty, (index - GPIO_NATIVE_COUNT) / 16);
+    if (type == GPIO_OUTPUT)
+    {
+      gpioWrite(outputState, index, RELAY_OFF);
+      outputDirty |= gpioBit(index);
+    }
+  }
+  #endif
+
+  // get the GPIO pin
+  uint8_t gpio = GPIO_PINS[index];
+
+  // configure the GPIO pin itself (if it's on the chip)
+  switch (isNativeGpio(index) ? type : INVALID_GPIO_TYPE)
+  {
+    case GPIO_INPUT:
+      // Never written now, even if just switched off above
+      outputDirty &= ~gpioBit(index);
+      pinMode(gpio, INPUT_PULLUP);
+      #if defined(INPUT_INTERRUPTS)
+      // Any without an interrupt are only seen by replayInputs() polling
+      // once capture has caught up (or with an edge on another input)
+      if (isInterruptGpio(index))
       {
-        case HIGH_EVENT:
-          sprintf_P(eventType, PSTR("normal"));
-          break;
-        case LOW_EVENT:
-          sprintf_P(eventType, PSTR("alarm"));
-          break;
-        case TAMPER_EVENT:
-          sprintf_P(eventType, PSTR("tamper"));
-          break;
-        case SHORT_EVENT:
-          sprintf_P(eventType, PSTR("short"));
-          break;
-        case FAULT_EVENT:
-          sprintf_P(eventType, PSTR("fault"));
-          break;
+        attachInterrupt(digitalPinToInterrupt(gpio), inputEdgeIsr, CHANGE);
       }
+      #endif
       break;
-    case SWITCH:
-      switch (state)
+
+    case GPIO_OUTPUT:
+      #if defined(INPUT_INTERRUPTS)
+      if (isInterruptGpio(index))
       {
-        case LOW_EVENT:
-          sprintf_P(eventType, PSTR("on"));
-          break;
-        case HIGH_EVENT:
-          sprintf_P(eventType, PSTR("off"));
-          break;
+        detachInterrupt(digitalPinToInterrupt(gpio));
       }
-      break;
-    case TOGGLE:
-      sprintf_P(eventType, PSTR("toggle"));
+      #endif
+      pinMode(gpio, OUTPUT);
+      digitalWrite(gpio, RELAY_OFF);
+      gpioWrite(outputState, index, RELAY_OFF);
+      outputDirty &= ~gpioBit(index);
       break;
   }
+
+  // Start (or stop) counting if this is a counter input, and hand the
+  // pin to (or back from) PWM
+  updateCounter(index);
+  updatePwm(index);
 }
 
-void createOutputTypeEnum(JsonObject parent)
+// Read a raw hardware input register (see gpioRegister())
+inline __attribute__((always_inline)) uint32_t readInputRegister(uint8_t reg)
 {
-  JsonArray typeEnum = parent.createNestedArray("enum");
-
-  typeEnum.add("relay");
-  typeEnum.add("motor");
-  typeEnum.add("timer");
+  #if defined(ESP32)
+  return reg == 0 ? REG_READ(GPIO_IN_REG) : REG_READ(GPIO_IN1_REG);
+  #elif defined(ESP8266)
+  return reg == 0 ? GPI : GP16I;
+  #else
+  return nativeReadRegister(reg);
+  #endif
 }
 
-uint8_t parseOutputType(const char *outputType)
+// Read all input GPIOs at once into a GPIO word (16 bits per bank)
+gpioWord_t IRAM_ATTR readInputs(void)
 {
-  if (strcmp(outputType, "relay") == 0)
-  {
-    return RELAY;
-  }
-  if (strcmp(outputType, "motor") == 0)
+  uint32_t regs[GPIO_RUNS.registers];
+  for (uint8_t reg = 0; reg < GPIO_RUNS.registers; reg++)
   {
-    return MOTOR;
+    regs[reg] = readInputRegister(reg);
   }
-  if (strcmp(outputType, "timer") == 0)
+
+  gpioWord_t result = 0;
+  for (uint8_t run = 0; run < GPIO_RUNS.count; run++)
   {
-    return TIMER;
+    const gpioRun_t & gpioRun = GPIO_RUNS.runs[run];
+    result |= (gpioWord_t)((regs[gpioRun.reg] >> gpioRun.regShift) & gpioRun.mask) << gpioRun.indexShift;
   }
 
-  oxrs.println(F("[digio] invalid output type"));
-  return INVALID_OUTPUT_TYPE;
-}
+  #if defined(MCP_EXPANDERS)
+  // Expanders are only read when they raise INT, see scanExpanders()
+  result |= mcpInputs;
+  #endif
 
-void getOutputType(char outputType[], uint8_t type)
-{
-  // Determine what type of output we have
-  sprintf_P(outputType, PSTR("error"));
-  switch (type)
-  {
-  case MOTOR:
-      sprintf_P(outputType, PSTR("motor"));
-      break;
-  case RELAY:
-      sprintf_P(outputType, PSTR("relay"));
-      break;
-  case TIMER:
-      sprintf_P(outputType, PSTR("timer"));
-      break;
-  }
+  // Anything not configured as an input reads high (i.e. inactive)
+  return result | ~inputMask;
 }
 
-void getOutputEventType(char eventType[], uint8_t type, uint8_t state)
+#if defined(INPUT_INTERRUPTS)
+// Capture the input word on every edge of any input GPIO
+void IRAM_ATTR inputEdgeIsr(void)
 {
-  // Determine what event we need to publish
-  sprintf_P(eventType, PSTR("error"));
-  switch (state)
-  {
-  case RELAY_ON:
-      sprintf_P(eventType, PSTR("on"));
-      break;
-  case RELAY_OFF:
-      sprintf_P(eventType, PSTR("off"));
-      break;
-  }
+  gpioWord_t value = readInputs();
+
+  // Several pins can fire for the same change, only keep actual changes
+  if (value == inputCaptureValue) return;
+  inputCaptureValue = value;
+
+  inputSample_t sample = {};
+  sample.timestamp = millis();
+  sample.value = value;
+  #if defined(LATENCY_STATS)
+  sample.sampledMicros = micros();
+  #endif
+  inputCapture.push(sample);
 }
+#endif
 
+#if defined(TIMER_SCHEDULER)
 /**
- Status publishing
+  Fixed-rate scheduler
 */
-void publishInputEvent(uint8_t index, uint8_t type, uint8_t state)
+void IRAM_ATTR schedulerNotify(void)
 {
-  char inputType[9];
-  getInputType(inputType, type);
-  char eventType[7];
-  getInputEventType(eventType, type, state);
+  #if defined(ESP32)
+  xTaskNotifyGive(schedulerTask);
+  #elif defined(ESP8266)
+  schedulerNotified = true;
+  esp_schedule();
+  #else
+  nativeNotify();
+  #endif
+}
 
-  StaticJsonDocument<64> json;
-  json["gpio"] = GPIO_PINS[index];
-  json["type"] = inputType;
-  json["event"] = eventType;
+// Sample the inputs on every timer tick, capturing any change for replay,
+// and wake the loop on a change or once a ms to process inputs/outputs
+void IRAM_ATTR schedulerTick(void)
+{
+  gpioWord_t value = readInputs();
+  bool changed = value != inputCaptureValue;
 
-  if (!oxrs.publishStatus(json.as<JsonVariant>()))
+  if (changed)
   {
-    oxrs.print(F("[digio] [failover] "));
-    serializeJson(json, oxrs);
-    oxrs.println();
+    inputCaptureValue = value;
+
+    inputSample_t sample = {};
+    sample.timestamp = millis();
+    sample.value = value;
+    #if defined(LATENCY_STATS)
+    sample.sampledMicros = micros();
+    #endif
+    inputCapture.push(sample);
+  }
 
-    // TODO: add failover handling code here
+  if (changed || ++schedulerTicks >= SCHEDULER_TICKS_PER_MS)
+  {
+    schedulerTicks = 0;
+    schedulerNotify();
   }
 }
 
-void publishOutputEvent(uint8_t index, uint8_t type, uint8_t state)
+#if defined(ESP32) || defined(ESP8266)
+void IRAM_ATTR schedulerTimerCallback(void * arg)
 {
-  char outputType[8];
-  getOutputType(outputType, type);
-  char eventType[7];
-  getOutputEventType(eventType, type, state);
-
-  StaticJsonDocument<64> json;
-  json["gpio"] = GPIO_PINS[index];
-  json["type"] = outputType;
-  json["event"] = eventType;
-
-  if (!oxrs.publishStatus(json.as<JsonVariant>()))
-  {
-    oxrs.print(F("[digio] [failover] "));
-    serializeJson(json, oxrs);
-    oxrs.println();
-
-    // TODO: add failover handling code here
-  }
+  schedulerTick();
 }
+#endif
 
-/**
-  Config handler
- */
-void inputConfigSchema(JsonObject json)
+void startScheduler(void)
 {
-  JsonObject type = json.createNestedObject("type");
-  setTitle(type, "Type (defaults to 'switch')");
-  createInputTypeEnum(type);
+  #if defined(ESP32)
+  // Dispatched from the esp_timer task, so it's safe to notify the loop
+  schedulerTask = xTaskGetCurrentTaskHandle();
+
+  esp_timer_create_args_t args = {};
+  args.callback = schedulerTimerCallback;
+  args.name = "digio";
+  esp_timer_create(&args, &schedulerTimer);
+  esp_timer_start_periodic(schedulerTimer, SCHEDULER_PERIOD_US);
+  #elif defined(ESP8266)
+  // Runs in the system context, i.e. whenever the loop yields
+  os_timer_setfn(&schedulerTimer, schedulerTimerCallback, NULL);
+  os_timer_arm(&schedulerTimer, SCHEDULER_PERIOD_US / 1000, true);
+  #else
+  nativeStartTimer(SCHEDULER_PERIOD_US, schedulerTick);
+  #endif
 
-  JsonObject invert = json.createNestedObject("invert");
-  setTitle(invert, "Invert");
-  invert["type"] = "boolean";
+  oxrs.print(F("[digio] sampling inputs at "));
+  oxrs.print(SCHEDULER_RATE_HZ);
+  oxrs.println(F("Hz"));
+}
 
-  JsonObject disabled = json.createNestedObject("disabled");
-  setTitle(disabled, "Disabled");
-  disabled["type"] = "boolean";
+// Block until the timer wakes us, rather than sleeping a fixed 1ms
+void waitScheduler(void)
+{
+  #if defined(ESP32)
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SCHEDULER_MAX_WAIT_MS));
+  #elif defined(ESP8266)
+  esp_delay(SCHEDULER_MAX_WAIT_MS, []() { return !schedulerNotified; });
+  schedulerNotified = false;
+  #else
+  nativeWaitNotify(SCHEDULER_MAX_WAIT_MS * 1000);
+  #endif
 }
+#endif
 
-void outputConfigSchema(JsonObject json)
+// Hand each bank of the input word to its own input handler
+void processInputs(gpioWord_t value)
 {
-  JsonObject type = json.createNestedObject("type");
-  setTitle(type, "Type (defaults to 'relay')");
-  createOutputTypeEnum(type);
+  #if defined(INPUT_TRACE)
+  traceInputs(value);
+  #endif
 
-  JsonObject timerSeconds = json.createNestedObject("timerSeconds");
-  setTitle(timerSeconds, "Timer (seconds, defaults to 60s)");
-  timerSeconds["type"] = "integer";
-  timerSeconds["minimum"] = 1;
+  for (uint8_t bank = 0; bank < GPIO_BANKS; bank++)
+  {
+    oxrsInput[bank].process(bank, (uint16_t)(value >> (bank * GPIO_BANK_SIZE)));
+  }
+}
 
-  JsonObject interlockGpio = json.createNestedObject("interlockGpio");
-  setTitle(interlockGpio, "Interlock GPIO");
-  createGpioPinEnum(interlockGpio);
+#if defined(INPUT_INTERRUPTS) || defined(TIMER_SCHEDULER)
+// Process the value replay is holding, timed (for latency stats) from
+// when it was captured rather than when it is replayed
+void processReplayValue(void)
+{
+  #if defined(LATENCY_STATS)
+  inputSampleMicros = inputReplayMicros;
+  #endif
+  processInputs(inputReplayValue);
 }
 
-void setConfigSchema()
+// Feed captured edges to the input handler one per pass, keeping their
+// original spacing so debounce and multi-click timing is unaffected by
+// how long the loop stalled (e.g. during an MQTT reconnect)
+void replayInputs(void)
 {
-  // Define our config schema
-  DynamicJsonDocument json(JSON_CONFIG_MAX_SIZE);
+  inputSample_t sample;
+
+  if (!inputCapture.peek(sample))
+  {
+    // Only catch up once the last edge has been held long enough that
+    // closing the gap to the next one can't upset debounce/click timing
+    if (inputReplayLag && (millis() - inputReplayTime) >= INPUT_REPLAY_SETTLE_MS)
+    {
+      inputReplayLag = 0;
+    }
 
-  JsonObject gpios = json.createNestedObject("gpios");
-  setTitle(gpios, "GPIO Configuration");
-  setDescription(gpios, "Add configuration for each GPIO in use on your device.");
-  gpios["type"] = "array";
+    // Caught up, poll directly (also catches anything capture missed)
+    if (inputReplayLag == 0)
+    {
+      inputReplayValue = readInputs();
+      #if defined(LATENCY_STATS)
+      inputReplayMicros = micros();
+      #endif
+    }
 
-  JsonObject items = gpios.createNestedObject("items");
-  items["type"] = "object";
+    processReplayValue();
+    return;
+  }
 
-  JsonObject properties = items.createNestedObject("properties");
+  // Hold the current value until this edge is due
+  uint32_t age = millis() - sample.timestamp;
+  if (age < inputReplayLag)
+  {
+    processReplayValue();
+    return;
+  }
 
-  JsonObject gpio = properties.createNestedObject("gpio");
-  setTitle(gpio, "GPIO Pin");
-  createGpioPinEnum(gpio);
+  // Present the held value once more before moving on, in case a stall
+  // meant the handler has only seen it once and not debounced it yet
+  processReplayValue();
 
-  JsonObject type = properties.createNestedObject("type");
-  setTitle(type, "GPIO Type");
-  createGpioTypeEnum(type);
+  inputCapture.pop(sample);
+  inputReplayLag = age;
+  inputReplayTime = millis();
+  inputReplayValue = sample.value;
+  #if defined(LATENCY_STATS)
+  inputReplayMicros = sample.sampledMicros;
+  #endif
+  processReplayValue();
+}
+#endif
 
-  // Can only do the fancy UI schema dependencies on an ESP32 as on
-  // an ESP8266 the JSON schema size blows the memory limits
+#if defined(PCNT_ROTARY)
+/**
+  Hardware rotary counters
+*/
+// Count each quadrature cycle - up on rising edges of A while B is low
+// (A leads), down while B is high - ignoring glitches below the filter
+void pcntAttach(uint8_t unit, uint8_t pinA, uint8_t pinB)
+{
   #if defined(ESP32)
-  JsonObject dependencies = items.createNestedObject("dependencies");
-  JsonObject dependenciesType = dependencies.createNestedObject("type");
-  JsonArray dependenciesOneOf = dependenciesType.createNestedArray("oneOf");
-  JsonObject input = createGpioTypeDependency(dependenciesOneOf, GPIO_INPUT);
-  JsonObject output = createGpioTypeDependency(dependenciesOneOf, GPIO_OUTPUT);
+  pcnt_config_t config = {};
+  config.pulse_gpio_num = pinA;
+  config.ctrl_gpio_num = pinB;
+  config.channel = PCNT_CHANNEL_0;
+  config.unit = (pcnt_unit_t)unit;
+  config.pos_mode = PCNT_COUNT_INC;
+  config.neg_mode = PCNT_COUNT_DIS;
+  config.lctrl_mode = PCNT_MODE_KEEP;
+  config.hctrl_mode = PCNT_MODE_REVERSE;
+  config.counter_h_lim = INT16_MAX;
+  config.counter_l_lim = INT16_MIN;
+  pcnt_unit_config(&config);
+
+  pcnt_set_filter_value((pcnt_unit_t)unit, PCNT_FILTER_CYCLES);
+  pcnt_filter_enable((pcnt_unit_t)unit);
+
+  pcnt_counter_pause((pcnt_unit_t)unit);
+  pcnt_counter_clear((pcnt_unit_t)unit);
+  pcnt_counter_resume((pcnt_unit_t)unit);
   #else
-  JsonObject input = properties.createNestedObject("input");
-  JsonObject output = properties.createNestedObject("output");
+  nativePcntConfig(unit, pinA, pinB);
   #endif
+}
+
+void pcntDetach(uint8_t unit)
+{
+  #if defined(ESP32)
+  pcnt_counter_pause((pcnt_unit_t)unit);
+  pcnt_counter_clear((pcnt_unit_t)unit);
+  #else
+  nativePcntConfig(unit, NATIVE_PCNT_NO_PIN, NATIVE_PCNT_NO_PIN);
+  #endif
+}
+
+// Read and clear the steps counted since the last call (the counter
+// keeps running, so at most a step landing between the two is lost)
+int16_t pcntTake(uint8_t unit)
+{
+  #if defined(ESP32)
+  int16_t count = 0;
+  pcnt_get_counter_value((pcnt_unit_t)unit, &count);
+  pcnt_counter_clear((pcnt_unit_t)unit);
+  return count;
+  #else
+  return nativePcntTake(unit);
+  #endif
+}
+#endif
+
+// Drive the set/clear registers (pins not in either mask are untouched)
+inline __attribute__((always_inline)) void writeOutputRegister(uint8_t reg, uint32_t set, uint32_t clear)
+{
+  #if defined(ESP32)
+  if (set)   { REG_WRITE(reg == 0 ? GPIO_OUT_W1TS_REG : GPIO_OUT1_W1TS_REG, set); }
+  if (clear) { REG_WRITE(reg == 0 ? GPIO_OUT_W1TC_REG : GPIO_OUT1_W1TC_REG, clear); }
+  #elif defined(ESP8266)
+  if (reg == 0)
+  {
+    if (set)   { GPOS = set; }
+    if (clear) { GPOC = clear; }
+  }
+  else
+  {
+    // GPIO16 has no set/clear registers
+    GP16O = (GP16O & ~clear) | set;
+  }
+  #else
+  nativeWriteRegister(reg, set, clear);
+  #endif
+}
+
+// Write every changed output at once, so all outputs switched by a
+// command (or interlocked pair) change state in the same instant
+void writeOutputs(void)
+{
+  #if defined(MCP_EXPANDERS)
+  // Expander outputs (and pin directions) are written over I2C
+  writeExpanders();
+  #endif
+
+  if (!outputDirty) return;
+
+  // PWM outputs are driven by their channel, never written directly
+  gpioWord_t outputs = outputDirty & ~pwmMask;
+
+  uint32_t set[GPIO_RUNS.registers] = {};
+  uint32_t clear[GPIO_RUNS.registers] = {};
+
+  for (uint8_t run = 0; run < GPIO_RUNS.count; run++)
+  {
+    const gpioRun_t & gpioRun = GPIO_RUNS.runs[run];
+    uint32_t dirty = (uint32_t)((outputs >> gpioRun.indexShift) & gpioRun.mask) << gpioRun.regShift;
+    uint32_t state = (uint32_t)((outputState >> gpioRun.indexShift) & gpioRun.mask) << gpioRun.regShift;
+
+    set[gpioRun.reg] |= dirty & state;
+    clear[gpioRun.reg] |= dirty & ~state;
+  }
+
+  for (uint8_t reg = 0; reg < GPIO_RUNS.registers; reg++)
+  {
+    writeOutputRegister(reg, set[reg], clear[reg]);
+  }
+
+  #if defined(LATENCY_STATS)
+  recordOutputLatency(outputDirty);
+  #endif
+
+  outputDirty = 0;
+}
+
+// Convert GPIO pin (from JSON payload) to 0-based index
+uint8_t getIndexFromGpio(uint8_t gpio)
+{
+  if (gpio >= GPIO_PIN_LIMIT) return INVALID_GPIO_PIN;
+  return GPIO_INDEX.index[gpio];
+}
+
+uint8_t parseGpioType(const char * gpioType)
+{
+  if (strcmp(gpioType, "input")   == 0) { return GPIO_INPUT; }
+  if (strcmp(gpioType, "output")  == 0) { return GPIO_OUTPUT; }
+
+  oxrs.println(F("[digio] invalid GPIO type"));
+  return INVALID_GPIO_TYPE;
+}
+
+uint8_t parseInputType(const char * inputType)
+{
+  if (strcmp(inputType, "button")   == 0) { return BUTTON; }
+  if (strcmp(inputType, "contact")  == 0) { return CONTACT; }
+  if (strcmp(inputType, "press")    == 0) { return PRESS; }
+  if (strcmp(inputType, "rotary")   == 0) { return ROTARY; }
+  if (strcmp(inputType, "security") == 0) { return SECURITY; }
+  if (strcmp(inputType, "switch")   == 0) { return SWITCH; }
+  if (strcmp(inputType, "toggle")   == 0) { return TOGGLE; }
+  if (strcmp(inputType, "counter")  == 0) { return COUNTER; }
+
+  oxrs.println(F("[digio] invalid input type"));
+  return INVALID_INPUT_TYPE;
+}
+
+// Event names are looked up rather than formatted (see name_t)
+#define       NAME_STRING(name)     static const char NAME_##name[] PROGMEM = #name
+#define       NAME_OF(name)         reinterpret_cast<name_t>(NAME_##name)
+
+NAME_STRING(button);
+NAME_STRING(contact);
+NAME_STRING(press);
+NAME_STRING(rotary);
+NAME_STRING(security);
+NAME_STRING(switch);
+NAME_STRING(toggle);
+NAME_STRING(counter);
+
+NAME_STRING(hold);
+NAME_STRING(single);
+NAME_STRING(double);
+NAME_STRING(triple);
+NAME_STRING(quad);
+NAME_STRING(penta);
+NAME_STRING(closed);
+NAME_STRING(open);
+NAME_STRING(up);
+NAME_STRING(down);
+NAME_STRING(normal);
+NAME_STRING(alarm);
+NAME_STRING(tamper);
+NAME_STRING(short);
+NAME_STRING(fault);
+NAME_STRING(on);
+NAME_STRING(off);
+NAME_STRING(suppressed);
+NAME_STRING(released);
+
+NAME_STRING(relay);
+NAME_STRING(motor);
+NAME_STRING(timer);
+NAME_STRING(pwm);
+NAME_STRING(level);
+
+NAME_STRING(error);
+
+struct inputNames_t
+{
+  const char * types[INPUT_TYPE_COUNT];
+  const char * events[INPUT_TYPE_COUNT][INPUT_EVENT_COUNT];
+};
+
+constexpr inputNames_t buildInputNames()
+{
+  inputNames_t names = {};
+
+  names.types[BUTTON]   = NAME_button;
+  names.types[CONTACT]  = NAME_contact;
+  names.types[PRESS]    = NAME_press;
+  names.types[ROTARY]   = NAME_rotary;
+  names.types[SECURITY] = NAME_security;
+  names.types[SWITCH]   = NAME_switch;
+  names.types[TOGGLE]   = NAME_toggle;
+  names.types[COUNTER]  = NAME_counter;
+
+  names.events[BUTTON][HOLD_EVENT] = NAME_hold;
+  names.events[BUTTON][1] = NAME_single;
+  names.events[BUTTON][2] = NAME_double;
+  names.events[BUTTON][3] = NAME_triple;
+  names.events[BUTTON][4] = NAME_quad;
+  names.events[BUTTON][5] = NAME_penta;
+
+  names.events[CONTACT][LOW_EVENT]  = NAME_closed;
+  names.events[CONTACT][HIGH_EVENT] = NAME_open;
+
+  // Press and toggle inputs only ever raise the one event
+  for (uint8_t state = 0; state < INPUT_EVENT_COUNT; state++)
+  {
+    names.events[PRESS][state]  = NAME_press;
+    names.events[TOGGLE][state] = NAME_toggle;
+  }
+
+  names.events[ROTARY][LOW_EVENT]  = NAME_up;
+  names.events[ROTARY][HIGH_EVENT] = NAME_down;
+
+  names.events[SECURITY][HIGH_EVENT]   = NAME_normal;
+  names.events[SECURITY][LOW_EVENT]    = NAME_alarm;
+  names.events[SECURITY][TAMPER_EVENT] = NAME_tamper;
+  names.events[SECURITY][SHORT_EVENT]  = NAME_short;
+  names.events[SECURITY][FAULT_EVENT]  = NAME_fault;
+
+  names.events[SWITCH][LOW_EVENT]  = NAME_on;
+  names.events[SWITCH][HIGH_EVENT] = NAME_off;
+
+  // Counters publish totals (see publishCounter), they raise no events
+
+  return names;
+}
+
+constexpr inputNames_t INPUT_NAMES PROGMEM = buildInputNames();
+
+// Read a name from a table, which may be in flash
+const char * readName(const char * const * entry)
+{
+  return (const char *)pgm_read_ptr(entry);
+}
+
+// Name of an input event, as stored in the table (so in flash on
+// ESP8266), NULL if that type of input has no such event
+const char * readInputEventName(uint8_t type, uint8_t state)
+{
+  return readName(&INPUT_NAMES.events[type][state]);
+}
+
+name_t getInputType(uint8_t type)
+{
+  if (type >= INPUT_TYPE_COUNT) return NAME_OF(error);
+  return reinterpret_cast<name_t>(readName(&INPUT_NAMES.types[type]));
+}
+
+name_t getInputEventType(uint8_t type, uint8_t state)
+{
+  // Raised by the rate limit, for any type of input
+  if (state == STORM_EVENT)         return NAME_OF(suppressed);
+  if (state == STORM_RELEASE_EVENT) return NAME_OF(released);
+
+  if (type >= INPUT_TYPE_COUNT || state >= INPUT_EVENT_COUNT) return NAME_OF(error);
+
+  const char * eventType = readName(&INPUT_NAMES.events[type][state]);
+  return eventType ? reinterpret_cast<name_t>(eventType) : NAME_OF(error);
+}
+
+uint8_t parseOutputType(const char *outputType)
+{
+  if (strcmp(outputType, "relay") == 0)
+  {
+    return RELAY;
+  }
+  if (strcmp(outputType, "motor") == 0)
+  {
+    return MOTOR;
+  }
+  if (strcmp(outputType, "timer") == 0)
+  {
+    return TIMER;
+  }
+  if (strcmp(outputType, "pwm") == 0)
+  {
+    return PWM;
+  }
+
+  oxrs.println(F("[digio] invalid output type"));
+  return INVALID_OUTPUT_TYPE;
+}
+
+#define       OUTPUT_TYPE_COUNT     (PWM + 1)
+
+struct outputNames_t
+{
+  const char * types[OUTPUT_TYPE_COUNT];
+};
+
+constexpr outputNames_t buildOutputNames()
+{
+  outputNames_t names = {};
+
+  names.types[RELAY] = NAME_relay;
+  names.types[MOTOR] = NAME_motor;
+  names.types[TIMER] = NAME_timer;
+  names.types[PWM]   = NAME_pwm;
+
+  return names;
+}
+
+constexpr outputNames_t OUTPUT_NAMES PROGMEM = buildOutputNames();
+
+name_t getOutputType(uint8_t type)
+{
+  if (type >= OUTPUT_TYPE_COUNT) return NAME_OF(error);
+
+  const char * outputType = readName(&OUTPUT_NAMES.types[type]);
+  return outputType ? reinterpret_cast<name_t>(outputType) : NAME_OF(error);
+}
+
+name_t getOutputEventType(uint8_t type, uint8_t state)
+{
+  if (type == PWM)        return NAME_OF(level);
+  if (state == RELAY_ON)  return NAME_OF(on);
+  if (state == RELAY_OFF) return NAME_OF(off);
+  return NAME_OF(error);
+}
+
+// Serialise access to the I/O handlers with the I/O task (if enabled)
+void lockIO(void)
+{
+  #if defined(IO_TASK)
+  xSemaphoreTake(ioMutex, portMAX_DELAY);
+  #endif
+}
+
+void unlockIO(void)
+{
+  #if defined(IO_TASK)
+  xSemaphoreGive(ioMutex);
+  #endif
+}
+
+#if defined(INPUT_TRACE)
+/**
+  Input trace
+*/
+// Record the input word if it changed, or if the handlers haven't been
+// called for a while (e.g. a stall), so a host can replay exactly what
+// they saw and when (see bench/bench_trace.cpp)
+void traceInputs(gpioWord_t value)
+{
+  if (inputTracePaused) return;
+
+  uint32_t now = millis();
+  uint32_t gap = now - inputTraceLastCall;
+  inputTraceLastCall = now;
+
+  if (value == inputTraceValue && gap < INPUT_TRACE_GAP_MS) return;
+  inputTraceValue = value;
+
+  inputTrace[inputTraceHead] = { now, (uint16_t)min(gap, (uint32_t)0xffff), value };
+  inputTraceHead = (inputTraceHead + 1) % INPUT_TRACE_SIZE;
+  if (inputTraceCount < INPUT_TRACE_SIZE) { inputTraceCount++; }
+}
+
+// One sample per line, oldest first - "<timestamp ms> <inputs> <gap ms>"
+void apiTrace(Request & req, Response & res)
+{
+  // Recording is paused (rather than the I/O locked) while the response
+  // is written, the next word recorded then shows it as a gap
+  lockIO();
+  inputTracePaused = true;
+  unlockIO();
+
+  res.set("Content-Type", "text/plain");
+
+  char line[48];
+  snprintf_P(line, sizeof(line), PSTR("# OXRS input trace, %u samples\n# gpios "), inputTraceCount);
+  res.print(line);
+  for (uint8_t index = 0; index < GPIO_COUNT; index++)
+  {
+    snprintf_P(line, sizeof(line), PSTR("%s%u"), index ? "," : "", GPIO_PINS[index]);
+    res.print(line);
+  }
+  res.print("\n");
+
+  uint8_t digits = (GPIO_COUNT + 3) / 4;
+  uint16_t slot = (inputTraceHead + INPUT_TRACE_SIZE - inputTraceCount) % INPUT_TRACE_SIZE;
+  for (uint16_t i = 0; i < inputTraceCount; i++)
+  {
+    const inputTraceSample_t & sample = inputTrace[slot];
+    snprintf_P(line, sizeof(line), PSTR("%lu %0*llx %u\n"),
+      (unsigned long)sample.timestamp, digits, (unsigned long long)sample.value, sample.gapMs);
+    res.print(line);
+    slot = (slot + 1) % INPUT_TRACE_SIZE;
+  }
+
+  inputTracePaused = false;
+}
+#endif
+
+/**
+ Status publishing
+*/
+void addEventJson(JsonObject json, const event_t & event)
+{
+  json["gpio"] = GPIO_PINS[event.index];
+
+  if ((event.source & ~EVENT_PREVIOUS_BOOT) == EVENT_INPUT)
+  {
+    json["type"] = getInputType(event.type);
+    json["event"] = getInputEventType(event.type, event.state);
+
+    if (event.value) { json["count"] = event.value; }
+    if (event.state == STORM_RELEASE_EVENT) { json["durationSeconds"] = event.duration; }
+  }
+  else
+  {
+    json["type"] = getOutputType(event.type);
+    json["event"] = getOutputEventType(event.type, event.state);
+
+    if (event.type == PWM) { json["level"] = event.value; }
+  }
+}
+
+bool sendEvent(const event_t & event, bool replay)
+{
+  #if defined(LATENCY_STATS)
+  uint32_t serializeMicros = micros();
+  #endif
+
+  StaticJsonDocument<EVENT_JSON_SIZE> json;
+  addEventJson(json.to<JsonObject>(), event);
+
+  // Let consumers place replayed events at the time they happened
+  if (replay)
+  {
+    if (event.source & EVENT_PREVIOUS_BOOT)
+    {
+      json["rebooted"] = true;
+    }
+    else
+    {
+      json["delayMs"] = millis() - event.timestamp;
+    }
+  }
+
+  memoryCheckpoint();
+  if (oxrs.publishStatus(json.as<JsonVariant>()))
+  {
+    // Replayed events would only measure how long the broker was away
+    #if defined(LATENCY_STATS)
+    if (!replay) { recordPublishLatency(event, serializeMicros, micros()); }
+    #endif
+    return true;
+  }
+
+  if (!replay)
+  {
+    oxrs.print(F("[digio] [failover] "));
+    serializeJson(json, oxrs);
+    oxrs.println();
+  }
+
+  return false;
+}
+
+void initFailover(void)
+{
+  #if defined(FAILOVER_RTC)
+  // Anything still queued in RTC memory was raised before this boot
+  if (failover.magic == FAILOVER_MAGIC && failover.head < FAILOVER_QUEUE_SIZE && failover.count <= FAILOVER_QUEUE_SIZE)
+  {
+    // Keep the events in order, less any for a GPIO this build doesn't
+    // have (e.g. firmware with fewer expanders)
+    uint16_t kept = 0;
+    for (uint16_t i = 0; i < failover.count; i++)
+    {
+      event_t event = failover.events[(failover.head + i) % FAILOVER_QUEUE_SIZE];
+      if (event.index >= GPIO_COUNT) continue;
+
+      event.source |= EVENT_PREVIOUS_BOOT;
+      failover.events[(failover.head + kept) % FAILOVER_QUEUE_SIZE] = event;
+      kept++;
+    }
+
+    if (kept < failover.count)
+    {
+      oxrs.print(F("[digio] [failover] discarded "));
+      oxrs.print(failover.count - kept);
+      oxrs.println(F(" events for unknown GPIOs"));
+      failover.count = kept;
+    }
+
+    if (failover.count > 0)
+    {
+      oxrs.print(F("[digio] [failover] restored "));
+      oxrs.print(failover.count);
+      oxrs.println(F(" events from RTC memory"));
+    }
+    return;
+  }
+  #endif
+
+  memset(&failover, 0, sizeof(failover));
+  failover.magic = FAILOVER_MAGIC;
+}
+
+void queueFailover(const event_t & event)
+{
+  if (failover.count == FAILOVER_QUEUE_SIZE)
+  {
+    failover.dropped++;
+    oxrs.println(F("[digio] [failover] queue full, event dropped"));
+
+    if (failoverDropPolicy == FAILOVER_DROP_NEWEST)
+      return;
+
+    failover.head = (failover.head + 1) % FAILOVER_QUEUE_SIZE;
+    failover.count--;
+  }
+
+  failover.events[(failover.head + failover.count) % FAILOVER_QUEUE_SIZE] = event;
+  failover.count++;
+}
+
+// Replay queued events in order, at most one per replay interval, and
+// stop at the first one that fails (i.e. we are still disconnected)
+void replayFailover(void)
+{
+  if (failover.count == 0) return;
+  if ((millis() - failoverLastReplay) < failoverReplayMs) return;
+  failoverLastReplay = millis();
+
+  if (!sendEvent(failover.events[failover.head], true)) return;
+
+  failover.head = (failover.head + 1) % FAILOVER_QUEUE_SIZE;
+  failover.count--;
+
+  if (failover.count == 0)
+  {
+    oxrs.println(F("[digio] [failover] replay complete"));
+  }
+}
+
+// Publish every batched event as a single array payload, each with its
+// age so consumers can still order them
+void flushBatch(void)
+{
+  if (batchCount == 0) return;
+
+  // Keep events in order behind any still waiting to be replayed
+  bool published = false;
+  if (failover.count == 0)
+  {
+    #if defined(LATENCY_STATS)
+    uint32_t serializeMicros = micros();
+    #endif
+
+    StaticJsonDocument<BATCH_JSON_SIZE> json;
+    JsonArray events = json.createNestedArray("events");
+
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < batchCount; i++)
+    {
+      JsonObject event = events.createNestedObject();
+      addEventJson(event, batch[i]);
+      event["delayMs"] = now - batch[i].timestamp;
+    }
+
+    memoryCheckpoint();
+    published = oxrs.publishStatus(json.as<JsonVariant>());
+
+    #if defined(LATENCY_STATS)
+    if (published)
+    {
+      uint32_t publishedMicros = micros();
+      for (uint8_t i = 0; i < batchCount; i++)
+      {
+        recordPublishLatency(batch[i], serializeMicros, publishedMicros);
+      }
+    }
+    #endif
+
+    if (!published)
+    {
+      oxrs.print(F("[digio] [failover] batch of "));
+      oxrs.print(batchCount);
+      oxrs.println(F(" events"));
+    }
+  }
+
+  if (!published)
+  {
+    for (uint8_t i = 0; i < batchCount; i++)
+    {
+      queueFailover(batch[i]);
+    }
+  }
+
+  batchCount = 0;
+}
+
+void queueBatch(const event_t & event)
+{
+  if (batchCount == 0) { batchStart = millis(); }
+  batch[batchCount++] = event;
+
+  if (batchCount >= batchMaxEvents)
+  {
+    flushBatch();
+  }
+}
+
+void publishEvent(const event_t & event)
+{
+  memoryBegin(MEMORY_PUBLISH);
+
+  // Coalesce events if batching is enabled (or for a bulk command)
+  if (batchWindowMs > 0 || batchHold)
+  {
+    queueBatch(event);
+  }
+  // Keep events in order behind any still waiting to be replayed
+  else if (failover.count > 0 || !sendEvent(event, false))
+  {
+    queueFailover(event);
+  }
+
+  memoryEnd(MEMORY_PUBLISH);
+}
+
+void publishOutputEvent(uint8_t index, uint8_t type, uint8_t state)
+{
+  event_t event = makeEvent(EVENT_OUTPUT, index, type, state);
+  publishEvent(event);
+}
+
+// Load a schema generated at build time, see scripts/schema_extra.py
+bool loadSchema(JsonDocument & json, const char * schema, uint8_t nesting)
+{
+  #if defined(ESP8266)
+  // Flash isn't byte addressable on an ESP8266
+  DeserializationError error = deserializeJson(json, reinterpret_cast<const __FlashStringHelper *>(schema), DeserializationOption::NestingLimit(nesting));
+  #else
+  DeserializationError error = deserializeJson(json, schema, DeserializationOption::NestingLimit(nesting));
+  #endif
+
+  if (error)
+  {
+    oxrs.print(F("[digio] failed to load schema: "));
+    oxrs.println(error.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+/**
+  Persisted config
+ */
+void resetGpioConfig(uint8_t index)
+{
+  gpioConfig[index].gpioType = GPIO_INPUT;
+  gpioConfig[index].inputType = SWITCH;
+  gpioConfig[index].inputFlags = 0;
+  gpioConfig[index].outputType = RELAY;
+  gpioConfig[index].timerSeconds = DEFAULT_TIMER_SECS;
+  gpioConfig[index].interlockIndex = index;
+  gpioConfig[index].pwmFrequency = DEFAULT_PWM_FREQUENCY;
+  gpioConfig[index].pwmResolution = DEFAULT_PWM_RESOLUTION;
+  gpioConfig[index].stormRate = 0;
+  gpioConfig[index].stormBurst = DEFAULT_STORM_BURST;
+}
+
+// Bring a GPIO's pin and handlers from the applied config to the one now
+// in gpioConfig, touching only what differs - so an unchanged output keeps
+// its state, and an unchanged input its debounce/click state machine
+void applyGpioConfig(uint8_t index, const gpioConfig_t & applied)
+{
+  gpioConfig_t * config = &gpioConfig[index];
+  uint8_t pin = gpioBankPin(index);
+
+  // Resets the pin, and starts (or stops) counting/PWM to match
+  bool typeChanged = config->gpioType != applied.gpioType;
+  if (typeChanged)
+  {
+    setGpioType(index, config->gpioType);
+  }
+
+  OXRS_Input & input = oxrsInput[gpioBank(index)];
+  if (config->inputType != applied.inputType)
+  {
+    // Counters are handled by our ISR, keep OXRS_Input on a plain type
+    input.setType(pin, config->inputType == COUNTER ? SWITCH : config->inputType);
+  }
+
+  if (bitRead(config->inputFlags, GPIO_CONFIG_INVERT) != bitRead(applied.inputFlags, GPIO_CONFIG_INVERT))
+  {
+    input.setInvert(pin, bitRead(config->inputFlags, GPIO_CONFIG_INVERT));
+  }
+
+  if (!typeChanged && (config->inputType != applied.inputType || config->inputFlags != applied.inputFlags))
+  {
+    // Applies the disabled flag too (counters are always disabled there)
+    updateCounter(index);
+  }
+
+  if (typeChanged || config->stormRate != applied.stormRate || config->stormBurst != applied.stormBurst)
+  {
+    resetStorm(index);
+  }
+
+  // Interlocks are only ever set up within a bank
+  OXRS_Output & output = oxrsOutput[gpioBank(index)];
+  if (config->outputType != applied.outputType)
+  {
+    // PWM is driven by us, keep OXRS_Output on a plain type
+    output.setType(pin, config->outputType == PWM ? RELAY : config->outputType);
+  }
+
+  if (config->timerSeconds != applied.timerSeconds)
+  {
+    output.setTimer(pin, config->timerSeconds);
+  }
+
+  if (config->interlockIndex != applied.interlockIndex)
+  {
+    output.setInterlock(pin, gpioBankPin(config->interlockIndex));
+  }
+
+  if (!typeChanged && (config->outputType != applied.outputType ||
+                       config->pwmFrequency != applied.pwmFrequency ||
+                       config->pwmResolution != applied.pwmResolution))
+  {
+    // Start (or stop) PWM, with any new frequency/resolution
+    updatePwm(index);
+  }
+}
+
+#if defined(PCNT_ROTARY)
+bool pcntWanted(uint8_t index)
+{
+  return index + 1 < GPIO_NATIVE_COUNT &&
+         gpioConfig[index].gpioType == GPIO_INPUT &&
+         gpioConfig[index].inputType == ROTARY &&
+         bitRead(gpioConfig[index].inputFlags, GPIO_CONFIG_PCNT) &&
+         gpioConfig[index + 1].gpioType == GPIO_INPUT;
+}
+
+void setPairDisabled(uint8_t index, bool disabled)
+{
+  for (uint8_t pin = index; pin < index + 2; pin++)
+  {
+    oxrsInput[gpioBank(pin)].setDisabled(gpioBankPin(pin), disabled || bitRead(gpioConfig[pin].inputFlags, GPIO_CONFIG_DISABLED));
+  }
+}
+#endif
+
+// Bind a hardware counter to every rotary input with 'pcnt' set, decoding
+// it and the next GPIO in place of OXRS_Input (which is disabled for both)
+void bindRotaryCounters(void)
+{
+  #if defined(PCNT_ROTARY)
+  uint8_t wanted[PCNT_UNITS];
+  memset(wanted, INVALID_GPIO_PIN, sizeof(wanted));
+
+  uint8_t unit = 0;
+  for (uint8_t index = 0; index < GPIO_COUNT; index++)
+  {
+    if (!pcntWanted(index)) continue;
+
+    // Any more are left to software decoding
+    if (unit == PCNT_UNITS)
+    {
+      oxrs.println(F("[digio] no hardware counters left, decoding rotary in software"));
+      break;
+    }
+
+    // The next GPIO is the B channel, so can't start a pair itself
+    wanted[unit++] = index++;
+  }
+
+  // Release any pairs which have changed first, so software decoding
+  // is never re-enabled for a pair which is still bound
+  for (unit = 0; unit < PCNT_UNITS; unit++)
+  {
+    if (pcntInput[unit] == wanted[unit] || pcntInput[unit] == INVALID_GPIO_PIN) continue;
+
+    pcntDetach(unit);
+    setPairDisabled(pcntInput[unit], false);
+    pcntInput[unit] = INVALID_GPIO_PIN;
+  }
+
+  for (unit = 0; unit < PCNT_UNITS; unit++)
+  {
+    if (wanted[unit] == INVALID_GPIO_PIN) continue;
+
+    if (pcntInput[unit] != wanted[unit])
+    {
+      pcntAttach(unit, GPIO_PINS[wanted[unit]], GPIO_PINS[wanted[unit] + 1]);
+      pcntInput[unit] = wanted[unit];
+    }
+
+    // Config may have re-enabled either input since it was bound
+    setPairDisabled(wanted[unit], true);
+  }
+  #endif
+}
+
+// Read/write a blob in flash, by file on ESP8266 or NVS key otherwise
+bool readStore(const char * name, const char * file, void * store, size_t size)
+{
+  #if defined(ESP8266)
+  if (!LittleFS.begin()) return false;
+
+  File handle = LittleFS.open(file, "r");
+  if (!handle) return false;
+
+  bool ok = handle.read((uint8_t *)store, size) == size;
+  handle.close();
+  return ok;
+  #else
+  Preferences preferences;
+  preferences.begin(name, true);
+  bool ok = preferences.getBytesLength(name) == size &&
+            preferences.getBytes(name, store, size) == size;
+  preferences.end();
+  return ok;
+  #endif
+}
+
+bool writeStore(const char * name, const char * file, const void * store, size_t size)
+{
+  #if defined(ESP8266)
+  if (!LittleFS.begin()) return false;
+
+  File handle = LittleFS.open(file, "w");
+  if (!handle) return false;
+
+  bool ok = handle.write((const uint8_t *)store, size) == size;
+  handle.close();
+  return ok;
+  #else
+  Preferences preferences;
+  preferences.begin(name, false);
+  bool ok = preferences.putBytes(name, store, size) == size;
+  preferences.end();
+  return ok;
+  #endif
+}
+
+bool readConfigStore(configStore_t * store)
+{
+  return readStore(CONFIG_STORE_NAME, CONFIG_STORE_FILE, store, sizeof(configStore_t));
+}
+
+bool writeConfigStore(const configStore_t * store)
+{
+  return writeStore(CONFIG_STORE_NAME, CONFIG_STORE_FILE, store, sizeof(configStore_t));
+}
+
+void restoreConfig(void)
+{
+  if (!readConfigStore(&configStored) ||
+      configStored.magic != CONFIG_STORE_MAGIC ||
+      configStored.version != CONFIG_STORE_VERSION ||
+      configStored.count != GPIO_COUNT)
+  {
+    Serial.println(F("[digio] no stored GPIO config, using defaults"));
+    memset(&configStored, 0, sizeof(configStored));
+    return;
+  }
+
+  for (uint8_t index = 0; index < GPIO_COUNT; index++)
+  {
+    // The pins and handlers are still on the defaults from setup()
+    gpioConfig_t applied = gpioConfig[index];
+    gpioConfig[index] = configStored.gpios[index];
+    applyGpioConfig(index, applied);
+  }
+  memcpy(rules, configStored.rules, sizeof(rules));
+  bindRotaryCounters();
+
+  Serial.println(F("[digio] restored stored GPIO config"));
+}
+
+void saveConfig(void)
+{
+  // Compared and updated section by section from the globals, a copy of
+  // the whole store is too big for the loop task's stack
+
+  // Only write to flash if something actually changed
+  memoryCheckpoint();
+  if (configStored.magic == CONFIG_STORE_MAGIC &&
+      memcmp(configStored.gpios, gpioConfig, sizeof(configStored.gpios)) == 0 &&
+      memcmp(configStored.rules, rules, sizeof(configStored.rules)) == 0) return;
+
+  configStored.magic = CONFIG_STORE_MAGIC;
+  configStored.version = CONFIG_STORE_VERSION;
+  configStored.count = GPIO_COUNT;
+  memcpy(configStored.gpios, gpioConfig, sizeof(configStored.gpios));
+  memcpy(configStored.rules, rules, sizeof(configStored.rules));
+
+  if (!writeConfigStore(&configStored))
+  {
+    oxrs.println(F("[digio] failed to persist GPIO config"));
+
+    // So the next save tries again
+    configStored.magic = 0;
+  }
+}
+
+/**
+  Config handler
+ */
+void loadConfigSchema()
+{
+  // Load our config schema
+  DynamicJsonDocument json(CONFIG_SCHEMA_CAPACITY);
+  if (!loadSchema(json, CONFIG_SCHEMA, CONFIG_SCHEMA_NESTING)) return;
+
+  // Pass our config schema down to the OXRS library
+  memoryCheckpoint();
+  oxrs.setConfigSchema(json.as<JsonVariant>());
+}
+
+// Measured from out here, so the loader's frame counts
+void setConfigSchema()
+{
+  memoryBegin(MEMORY_SCHEMA);
+  loadConfigSchema();
+  memoryEnd(MEMORY_SCHEMA);
+}
+
+uint8_t getIndex(JsonVariant json)
+{
+  if (!json.containsKey("gpio"))
+  {
+    oxrs.println(F("[digio] missing gpio"));
+    return INVALID_GPIO_PIN;
+  }
+  
+  uint8_t gpio = json["gpio"].as<uint8_t>();
+  uint8_t index = getIndexFromGpio(gpio);
+
+  if (index == INVALID_GPIO_PIN)
+  {
+    oxrs.println(F("[digio] invalid gpio, doesn't match a supported pin"));
+    return INVALID_GPIO_PIN;
+  }
+
+  return index;
+}
+
+void jsonInputConfig(uint8_t index, JsonVariant json)
+{
+  if (json.containsKey("type"))
+  {
+    uint8_t inputType = parseInputType(json["type"]);    
+
+    if (inputType == COUNTER && !isNativeGpio(index))
+    {
+      oxrs.println(F("[digio] invalid input type, counters can't be on an expander"));
+    }
+    else if (inputType == COUNTER && !isInterruptGpio(index))
+    {
+      oxrs.println(F("[digio] invalid input type, counters need a pin with an interrupt"));
+    }
+    else if (inputType != INVALID_INPUT_TYPE)
+    {
+      gpioConfig[index].inputType = inputType;
+    }
+  }
+  
+  if (json.containsKey("invert"))
+  {
+    bitWrite(gpioConfig[index].inputFlags, GPIO_CONFIG_INVERT, json["invert"].as<bool>());
+  }
+
+  if (json.containsKey("disabled"))
+  {
+    bitWrite(gpioConfig[index].inputFlags, GPIO_CONFIG_DISABLED, json["disabled"].as<bool>());
+  }
+
+  if (json.containsKey("rateLimit"))
+  {
+    if (json["rateLimit"].isNull())
+    {
+      gpioConfig[index].stormRate = 0;
+    }
+    else
+    {
+      gpioConfig[index].stormRate = json["rateLimit"].as<uint8_t>();
+    }
+  }
+
+  if (json.containsKey("burst"))
+  {
+    if (json["burst"].isNull())
+    {
+      gpioConfig[index].stormBurst = DEFAULT_STORM_BURST;
+    }
+    else
+    {
+      gpioConfig[index].stormBurst = max(json["burst"].as<uint8_t>(), (uint8_t)1);
+    }
+  }
+
+  #if defined(PCNT_ROTARY)
+  // Bound (or released) once the whole payload is applied
+  if (json.containsKey("pcnt"))
+  {
+    bitWrite(gpioConfig[index].inputFlags, GPIO_CONFIG_PCNT, json["pcnt"].as<bool>());
+  }
+  #endif
+}
+
+void jsonOutputConfig(uint8_t index, JsonVariant json)
+{
+  if (json.containsKey("type"))
+  {
+    uint8_t outputType = parseOutputType(json["type"]);
+
+    if (outputType == PWM && !isNativeGpio(index))
+    {
+      oxrs.println(F("[digio] invalid output type, PWM can't be on an expander"));
+    }
+    else if (outputType != INVALID_OUTPUT_TYPE)
+    {
+      gpioConfig[index].outputType = outputType;
+    }
+  }
+
+  uint16_t pwmFrequency = gpioConfig[index].pwmFrequency;
+  uint8_t pwmResolution = gpioConfig[index].pwmResolution;
+
+  if (json.containsKey("frequencyHz"))
+  {
+    if (json["frequencyHz"].isNull())
+    {
+      pwmFrequency = DEFAULT_PWM_FREQUENCY;
+    }
+    else
+    {
+      pwmFrequency = constrain(json["frequencyHz"].as<uint32_t>(), 1, 40000);
+    }
+  }
+
+  if (json.containsKey("resolutionBits"))
+  {
+    if (json["resolutionBits"].isNull())
+    {
+      pwmResolution = DEFAULT_PWM_RESOLUTION;
+    }
+    else
+    {
+      pwmResolution = constrain(json["resolutionBits"].as<uint8_t>(), 1, 14);
+    }
+  }
+
+  #if defined(ESP32)
+  // The LEDC timer can't count that fast, so keep what is there
+  if (((uint64_t)pwmFrequency << pwmResolution) > PWM_MAX_CLOCK_HZ)
+  {
+    oxrs.println(F("[digio] invalid PWM frequency for this resolution, ignoring"));
+  }
+  else
+  #endif
+  {
+    gpioConfig[index].pwmFrequency = pwmFrequency;
+    gpioConfig[index].pwmResolution = pwmResolution;
+  }
+
+  if (json.containsKey("timerSeconds"))
+  {
+    if (json["timerSeconds"].isNull())
+    {
+      gpioConfig[index].timerSeconds = DEFAULT_TIMER_SECS;
+    }
+    else
+    {
+      gpioConfig[index].timerSeconds = json["timerSeconds"].as<uint8_t>();
+    }
+  }
+
+  if (json.containsKey("interlockGpio"))
+  {
+    // If an empty message then treat as 'unlocked' - i.e. interlock with ourselves
+    if (json["interlockGpio"].isNull())
+    {
+      gpioConfig[index].interlockIndex = index;
+    }
+    else
+    {
+      uint8_t interlockGpio = json["interlockGpio"].as<uint8_t>();
+      uint8_t interlockIndex = getIndexFromGpio(interlockGpio);
+
+      if (interlockIndex == INVALID_GPIO_PIN)
+      {
+        oxrs.println(F("[digio] invalid interlock GPIO"));
+      }
+      else if (gpioBank(interlockIndex) != gpioBank(index))
+      {
+        oxrs.println(F("[digio] invalid interlock GPIO, must be in the same bank of 16"));
+      }
+      else
+      {
+        gpioConfig[index].interlockIndex = interlockIndex;
+      }
+    }
+  }
+}
+
+void jsonGpioConfig(JsonVariant json)
+{
+  uint8_t index = getIndex(json);
+  if (index == INVALID_GPIO_PIN) return;
+
+  // See if type is explicitly defined, otherwise determine from the config
+  uint8_t gpioType = INVALID_GPIO_TYPE;
+
+  if (json.containsKey("type"))
+  {
+    gpioType = parseGpioType(json["type"]);
+  }
+  else
+  {
+    if (json.containsKey("input"))
+    {
+      gpioType = GPIO_INPUT;
+    }
+    else if (json.containsKey("output"))
+    {
+      gpioType = GPIO_OUTPUT;
+    }
+  }
+
+  // Ignore if an invalid configuration payload
+  if (gpioType == INVALID_GPIO_TYPE) 
+    return;
+
+  // Parse the new config over what's applied now, then apply just the
+  // differences - a retained config redelivered on every reconnect then
+  // leaves the pins and handlers alone
+  gpioConfig_t applied = gpioConfig[index];
+  gpioConfig[index].gpioType = gpioType;
+
+  // Parse any type specific config
+  if (json.containsKey("input") && gpioType == GPIO_INPUT)
+  {
+    jsonInputConfig(index, json["input"]);
+  }
+  if (json.containsKey("output") && gpioType == GPIO_OUTPUT)
+  {
+    jsonOutputConfig(index, json["output"]);
+  }
+
+  applyGpioConfig(index, applied);
+}
+
+void jsonFailoverConfig(JsonVariant json)
+{
+  if (json.containsKey("dropPolicy"))
+  {
+    const char * dropPolicy = json["dropPolicy"];
+    if (!json["dropPolicy"].is<const char *>())
+    {
+      oxrs.println(F("[digio] invalid failover drop policy"));
+    }
+    else if (strcmp(dropPolicy, "oldest") == 0)
+    {
+      failoverDropPolicy = FAILOVER_DROP_OLDEST;
+    }
+    else if (strcmp(dropPolicy, "newest") == 0)
+    {
+      failoverDropPolicy = FAILOVER_DROP_NEWEST;
+    }
+    else
+    {
+      oxrs.println(F("[digio] invalid failover drop policy"));
+    }
+  }
+
+  if (json.containsKey("replayIntervalMs"))
+  {
+    if (json["replayIntervalMs"].isNull())
+    {
+      failoverReplayMs = DEFAULT_FAILOVER_REPLAY_MS;
+    }
+    else
+    {
+      failoverReplayMs = json["replayIntervalMs"].as<uint16_t>();
+    }
+  }
+}
+
+#if defined(PCNT_ROTARY)
+void jsonPcntConfig(JsonVariant json)
+{
+  if (json.containsKey("intervalMs"))
+  {
+    if (json["intervalMs"].isNull())
+    {
+      pcntIntervalMs = DEFAULT_PCNT_INTERVAL_MS;
+    }
+    else
+    {
+      pcntIntervalMs = constrain(json["intervalMs"].as<uint16_t>(), 10, 60000);
+    }
+  }
+}
+#endif
+
+void jsonBatchConfig(JsonVariant json)
+{
+  if (json.containsKey("windowMs"))
+  {
+    batchWindowMs = json["windowMs"].as<uint16_t>();
+
+    // Don't strand anything queued under the old settings
+    if (batchWindowMs == 0) { flushBatch(); }
+  }
+
+  if (json.containsKey("maxEvents"))
+  {
+    if (json["maxEvents"].isNull())
+    {
+      batchMaxEvents = BATCH_MAX_EVENTS;
+    }
+    else
+    {
+      batchMaxEvents = constrain(json["maxEvents"].as<uint8_t>(), 1, BATCH_MAX_EVENTS);
+    }
+  }
+}
+
+// Everything but the gpios and rules lists, which are applied after these
+void jsonSettingsConfig(JsonVariant json)
+{
+  if (json.containsKey("failover"))
+  {
+    jsonFailoverConfig(json["failover"]);
+  }
+
+  if (json.containsKey("batch"))
+  {
+    jsonBatchConfig(json["batch"]);
+  }
+
+  if (json.containsKey("counter"))
+  {
+    jsonCounterConfig(json["counter"]);
+  }
+
+  #if defined(LOOP_PROFILER)
+  if (json.containsKey("profiler"))
+  {
+    jsonProfilerConfig(json["profiler"]);
+  }
+  #endif
+
+  #if defined(MEMORY_STATS)
+  if (json.containsKey("memory"))
+  {
+    jsonMemoryConfig(json["memory"]);
+  }
+  #endif
+
+  #if defined(PCNT_ROTARY)
+  if (json.containsKey("pcnt"))
+  {
+    jsonPcntConfig(json["pcnt"]);
+  }
+  #endif
+}
+
+void jsonConfig(JsonVariant json)
+{
+  memoryBegin(MEMORY_CONFIG);
+
+  jsonSettingsConfig(json);
+
+  if (json.containsKey("gpios"))
+  {
+    lockIO();
+    for (JsonVariant gpio : json["gpios"].as<JsonArray>())
+    {
+      jsonGpioConfig(gpio);    
+    }
+    bindRotaryCounters();
+    unlockIO();
+
+  }
+
+  if (json.containsKey("rules"))
+  {
+    lockIO();
+    uint16_t rejected = jsonRulesConfig(json["rules"]);
+    unlockIO();
+
+    publishRulesResult(json["rules"].size() - rejected, rejected);
+  }
+
+  // Persist so the config is in place at the next boot
+  if (json.containsKey("gpios") || json.containsKey("rules"))
+  {
+    saveConfig();
+  }
+
+  memoryEnd(MEMORY_CONFIG);
+}
+
+/**
+  Command handler
+ */
+// Pass a command to the output handler for this GPIO's bank
+void commandOutput(uint8_t index, uint8_t command)
+{
+  // Anything switching the output overrides a pulse in progress
+  rulePulseOff[index] = 0;
+
+  uint8_t bank = gpioBank(index);
+  oxrsOutput[bank].handleCommand(bank, gpioBankPin(index), command);
+}
+
+// Set a PWM output's level from a command, which like any other output
+// command has to be handed over to the I/O task (if enabled) as it owns
+// the output state and the fades
+void commandPwmLevel(uint8_t index, uint8_t level, uint32_t fadeMs)
+{
+  #if defined(IO_TASK)
+  ioCommand_t ioCommand = {};
+  ioCommand.kind = IO_COMMAND_PWM;
+  ioCommand.index = index;
+  ioCommand.command = level;
+  ioCommand.fadeMs = fadeMs;
+  if (!ioCommands.push(ioCommand))
+  {
+    oxrs.println(F("[digio] command queue full, command dropped"));
+  }
+  #else
+  setPwmLevel(index, level, fadeMs);
+  #endif
+}
+
+void handleOutputCommand(uint8_t index, uint8_t command)
+{
+  // PWM outputs are driven directly, OXRS_Output doesn't know them
+  if (bitRead(pwmMask, index))
+  {
+    commandPwmLevel(index, command == RELAY_ON ? 100 : 0, 0);
+    return;
+  }
+
+  #if defined(IO_TASK)
+  // Hand over to the I/O task, which owns the output handler
+  ioCommand_t ioCommand = {};
+  ioCommand.kind = IO_COMMAND_OUTPUT;
+  ioCommand.index = index;
+  ioCommand.command = command;
+  #if defined(LATENCY_STATS)
+  ioCommand.receivedMicros = micros();
+  #endif
+
+  if (!ioCommands.push(ioCommand))
+  {
+    oxrs.println(F("[digio] command queue full, command dropped"));
+  }
+  #else
+  #if defined(LATENCY_STATS)
+  stampOutputCommand(index, micros());
+  #endif
+
+  commandOutput(index, command);
+  #endif
+}
+
+void loadCommandSchema()
+{
+  // Load our command schema
+  DynamicJsonDocument json(COMMAND_SCHEMA_CAPACITY);
+  if (!loadSchema(json, COMMAND_SCHEMA, COMMAND_SCHEMA_NESTING)) return;
+
+  // Pass our command schema down to the OXRS library
+  memoryCheckpoint();
+  oxrs.setCommandSchema(json.as<JsonVariant>());
+}
+
+// Measured from out here, so the loader's frame counts
+void setCommandSchema()
+{
+  memoryBegin(MEMORY_SCHEMA);
+  loadCommandSchema();
+  memoryEnd(MEMORY_SCHEMA);
+}
+
+void jsonPwmCommand(uint8_t index, JsonVariant json)
+{
+  const char * command = json["command"];
+  if (!command || strcmp(command, "query") == 0)
+  {
+    // Publish the current level
+    pwmPublish.fetch_or(pwmBit(index));
+  }
+  else if (strcmp(command, "on") == 0)
+  {
+    commandPwmLevel(index, 100, 0);
+  }
+  else if (strcmp(command, "off") == 0)
+  {
+    commandPwmLevel(index, 0, 0);
+  }
+  else if (strcmp(command, "level") == 0 || strcmp(command, "fade") == 0)
+  {
+    if (!json["level"].is<uint8_t>())
+    {
+      oxrs.println(F("[digio] invalid level, expected 0-100"));
+      return;
+    }
+
+    uint32_t fadeMs = strcmp(command, "fade") == 0 ? json["fadeMs"].as<uint32_t>() : 0;
+    commandPwmLevel(index, json["level"].as<uint8_t>(), fadeMs);
+  }
+  else
+  {
+    oxrs.println(F("[digio] invalid command"));
+  }
+}
+
+void jsonGpioCommand(JsonVariant json)
+{
+  uint8_t index = getIndex(json);
+  if (index == INVALID_GPIO_PIN) return;
+
+  // Check this GPIO pin is configured as an output
+  if (gpioTypes[index] != GPIO_OUTPUT)
+  {
+    oxrs.println(F("[digio] command received for GPIO not configured as output"));
+    return;
+  }
+
+  // Get the output type for this pin
+  uint8_t type = gpioConfig[index].outputType;
+
+  if (json.containsKey("type"))
+  {
+    if (parseOutputType(json["type"]) != type)
+    {
+      oxrs.println(F("[digio] command type doesn't match configured type"));
+      return;
+    }
+  }
+
+  if (type == PWM)
+  {
+    jsonPwmCommand(index, json);
+    return;
+  }
+
+  if (json.containsKey("command"))
+  {
+    if (json["command"].isNull() || strcmp(json["command"], "query") == 0)
+    {
+      // Publish a status event with the current state
+      uint8_t state = bitRead(outputState, index);
+      publishOutputEvent(index, type, state);
+    }
+    else
+    {
+      // Send this command down to our output handler to process
+      if (strcmp(json["command"], "on") == 0)
+      {
+        handleOutputCommand(index, RELAY_ON);
+      }
+      else if (strcmp(json["command"], "off") == 0)
+      {
+        handleOutputCommand(index, RELAY_OFF);
+      }
+      else
+      {
+        oxrs.println(F("[digio] invalid command"));
+      }
+    }
+  }
+}
+
+// Parse a bitmap of GPIO indexes (bit n is the nth pin in the schema), as
+// a number or a string such as "0x00ff"
+bool parseGpioMask(JsonVariant json, gpioWord_t * mask)
+{
+  uint64_t value;
+  if (json.is<const char *>())
+  {
+    char * end;
+    value = strtoull(json.as<const char *>(), &end, 0);
+    if (*end != '\0')
+    {
+      oxrs.println(F("[digio] invalid mask"));
+      return false;
+    }
+  }
+  else if (json.is<uint64_t>())
+  {
+    value = json.as<uint64_t>();
+  }
+  else
+  {
+    oxrs.println(F("[digio] invalid mask"));
+    return false;
+  }
+
+  if (value & ~(uint64_t)GPIO_MASK)
+  {
+    oxrs.println(F("[digio] invalid mask, includes GPIOs which don't exist"));
+    return false;
+  }
+
+  *mask = value;
+  return true;
+}
+
+// Bit per GPIO index, set if an input is active (low, unless inverted)
+gpioWord_t getActiveInputs(void)
+{
+  gpioWord_t invert = 0;
+  for (uint8_t index = 0; index < GPIO_COUNT; index++)
+  {
+    if (bitRead(gpioConfig[index].inputFlags, GPIO_CONFIG_INVERT)) { invert |= gpioBit(index); }
+  }
+
+  return (~readInputs() ^ invert) & inputMask;
+}
+
+// Bit per GPIO index, set if an output is on
+gpioWord_t getActiveOutputs(void)
+{
+  gpioWord_t on = RELAY_ON == HIGH ? outputState : ~outputState;
+  return on & ~inputMask & GPIO_MASK;
+}
+
+// Publish the state of every GPIO as a single status event, so a whole
+// device can be resynced with one query
+void formatGpioMask(char * buffer, size_t size, gpioWord_t mask)
+{
+  uint8_t digits = (GPIO_COUNT + 3) / 4;
+  snprintf_P(buffer, size, PSTR("0x%0*llx"), digits, (unsigned long long)mask);
+}
+
+void publishSnapshot(void)
+{
+  // "0x", a hex digit per 4 bits of the GPIO word, and the terminator
+  char inputs[sizeof(gpioWord_t) * 2 + 3], outputs[sizeof(inputs)], state[sizeof(inputs)];
+  formatGpioMask(inputs, sizeof(inputs), inputMask);
+  formatGpioMask(outputs, sizeof(outputs), ~inputMask & GPIO_MASK);
+  formatGpioMask(state, sizeof(state), getActiveInputs() | getActiveOutputs());
+
+  StaticJsonDocument<SNAPSHOT_JSON_SIZE> json;
+  JsonObject snapshot = json.createNestedObject("snapshot");
+  snapshot["inputs"] = (const char *)inputs;
+  snapshot["outputs"] = (const char *)outputs;
+  snapshot["state"] = (const char *)state;
+
+  memoryCheckpoint();
+  if (!oxrs.publishStatus(json.as<JsonVariant>()))
+  {
+    oxrs.println(F("[digio] failed to publish snapshot"));
+  }
+}
+
+// Apply a command to every output selected by a mask in one pass
+void jsonMaskCommand(JsonVariant json)
+{
+  gpioWord_t mask;
+  if (!parseGpioMask(json["mask"], &mask)) return;
+
+  const char * commandName = json["command"];
+  if (!commandName || strcmp(commandName, "query") == 0)
+  {
+    publishSnapshot();
+    return;
+  }
+
+  uint8_t command;
+  if (strcmp(commandName, "on") == 0)
+  {
+    command = RELAY_ON;
+  }
+  else if (strcmp(commandName, "off") == 0)
+  {
+    command = RELAY_OFF;
+  }
+  else
+  {
+    oxrs.println(F("[digio] invalid command"));
+    return;
+  }
+
+  if (mask & inputMask)
+  {
+    oxrs.println(F("[digio] mask includes GPIOs not configured as output, ignoring them"));
+    mask &= ~inputMask;
+  }
+
+  // Publish the resulting output events together (the I/O task raises
+  // them later, so they are published as usual if it is enabled)
+  batchHold = true;
+  for (uint8_t index = 0; index < GPIO_COUNT; index++)
+  {
+    if (bitRead(mask, index))
+    {
+      handleOutputCommand(index, command);
+    }
+  }
+  batchHold = false;
+}
+
+// Everything after the gpios list - which was in the payload if 'gpios'
+void jsonOtherCommands(JsonVariant json, bool gpios)
+{
+  if (json.containsKey("mask"))
+  {
+    jsonMaskCommand(json);
+  }
+
+  if (gpios || json.containsKey("mask"))
+  {
+    // Switch every output commanded above at once (the I/O task does
+    // this itself when it has handled the queued commands)
+    #if !defined(IO_TASK)
+    writeOutputs();
+
+    // Commands which didn't change an output are never written
+    #if defined(LATENCY_STATS)
+    outputCommandPending = 0;
+    #endif
+    #endif
+
+    // Publish any events held back by a bulk command, unless batching
+    // is enabled anyway and they can wait for the window to close
+    if (batchWindowMs == 0)
+    {
+      flushBatch();
+    }
+  }
+
+  if (json.containsKey("counters"))
+  {
+    for (JsonVariant counter : json["counters"].as<JsonArray>())
+    {
+      jsonCounterCommand(counter);
+    }
+    saveCounters(true);
+  }
+
+  if (json.containsKey("query"))
+  {
+    const char * query = json["query"];
+    if (query && strcmp(query, "all") == 0)
+    {
+      publishSnapshot();
+    }
+    else
+    {
+      oxrs.println(F("[digio] invalid query"));
+    }
+  }
+
+  #if defined(LOOP_PROFILER)
+  if (json.containsKey("profiler"))
+  {
+    jsonProfilerCommand(json["profiler"]);
+  }
+  #endif
+
+  #if defined(MEMORY_STATS)
+  if (json.containsKey("memory"))
+  {
+    jsonMemoryCommand(json["memory"]);
+  }
+  #endif
+}
+
+void jsonCommand(JsonVariant json)
+{
+  memoryBegin(MEMORY_COMMAND);
+
+  if (json.containsKey("gpios"))
+  {
+    for (JsonVariant gpio : json["gpios"].as<JsonArray>())
+    {
+      jsonGpioCommand(gpio);
+    }
+  }
+
+  jsonOtherCommands(json, json.containsKey("gpios"));
 
-  // Create the input config schema (all optional)
-  setTitle(input, "Input");
-  input["type"] = "object";
-  inputConfigSchema(input.createNestedObject("properties"));
+  memoryEnd(MEMORY_COMMAND);
+}
+
+/**
+  Event handlers
+*/
+// Hand an event raised in the I/O context over to be published
+void raiseEvent(const event_t & event)
+{
+  #if defined(IO_TASK)
+  // Queue the event for the network task to publish (if the queue is
+  // full it is counted, and reported by publishIOEvents())
+  ioEvents.push(event);
+  #else
+  // Publish the event
+  publishEvent(event);
+  #endif
+}
 
-  // Create the output config schema (all optional)
-  setTitle(output, "Output");
-  output["type"] = "object";
-  outputConfigSchema(output.createNestedObject("properties"));
+// Top up an input's bucket for the time since it was last refilled, it
+// refills at its rate limit and holds at most its burst
+void refillStorm(uint8_t index, uint32_t now)
+{
+  const gpioConfig_t * config = &gpioConfig[index];
+  storm_t * bucket = &storm[index];
 
-  JsonArray required = items.createNestedArray("required");
-  required.add("gpio");
-  required.add("type");
+  // Longer than any bucket takes to fill, and keeps the sum in range
+  uint32_t elapsed = min(now - bucket->refilled, (uint32_t)255000);
+  bucket->refilled = now;
+  bucket->tokens = min(bucket->tokens + elapsed * config->stormRate, (uint32_t)config->stormBurst * 1000);
+}
 
-  // Pass our config schema down to the OXRS library
-  oxrs.setConfigSchema(json.as<JsonVariant>());
+// Start again with a full bucket, a suppressed input is released (with
+// its summary) by the next processStorms()
+void resetStorm(uint8_t index)
+{
+  storm[index].tokens = (uint32_t)gpioConfig[index].stormBurst * 1000;
+  storm[index].refilled = millis();
 }
 
-uint8_t getIndex(JsonVariant json)
+void raiseStormEvent(uint8_t index, uint8_t type, uint8_t state)
 {
-  if (!json.containsKey("gpio"))
-  {
-    oxrs.println(F("[digio] missing gpio"));
-    return INVALID_GPIO_PIN;
-  }
-  
-  uint8_t gpio = json["gpio"].as<uint8_t>();
-  uint8_t index = getIndexFromGpio(gpio);
+  event_t event = makeEvent(EVENT_INPUT, index, type, state);
+  uint32_t now = event.timestamp;
 
-  if (index == INVALID_GPIO_PIN)
+  if (state == STORM_RELEASE_EVENT)
   {
-    oxrs.println(F("[digio] invalid gpio, doesn't match a supported pin"));
-    return INVALID_GPIO_PIN;
+    event.value = min(storm[index].count, (uint32_t)UINT16_MAX);
+    event.duration = min((now - storm[index].since) / 1000, (uint32_t)UINT16_MAX);
   }
 
-  return index;
+  #if defined(LATENCY_STATS)
+  event.sampledMicros = event.raisedMicros = micros();
+  #endif
+
+  raiseEvent(event);
 }
 
-void jsonInputConfig(uint8_t index, JsonVariant json)
+// Spend a token on an input event, returns false if it should be dropped
+// - an input which runs out is suppressed, and while suppressed every
+// event is dropped (and counted) until processStorms() releases it
+bool admitInputEvent(uint8_t index, uint8_t type, uint8_t state)
 {
-  if (json.containsKey("type"))
-  {
-    uint8_t inputType = parseInputType(json["type"]);    
+  if (!gpioConfig[index].stormRate) return true;
 
-    if (inputType != INVALID_INPUT_TYPE)
-    {
-      oxrsInput.setType(index, inputType);
-    }
-  }
-  
-  if (json.containsKey("invert"))
+  refillStorm(index, millis());
+
+  storm_t * bucket = &storm[index];
+  bool suppressed = stormMask & gpioBit(index);
+
+  if (bucket->tokens >= 1000)
   {
-    oxrsInput.setInvert(index, json["invert"].as<bool>());
+    bucket->tokens -= 1000;
+    if (!suppressed) return true;
   }
 
-  if (json.containsKey("disabled"))
+  if (!suppressed)
   {
-    oxrsInput.setDisabled(index, json["disabled"].as<bool>());
+    stormMask |= gpioBit(index);
+    bucket->since = millis();
+    bucket->count = 0;
+    raiseStormEvent(index, type, STORM_EVENT);
   }
+
+  bucket->count++;
+  bucket->state = state;
+  return false;
 }
 
-void jsonOutputConfig(uint8_t index, JsonVariant json)
+// Release suppressed inputs once their bucket has refilled, i.e. their
+// event rate has stayed under the limit for a full burst's worth of time
+// (or once they are no longer rate limited)
+void processStorms(void)
 {
-  if (json.containsKey("type"))
+  if (!stormMask) return;
+
+  uint32_t now = millis();
+  for (uint8_t index = 0; index < GPIO_COUNT; index++)
   {
-    uint8_t outputType = parseOutputType(json["type"]);
+    if (!(stormMask & gpioBit(index))) continue;
 
-    if (outputType != INVALID_OUTPUT_TYPE)
+    const gpioConfig_t * config = &gpioConfig[index];
+    if (config->stormRate)
     {
-      oxrsOutput.setType(index, outputType);
+      refillStorm(index, now);
+      if (storm[index].tokens < (uint32_t)config->stormBurst * 1000) continue;
     }
-  }
 
-  if (json.containsKey("timerSeconds"))
-  {
-    if (json["timerSeconds"].isNull())
-    {
-      oxrsOutput.setTimer(index, DEFAULT_TIMER_SECS);
-    }
-    else
-    {
-      oxrsOutput.setTimer(index, json["timerSeconds"].as<uint8_t>());
-    }
-  }
+    stormMask &= ~gpioBit(index);
+    raiseStormEvent(index, config->inputType, STORM_RELEASE_EVENT);
 
-  if (json.containsKey("interlockGpio"))
-  {
-    // If an empty message then treat as 'unlocked' - i.e. interlock with ourselves
-    if (json["interlockGpio"].isNull())
-    {
-      oxrsOutput.setInterlock(index, index);
-    }
-    else
+    // The summary doesn't say where an input with a state was left, so
+    // follow it with that state if any change of it was dropped
+    switch (config->inputType)
     {
-      uint8_t interlockGpio = json["interlockGpio"].as<uint8_t>();
-      uint8_t interlockIndex = getIndexFromGpio(interlockGpio);
-
-      if (interlockIndex == INVALID_GPIO_PIN)
-      {
-        oxrs.println(F("[digio] invalid interlock GPIO"));
-      }
-      else
-      {
-        oxrsOutput.setInterlock(index, interlockIndex);
-      }
+      case CONTACT:
+      case SWITCH:
+      case SECURITY:
+        if (storm[index].count) { raiseStormEvent(index, config->inputType, storm[index].state); }
+        break;
     }
   }
 }
 
-void jsonGpioConfig(JsonVariant json)
+void inputEvent(uint8_t id, uint8_t input, uint8_t type, uint8_t state)
 {
-  uint8_t index = getIndex(json);
-  if (index == INVALID_GPIO_PIN) return;
+  // The id is the bank, see processInputs()
+  uint8_t index = id * GPIO_BANK_SIZE + input;
 
-  // See if type is explicitly defined, otherwise determine from the config
-  uint8_t gpioType = INVALID_GPIO_TYPE;
+  // Drop events from an input raising them too fast - before the local
+  // rules, so a chattering contact can't chatter its outputs either
+  if (!admitInputEvent(index, type, state)) return;
 
-  if (json.containsKey("type"))
-  {
-    gpioType = parseGpioType(json["type"]);
-  }
-  else
-  {
-    if (json.containsKey("input"))
-    {
-      gpioType = GPIO_INPUT;
-    }
-    else if (json.containsKey("output"))
-    {
-      gpioType = GPIO_OUTPUT;
-    }
-  }
+  // Drive any outputs bound to this event by a local rule
+  processRule(index, type, state);
 
-  // Ignore if an invalid configuration payload
-  if (gpioType == INVALID_GPIO_TYPE) 
-    return;
+  event_t event = makeEvent(EVENT_INPUT, index, type, state);
 
-  // Store the GPIO type and setup the physical pin
-  setGpioType(index, gpioType);
+  #if defined(LATENCY_STATS)
+  event.sampledMicros = inputSampleMicros;
+  event.raisedMicros = micros();
+  recordLatency(LATENCY_INPUT_SAMPLE, event.raisedMicros - event.sampledMicros);
+  #endif
 
-  // Parse and load any type specific config
-  if (json.containsKey("input") && gpioType == GPIO_INPUT)
-  {
-    jsonInputConfig(index, json["input"]);
-  }
-  if (json.containsKey("output") && gpioType == GPIO_OUTPUT)
-  {
-    jsonOutputConfig(index, json["output"]);
-  }
+  raiseEvent(event);
 }
 
-void jsonConfig(JsonVariant json)
+#if defined(PCNT_ROTARY)
+// Report the steps each hardware counter has seen as one aggregated event
+// per interval, so CPU and MQTT load don't scale with rotation speed
+void processRotaryCounters(void)
 {
-  if (json.containsKey("gpios"))
+  if ((millis() - pcntLastReport) < pcntIntervalMs) return;
+  pcntLastReport = millis();
+
+  for (uint8_t unit = 0; unit < PCNT_UNITS; unit++)
   {
-    for (JsonVariant gpio : json["gpios"].as<JsonArray>())
-    {
-      jsonGpioConfig(gpio);    
-    }
+    uint8_t input = pcntInput[unit];
+    if (input == INVALID_GPIO_PIN) continue;
+
+    int16_t steps = pcntTake(unit);
+    if (steps == 0) continue;
+
+    // Inverting the input swaps the direction, as with software decoding
+    bool up = (steps > 0) != bitRead(gpioConfig[input].inputFlags, GPIO_CONFIG_INVERT);
+    uint8_t state = up ? LOW_EVENT : HIGH_EVENT;
+
+    processRule(input, ROTARY, state);
+
+    event_t event = makeEvent(EVENT_INPUT, input, ROTARY, state, abs(steps));
+
+    #if defined(LATENCY_STATS)
+    event.sampledMicros = event.raisedMicros = micros();
+    #endif
+
+    raiseEvent(event);
   }
 }
+#endif
 
-/**
-  Command handler
- */
-void setCommandSchema()
+void outputEvent(uint8_t id, uint8_t output, uint8_t type, uint8_t state)
 {
-  // Define our config schema
-  DynamicJsonDocument json(JSON_COMMAND_MAX_SIZE);
+  // The id is the bank, see commandOutput()
+  uint8_t index = id * GPIO_BANK_SIZE + output;
+
+  // Update the GPIO pin - i.e. turn the relay on/off (LOW/HIGH), this
+  // is only buffered here and written to hardware by writeOutputs()
+  gpioWrite(outputState, index, state);
+  outputDirty |= gpioBit(index);
+
+  #if defined(IO_TASK)
+  // Queue the event for the network task to publish
+  event_t event = makeEvent(EVENT_OUTPUT, index, type, state);
+  ioEvents.push(event);
+  #else
+  // Publish the event
+  publishOutputEvent(index, type, state);
+  #endif
+}
 
-  JsonObject gpios = json.createNestedObject("gpios");
-  setTitle(gpios, "GPIO Commands");
-  setDescription(gpios, "Send commands to one or more GPIOs on your device. You can only send commands to GPIOs which have been configured as 'output'. The type is used to validate the configuration for this output matches the command. Supported commands are 'on' or 'off' to change the output state, or 'query' to publish the current state to MQTT.");
-  gpios["type"] = "array";
+/**
+  I/O processing
+*/
+void processIO(void)
+{
+  // Replayed captures carry their own sample time
+  #if defined(LATENCY_STATS) && !defined(INPUT_INTERRUPTS) && !defined(TIMER_SCHEDULER)
+  inputSampleMicros = micros();
+  #endif
 
-  JsonObject items = gpios.createNestedObject("items");
-  items["type"] = "object";
+  uint32_t mark = profileStart();
+  profileSample(mark);
 
-  JsonObject properties = items.createNestedObject("properties");
+  #if defined(MCP_EXPANDERS)
+  // Read any expanders which have raised INT
+  scanExpanders();
+  #endif
 
-  JsonObject gpio = properties.createNestedObject("gpio");
-  setTitle(gpio, "GPIO Pin");
-  createGpioPinEnum(gpio);
+  // Check for any input events
+  #if defined(INPUT_INTERRUPTS) || defined(TIMER_SCHEDULER)
+  replayInputs();
+  #else
+  processInputs(readInputs());
+  #endif
 
-  JsonObject type = properties.createNestedObject("type");
-  setTitle(type, "Type");
-  createOutputTypeEnum(type);
+  #if defined(PCNT_ROTARY)
+  // Report any steps counted by the hardware rotary counters
+  processRotaryCounters();
+  #endif
 
-  JsonObject command = properties.createNestedObject("command");
-  setTitle(command, "Command");
-  command["type"] = "string";
-  JsonArray commandEnum = command.createNestedArray("enum");
-  commandEnum.add("query");
-  commandEnum.add("on");
-  commandEnum.add("off");
+  // Release any inputs suppressed by their rate limit
+  processStorms();
 
-  JsonArray required = items.createNestedArray("required");
-  required.add("gpio");
-  required.add("command");
+  mark = profileStage(PROFILE_INPUTS, mark);
 
-  // Pass our command schema down to the GPIO32 library
-  oxrs.setCommandSchema(json.as<JsonVariant>());
-}
+  // End any pulses started by local rules
+  processRulePulses();
 
-void jsonGpioCommand(JsonVariant json)
-{
-  uint8_t index = getIndex(json);
-  if (index == INVALID_GPIO_PIN) return;
+  // Step any PWM fades done in software
+  processPwmFades();
 
-  // Check this GPIO pin is configured as an output
-  if (gpioTypes[index] != GPIO_OUTPUT)
+  // Check for any output events
+  for (uint8_t bank = 0; bank < GPIO_BANKS; bank++)
   {
-    oxrs.println(F("[digio] command received for GPIO not configured as output"));
-    return;
+    oxrsOutput[bank].process();
   }
 
-  // Get the output type for this pin
-  uint8_t type = oxrsOutput.getType(index);
+  // Write any outputs changed by commands or timers
+  writeOutputs();
 
-  if (json.containsKey("type"))
-  {
-    if (parseOutputType(json["type"]) != type)
-    {
-      oxrs.println(F("[digio] command type doesn't match configured type"));
-      return;
-    }
-  }
+  profileStage(PROFILE_OUTPUTS, mark);
+}
 
-  if (json.containsKey("command"))
+#if defined(IO_TASK)
+// Scan inputs and process outputs at a fixed rate, independent of how
+// long the network task takes to publish
+void ioTask(void * parameter)
+{
+  TickType_t lastWake = xTaskGetTickCount();
+
+  for (;;)
   {
-    if (json["command"].isNull() || strcmp(json["command"], "query") == 0)
-    {
-      // Publish a status event with the current state
-      uint8_t state = digitalRead(GPIO_PINS[index]);
-      publishOutputEvent(index, type, state);
-    }
-    else
+    lockIO();
+
+    // Handle any commands queued by the network task
+    ioCommand_t ioCommand;
+    while (ioCommands.pop(ioCommand))
     {
-      // Send this command down to our output handler to process
-      if (strcmp(json["command"], "on") == 0)
-      {
-        oxrsOutput.handleCommand(0, index, RELAY_ON);
-      }
-      else if (strcmp(json["command"], "off") == 0)
+      if (ioCommand.kind == IO_COMMAND_PWM)
       {
-        oxrsOutput.handleCommand(0, index, RELAY_OFF);
-      }
-      else
-      {
-        oxrs.println(F("[digio] invalid command"));
+        setPwmLevel(ioCommand.index, ioCommand.command, ioCommand.fadeMs);
+        continue;
       }
-    }
-  }
-}
 
-void jsonCommand(JsonVariant json)
-{
-  if (json.containsKey("gpios"))
-  {
-    for (JsonVariant gpio : json["gpios"].as<JsonArray>())
-    {
-      jsonGpioCommand(gpio);
+      #if defined(LATENCY_STATS)
+      stampOutputCommand(ioCommand.index, ioCommand.receivedMicros);
+      #endif
+
+      commandOutput(ioCommand.index, ioCommand.command);
     }
+
+    processIO();
+
+    // Commands which didn't change an output are never written
+    #if defined(LATENCY_STATS)
+    outputCommandPending = 0;
+    #endif
+
+    unlockIO();
+
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(IO_TASK_PERIOD_MS));
   }
 }
 
-/**
-  Event handlers
-*/
-void inputEvent(uint8_t id, uint8_t input, uint8_t type, uint8_t state)
+// Report events the I/O task couldn't queue, in the log and as telemetry
+// (with the running total, so a failed publish is made good by the next)
+void publishIOEventsDropped(uint32_t dropped)
 {
-  // Publish the event
-  publishInputEvent(input, type, state);
+  oxrs.print(F("[digio] I/O event queue full, "));
+  oxrs.print(dropped - ioEventsDropped);
+  oxrs.println(F(" events dropped"));
+  ioEventsDropped = dropped;
+
+  StaticJsonDocument<IO_EVENTS_JSON_SIZE> json;
+  json["ioEvents"]["dropped"] = dropped;
+  oxrs.publishTelemetry(json.as<JsonVariant>());
 }
 
-void outputEvent(uint8_t id, uint8_t output, uint8_t type, uint8_t state)
+// Publish everything the I/O task has queued since the last pass
+void publishIOEvents(void)
 {
-  // Update the GPIO pin - i.e. turn the relay on/off (LOW/HIGH)
-  digitalWrite(GPIO_PINS[output], state);
+  event_t event;
+  while (ioEvents.pop(event))
+  {
+    publishEvent(event);
+  }
 
-  // Publish the event
-  publishOutputEvent(output, type, state);
+  uint32_t dropped = ioEvents.dropped();
+  if (dropped != ioEventsDropped)
+  {
+    publishIOEventsDropped(dropped);
+  }
 }
+#endif
 
 /**
   Setup
 */
 void setup()
 {
-  // Start serial and let settle
+  // Start serial (no settling delay, get the I/O up as soon as possible)
   Serial.begin(SERIAL_BAUD_RATE);
-  delay(1000);
   Serial.println(F("[digio] starting up..."));
   Serial.println(F("[digio] using GPIOs for digital I/O..."));
 
+  // No PWM outputs until config says so
+  beginPwm();
+
+  #if defined(MCP_EXPANDERS)
+  // Expander pins are configured over I2C, so the bus must be up first
+  beginExpanders();
+  #endif
+
+  // Initialise input handlers (default to SWITCH), first as setting a
+  // GPIO's type (below, and when restoring config) updates them
+  for (uint8_t bank = 0; bank < GPIO_BANKS; bank++)
+  {
+    oxrsInput[bank].begin(inputEvent, SWITCH);
+  }
+
+  // Initialise output handlers (default to RELAY)
+  for (uint8_t bank = 0; bank < GPIO_BANKS; bank++)
+  {
+    oxrsOutput[bank].begin(outputEvent, RELAY);
+  }
+
   // Initialse our GPIO config array (defaulting to inputs)
   for (uint8_t index = 0; index < GPIO_COUNT; index++)
   {
+    resetGpioConfig(index);
     setGpioType(index, GPIO_INPUT);
   }
 
-  // Initialise input handlers (default to SWITCH)
-  oxrsInput.begin(inputEvent, SWITCH);
+  #if defined(PCNT_ROTARY)
+  // No hardware rotary counters bound until config says so
+  memset(pcntInput, INVALID_GPIO_PIN, sizeof(pcntInput));
+  #endif
 
-  // Initialise output handlers (default to RELAY)
-  oxrsOutput.begin(outputEvent, RELAY);
+  // Restore counter totals, then the last applied GPIO config (which
+  // starts counting), before bringing up the network
+  restoreCounters();
+  restoreConfig();
+
+  #if defined(ESP32)
+  esp_register_shutdown_handler(saveCountersOnShutdown);
+  #endif
+
+  #if defined(IO_TASK)
+  // Must exist before any config can arrive
+  ioMutex = xSemaphoreCreateMutex();
+  #endif
 
   // Start hardware
   oxrs.begin(jsonConfig, jsonCommand);
 
+  #if defined(STREAM_CONFIG)
+  // Take config/command payloads before the library parses them
+  beginStream();
+  #endif
+
+  // Restore (or reset) the failover queue
+  initFailover();
+
+  #if defined(LOOP_PROFILER)
+  resetProfiler();
+  #endif
+
+  #if defined(LATENCY_STATS)
+  // Expose latency histograms on the REST API
+  oxrs.getAPI()->get("/latency", &apiLatency);
+  #endif
+
+  #if defined(INPUT_TRACE)
+  // Expose the input trace on the REST API
+  oxrs.getAPI()->get("/trace", &apiTrace);
+  #endif
+
   // Set up config schema (for self-discovery and adoption)
   setConfigSchema();
   setCommandSchema();
+
+  #if defined(IO_TASK)
+  // Hand I/O scanning over to a dedicated task on the other core
+  xTaskCreatePinnedToCore(ioTask, "io", IO_TASK_STACK_SIZE, NULL, IO_TASK_PRIORITY, &ioTaskHandle, IO_TASK_CORE);
+  #endif
+
+  #if defined(TIMER_SCHEDULER)
+  // Sample inputs at a fixed rate from a hardware timer
+  startScheduler();
+  #endif
 }
 
 /**
@@ -838,15 +2756,80 @@ void setup()
 */
 void loop()
 {
+  uint32_t mark = profileStart();
+  profilePass(mark);
+
   // Let hardware handle any events etc
   oxrs.loop();
 
-  // Check for any input events
-  oxrsInput.process(0, readInputs());
+  mark = profileStage(PROFILE_NETWORK, mark);
 
-  // Check for any output events
-  oxrsOutput.process();
+  #if defined(IO_TASK)
+  // Publish any events raised by the I/O task
+  publishIOEvents();
+  #else
+  // Check for any input/output events (profiles its own stages)
+  processIO();
+  mark = profileStart();
+  #endif
+
+  memoryBegin(MEMORY_PUBLISH);
+
+  // Publish any batched events once the window closes
+  if (batchCount > 0 && (millis() - batchStart) >= batchWindowMs)
+  {
+    flushBatch();
+  }
+
+  // Replay any events which failed to publish
+  replayFailover();
+
+  // Publish any PWM levels which have been set (or finished fading)
+  publishPwmLevels();
+
+  // Publish, and periodically persist, any counter input totals
+  publishCounters();
+  saveCounters(false);
+
+  memoryEnd(MEMORY_PUBLISH);
+
+  #if defined(LATENCY_STATS)
+  // Publish latency histograms periodically
+  publishLatency();
+  #endif
+
+  #if defined(LOOP_PROFILER)
+  // Publish (and start a new window of) profiler stats periodically
+  if (profilerIntervalMs > 0 && (millis() - profilerLastPublish) >= profilerIntervalMs)
+  {
+    profilerLastPublish = millis();
+    publishProfiler(true);
+  }
+  #endif
+
+  #if defined(MEMORY_STATS)
+  // Check for memory alarms, and publish memory stats periodically
+  if ((millis() - memoryLastCheck) >= MEMORY_CHECK_MS)
+  {
+    memoryLastCheck = millis();
+    checkMemory();
+  }
+
+  if (memoryIntervalMs > 0 && (millis() - memoryLastPublish) >= memoryIntervalMs)
+  {
+    memoryLastPublish = millis();
+    publishMemory();
+  }
+  #endif
+
+  mark = profileStage(PROFILE_PUBLISH, mark);
 
   // required to give background processes a chance
+  #if defined(TIMER_SCHEDULER)
+  waitScheduler();
+  #else
   delay(1);
+  #endif
+
+  profileStage(PROFILE_YIELD, mark);
 }
@@ -0,0 +1,159 @@
+/**
+  MCP23017 expanders (see digio.h)
+*/
+
+#include "digio.h"
+
+#if defined(MCP_EXPANDERS)
+#include <Wire.h>                     // For MCP23017 expanders
+
+/*--------------------------- Global Variables ------------------------*/
+// Expanders which answered at boot, and those which have raised INT (or
+// failed a read) since their GPIO registers were last read
+uint8_t mcpPresent = 0;
+std::atomic<uint32_t> mcpDirty { 0 };
+
+// Last level read from each expander pin (all high, i.e. inactive,
+// until read) merged into every input scan in place of a register
+gpioWord_t mcpInputs = MCP_MASK;
+
+// Expanders whose direction/pull-up/interrupt registers need rewriting
+// since a GPIO type changed
+uint8_t mcpConfigDirty = 0;
+
+/*--------------------------- Program ---------------------------------*/
+uint8_t getExpanderAddress(uint8_t expander)
+{
+  return MCP_BASE_ADDRESS + expander;
+}
+
+// Write a register pair (A then B) in one transaction
+bool writeExpander(uint8_t expander, uint8_t reg, uint16_t value)
+{
+  Wire.beginTransmission(getExpanderAddress(expander));
+  Wire.write(reg);
+  Wire.write(value & 0xff);
+  Wire.write(value >> 8);
+  return Wire.endTransmission() == 0;
+}
+
+// Read a register pair (A then B) in one transaction
+bool readExpander(uint8_t expander, uint8_t reg, uint16_t * value)
+{
+  Wire.beginTransmission(getExpanderAddress(expander));
+  Wire.write(reg);
+  if (Wire.endTransmission(false) != 0) return false;
+
+  if (Wire.requestFrom(getExpanderAddress(expander), (uint8_t)2) != 2) return false;
+  *value = Wire.read();
+  *value |= Wire.read() << 8;
+  return true;
+}
+
+// Flag every expander holding its INT line low, so only those are read
+void IRAM_ATTR expanderIsr(void)
+{
+  uint32_t dirty = 0;
+  for (uint8_t expander = 0; expander < MCP_EXPANDERS; expander++)
+  {
+    if (digitalRead(MCP_INT_GPIOS[expander]) == LOW) { bitSet(dirty, expander); }
+  }
+  mcpDirty.fetch_or(dirty);
+}
+
+// Probe each expander and set it up to raise INT on any input change,
+// every pin starts as a pulled-up input until config says otherwise
+void beginExpanders(void)
+{
+  Wire.begin(MCP_I2C_SDA, MCP_I2C_SCL, MCP_I2C_FREQUENCY);
+
+  for (uint8_t expander = 0; expander < MCP_EXPANDERS; expander++)
+  {
+    Wire.beginTransmission(getExpanderAddress(expander));
+    Wire.write(MCP_IOCON);
+    Wire.write(MCP_IOCON_MIRROR);
+    if (Wire.endTransmission() != 0)
+    {
+      oxrs.print(F("[digio] MCP23017 not found, expander "));
+      oxrs.println(expander);
+      continue;
+    }
+
+    bitSet(mcpPresent, expander);
+    bitSet(mcpConfigDirty, expander);
+
+    // INT is push-pull, and active low
+    pinMode(MCP_INT_GPIOS[expander], INPUT);
+    attachInterrupt(digitalPinToInterrupt(MCP_INT_GPIOS[expander]), expanderIsr, FALLING);
+
+    // Read once to pick up the initial levels (and clear any INT)
+    mcpDirty.fetch_or(1UL << expander);
+  }
+}
+
+// Read the GPIO registers of every expander which has raised INT since
+// it was last read - one 2-byte burst per changed expander, and no bus
+// traffic at all while nothing changes
+void scanExpanders(void)
+{
+  uint32_t dirty = mcpDirty.exchange(0) & mcpPresent;
+
+  while (dirty)
+  {
+    uint8_t expander = __builtin_ctz(dirty);
+    dirty &= dirty - 1;
+
+    uint16_t value;
+    if (!readExpander(expander, MCP_GPIOA, &value))
+    {
+      // Try again on the next scan
+      mcpDirty.fetch_or(1UL << expander);
+      continue;
+    }
+
+    uint8_t shift = mcpShift(expander);
+    mcpInputs = (mcpInputs & ~((gpioWord_t)0xffff << shift)) | ((gpioWord_t)value << shift);
+
+    // Reading GPIO clears INT, unless another change landed since
+    if (digitalRead(MCP_INT_GPIOS[expander]) == LOW)
+    {
+      mcpDirty.fetch_or(1UL << expander);
+    }
+  }
+}
+
+// Write the outputs (OLAT) of any expander with a changed output, as one
+// transaction, and after a GPIO type change rewrite its pin directions
+// too (outputs first, so they come up off)
+void writeExpanders(void)
+{
+  for (uint8_t expander = 0; expander < MCP_EXPANDERS; expander++)
+  {
+    if (!bitRead(mcpPresent, expander)) continue;
+
+    uint8_t shift = mcpShift(expander);
+    bool rewrite = bitRead(mcpConfigDirty, expander);
+    bitClear(mcpConfigDirty, expander);
+
+    bool written = true;
+    if (rewrite || (uint16_t)(outputDirty >> shift))
+    {
+      written = writeExpander(expander, MCP_OLATA, (uint16_t)(outputState >> shift));
+    }
+
+    if (rewrite && written)
+    {
+      uint16_t inputs = (uint16_t)(inputMask >> shift);
+      written = writeExpander(expander, MCP_IODIRA, inputs) &&
+                writeExpander(expander, MCP_GPPUA, inputs) &&
+                writeExpander(expander, MCP_GPINTENA, inputs);
+
+      // Pick up the level of any pin which has just become an input
+      mcpDirty.fetch_or(1UL << expander);
+    }
+
+    // Rewrite everything on the next pass if the bus let us down
+    if (!written) { bitSet(mcpConfigDirty, expander); }
+  }
+}
+#endif
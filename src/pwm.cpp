@@ -0,0 +1,290 @@
+/**
+  PWM outputs (see digio.h)
+*/
+
+#include "digio.h"
+
+/*--------------------------- Global Variables ------------------------*/
+// PWM outputs - the slot each is using, and the level (%) each is set to
+// (or fading to)
+gpioWord_t pwmMask = 0;
+uint8_t pwmChannel[GPIO_COUNT];
+uint8_t pwmLevel[GPIO_COUNT];
+
+// PWM outputs with a level to publish, set when a level is applied or
+// a fade completes (from the LEDC ISR on ESP32)
+std::atomic<uint32_t> pwmPublish { 0 };
+
+#if defined(ESP32)
+// PWM outputs the LEDC fade engine is fading, cleared from its ISR once
+// the fade ends
+std::atomic<uint32_t> pwmLedcFading { 0 };
+
+#if ESP_IDF_VERSION_MAJOR < 5
+// A running fade can't be stopped before IDF 5, so a level (or fade) set
+// meanwhile is held here and applied once it ends
+uint32_t pwmDeferred = 0;
+uint8_t pwmDeferredLevel[GPIO_COUNT];
+uint32_t pwmDeferredFadeMs[GPIO_COUNT];
+#endif
+#endif
+
+#if !defined(ESP32)
+// No fade engine, so fades are stepped in software
+gpioWord_t pwmFading = 0;
+uint16_t pwmDuty[GPIO_COUNT];
+uint16_t pwmFadeFrom[GPIO_COUNT];
+uint16_t pwmFadeTo[GPIO_COUNT];
+uint32_t pwmFadeStart[GPIO_COUNT];
+uint32_t pwmFadeMs[GPIO_COUNT];
+#endif
+
+/*--------------------------- Program ---------------------------------*/
+void beginPwm(void)
+{
+  memset(pwmChannel, PWM_NO_CHANNEL, sizeof(pwmChannel));
+
+  #if defined(ESP32)
+  // Required for PWM fades (and their completion callbacks)
+  ledc_fade_func_install(0);
+  #endif
+}
+
+uint32_t getPwmDuty(uint8_t index, uint8_t level)
+{
+  uint32_t range = (1UL << gpioConfig[index].pwmResolution) - 1;
+  return (range * level) / 100;
+}
+
+#if defined(ESP32)
+// LEDC channel for a PWM slot, and its speed mode/channel in the driver
+uint8_t getPwmLedcChannel(uint8_t index) { return pwmChannel[index] * 2; }
+ledc_mode_t getPwmLedcMode(uint8_t index) { return (ledc_mode_t)(getPwmLedcChannel(index) / 8); }
+ledc_channel_t getPwmLedcIndex(uint8_t index) { return (ledc_channel_t)(getPwmLedcChannel(index) % 8); }
+
+bool IRAM_ATTR pwmFadeEnd(const ledc_cb_param_t * param, void * arg)
+{
+  if (param->event == LEDC_FADE_END_EVT)
+  {
+    pwmLedcFading.fetch_and(~pwmBit((uintptr_t)arg));
+    pwmPublish.fetch_or(pwmBit((uintptr_t)arg));
+  }
+  return false;
+}
+#else
+void writePwmDuty(uint8_t index, uint16_t duty)
+{
+  pwmDuty[index] = duty;
+  analogWrite(GPIO_PINS[index], duty);
+}
+#endif
+
+// Hand a PWM output's pin back from its channel
+void releasePwm(uint8_t index)
+{
+  uint8_t gpio = GPIO_PINS[index];
+
+  #if defined(ESP32)
+  ledcDetachPin(gpio);
+  pwmLedcFading.fetch_and(~pwmBit(index));
+  #if ESP_IDF_VERSION_MAJOR < 5
+  pwmDeferred &= ~pwmBit(index);
+  #endif
+  #else
+  analogWrite(gpio, 0);
+  pwmFading &= ~gpioBit(index);
+  #endif
+
+  pwmChannel[index] = PWM_NO_CHANNEL;
+  pwmMask &= ~gpioBit(index);
+  pwmPublish.fetch_and(~pwmBit(index));
+
+  // Back to a plain output (if still one), in the off state
+  if (gpioConfig[index].gpioType == GPIO_OUTPUT)
+  {
+    pinMode(gpio, OUTPUT);
+    digitalWrite(gpio, RELAY_OFF);
+    gpioWrite(outputState, index, RELAY_OFF);
+  }
+}
+
+// Hand a GPIO to (or back from) PWM, to match its config
+void updatePwm(uint8_t index)
+{
+  gpioConfig_t * config = &gpioConfig[index];
+  bool pwm = isNativeGpio(index) && config->gpioType == GPIO_OUTPUT && config->outputType == PWM;
+  bool wasPwm = bitRead(pwmMask, index);
+
+  if (!pwm)
+  {
+    if (wasPwm) { releasePwm(index); }
+    return;
+  }
+
+  if (!wasPwm)
+  {
+    uint16_t used = 0;
+    for (uint8_t other = 0; other < GPIO_COUNT; other++)
+    {
+      if (bitRead(pwmMask, other)) { bitSet(used, pwmChannel[other]); }
+    }
+
+    uint8_t slot = 0;
+    while (slot < PWM_CHANNELS && bitRead(used, slot)) { slot++; }
+    if (slot == PWM_CHANNELS)
+    {
+      oxrs.println(F("[digio] no PWM channels left"));
+      return;
+    }
+
+    pwmChannel[index] = slot;
+    pwmLevel[index] = 0;
+    pwmMask |= gpioBit(index);
+  }
+
+  // (Re)apply the timer and pin, which setGpioType() will have reset
+  // if this is a config update, and restore the current level
+  uint32_t duty = getPwmDuty(index, pwmLevel[index]);
+
+  #if defined(ESP32)
+  if (ledcSetup(getPwmLedcChannel(index), config->pwmFrequency, config->pwmResolution) == 0)
+  {
+    oxrs.println(F("[digio] PWM frequency not possible at this resolution, output left off"));
+    releasePwm(index);
+    return;
+  }
+
+  ledcAttachPin(GPIO_PINS[index], getPwmLedcChannel(index));
+  ledcWrite(getPwmLedcChannel(index), duty);
+
+  ledc_cbs_t callbacks = { pwmFadeEnd };
+  ledc_cb_register(getPwmLedcMode(index), getPwmLedcIndex(index), &callbacks, (void *)(uintptr_t)index);
+  #else
+  #if defined(ESP8266)
+  // Frequency and range are shared by every PWM pin on an ESP8266
+  analogWriteFreq(config->pwmFrequency);
+  analogWriteRange((1UL << config->pwmResolution) - 1);
+  #endif
+  pwmFading &= ~gpioBit(index);
+  writePwmDuty(index, duty);
+  #endif
+
+  gpioWrite(outputState, index, pwmLevel[index] ? RELAY_ON : RELAY_OFF);
+}
+
+// Set a PWM output's level (%), either immediately or faded over fadeMs
+// by the LEDC fade engine (stepped in software where there isn't one),
+// the level is published once it has been reached
+void setPwmLevel(uint8_t index, uint8_t level, uint32_t fadeMs)
+{
+  if (!bitRead(pwmMask, index)) return;
+
+  // Anything setting the level overrides a pulse in progress
+  rulePulseOff[index] = 0;
+
+  level = min(level, (uint8_t)100);
+
+  #if defined(ESP32)
+  // A running fade would carry on over a new level, and a new fade would
+  // wait (blocking the I/O) for it to end
+  if (pwmLedcFading.load() & pwmBit(index))
+  {
+    #if ESP_IDF_VERSION_MAJOR >= 5
+    ledc_fade_stop(getPwmLedcMode(index), getPwmLedcIndex(index));
+    pwmLedcFading.fetch_and(~pwmBit(index));
+    #else
+    pwmDeferred |= pwmBit(index);
+    pwmDeferredLevel[index] = level;
+    pwmDeferredFadeMs[index] = fadeMs;
+    return;
+    #endif
+  }
+  #endif
+
+  pwmLevel[index] = level;
+  gpioWrite(outputState, index, level ? RELAY_ON : RELAY_OFF);
+
+  uint32_t duty = getPwmDuty(index, level);
+
+  #if defined(ESP32)
+  if (fadeMs)
+  {
+    pwmLedcFading.fetch_or(pwmBit(index));
+    ledc_set_fade_with_time(getPwmLedcMode(index), getPwmLedcIndex(index), duty, fadeMs);
+    ledc_fade_start(getPwmLedcMode(index), getPwmLedcIndex(index), LEDC_FADE_NO_WAIT);
+    return;
+  }
+
+  ledcWrite(getPwmLedcChannel(index), duty);
+  #else
+  if (fadeMs)
+  {
+    pwmFadeFrom[index] = pwmDuty[index];
+    pwmFadeTo[index] = duty;
+    pwmFadeStart[index] = millis();
+    pwmFadeMs[index] = fadeMs;
+    pwmFading |= gpioBit(index);
+    return;
+  }
+
+  pwmFading &= ~gpioBit(index);
+  writePwmDuty(index, duty);
+  #endif
+
+  pwmPublish.fetch_or(pwmBit(index));
+}
+
+// Step any software fades (on ESP32 the LEDC fade engine does this, but
+// anything set while a fade couldn't be stopped is applied here)
+void processPwmFades(void)
+{
+  #if defined(ESP32)
+  #if ESP_IDF_VERSION_MAJOR < 5
+  uint32_t ready = pwmDeferred & ~pwmLedcFading.load();
+  while (ready)
+  {
+    uint8_t index = gpioFirst(ready);
+    ready &= ready - 1;
+
+    pwmDeferred &= ~pwmBit(index);
+    setPwmLevel(index, pwmDeferredLevel[index], pwmDeferredFadeMs[index]);
+  }
+  #endif
+  #else
+  if (!pwmFading) return;
+
+  uint32_t now = millis();
+  for (uint8_t index = 0; index < GPIO_COUNT; index++)
+  {
+    if (!bitRead(pwmFading, index)) continue;
+
+    uint32_t elapsed = now - pwmFadeStart[index];
+    if (elapsed >= pwmFadeMs[index])
+    {
+      pwmFading &= ~gpioBit(index);
+      writePwmDuty(index, pwmFadeTo[index]);
+      pwmPublish.fetch_or(pwmBit(index));
+      continue;
+    }
+
+    int32_t from = pwmFadeFrom[index];
+    int32_t to = pwmFadeTo[index];
+    uint16_t duty = from + ((to - from) * (int32_t)elapsed) / (int32_t)pwmFadeMs[index];
+    if (duty != pwmDuty[index]) { writePwmDuty(index, duty); }
+  }
+  #endif
+}
+
+void publishPwmLevels(void)
+{
+  uint32_t publish = pwmPublish.exchange(0);
+
+  for (uint8_t index = 0; publish; index++, publish >>= 1)
+  {
+    if (!(publish & 1) || !bitRead(pwmMask, index)) continue;
+
+    uint8_t level = pwmLevel[index];
+    event_t event = makeEvent(EVENT_OUTPUT, index, PWM, level ? RELAY_ON : RELAY_OFF, level);
+    publishEvent(event);
+  }
+}
@@ -0,0 +1,212 @@
+/**
+  Local rules (see digio.h)
+*/
+
+#include "digio.h"
+
+/*--------------------------- Global Variables ------------------------*/
+rule_t rules[GPIO_COUNT][RULES_PER_INPUT];
+
+// When each output switched on by a 'pulse' rule is due off (0 if not)
+uint32_t rulePulseOff[GPIO_COUNT];
+
+/*--------------------------- Program ---------------------------------*/
+void clearRules(void)
+{
+  memset(rules, 0, sizeof(rules));
+  memset(rulePulseOff, 0, sizeof(rulePulseOff));
+}
+
+uint8_t parseRuleAction(const char * action)
+{
+  if (strcmp(action, "on")     == 0) { return RULE_ON; }
+  if (strcmp(action, "off")    == 0) { return RULE_OFF; }
+  if (strcmp(action, "toggle") == 0) { return RULE_TOGGLE; }
+  if (strcmp(action, "pulse")  == 0) { return RULE_PULSE; }
+
+  oxrs.println(F("[digio] invalid rule action"));
+  return RULE_NONE;
+}
+
+// Add a rule to the table, false if it was rejected
+bool jsonRuleConfig(JsonVariant json)
+{
+  if (!json.containsKey("inputGpio") || !json.containsKey("outputGpio") ||
+      !json.containsKey("event") || !json.containsKey("action"))
+  {
+    oxrs.println(F("[digio] missing rule inputGpio, event, outputGpio or action"));
+    return false;
+  }
+
+  uint8_t inputIndex = getIndexFromGpio(json["inputGpio"].as<uint8_t>());
+  uint8_t outputIndex = getIndexFromGpio(json["outputGpio"].as<uint8_t>());
+  if (inputIndex == INVALID_GPIO_PIN || outputIndex == INVALID_GPIO_PIN)
+  {
+    oxrs.println(F("[digio] invalid rule GPIO"));
+    return false;
+  }
+
+  uint8_t action = parseRuleAction(json["action"]);
+  if (action == RULE_NONE) return false;
+
+  uint16_t pulseMs = DEFAULT_RULE_PULSE_MS;
+  if (json.containsKey("pulseMs") && !json["pulseMs"].isNull())
+  {
+    pulseMs = json["pulseMs"].as<uint16_t>();
+  }
+
+  // Event names are unique across input types, so the name alone gives
+  // the type and state(s) to match
+  const char * event = json["event"];
+  uint8_t inputType = INVALID_INPUT_TYPE;
+  uint16_t events = 0;
+
+  for (uint8_t type = 0; type < INPUT_TYPE_COUNT && event && !events; type++)
+  {
+    for (uint8_t state = 0; state < INPUT_EVENT_COUNT; state++)
+    {
+      const char * name = readInputEventName(type, state);
+      if (!name || strcmp_P(event, name) != 0) continue;
+
+      inputType = type;
+      events |= 1 << state;
+    }
+  }
+
+  if (!events)
+  {
+    oxrs.println(F("[digio] invalid rule event"));
+    return false;
+  }
+
+  // Merge with a rule doing the same thing, for either the same events
+  // (another output) or the same outputs (another event), else take a
+  // free slot
+  gpioWord_t output = gpioBit(outputIndex);
+  rule_t * empty = NULL;
+
+  for (uint8_t slot = 0; slot < RULES_PER_INPUT; slot++)
+  {
+    rule_t * rule = &rules[inputIndex][slot];
+    if (!rule->outputs)
+    {
+      if (!empty) { empty = rule; }
+      continue;
+    }
+
+    if (rule->inputType != inputType || rule->action != action || rule->pulseMs != pulseMs) continue;
+
+    if (rule->events == events || rule->outputs == output)
+    {
+      rule->events |= events;
+      rule->outputs |= output;
+      return true;
+    }
+  }
+
+  if (!empty)
+  {
+    oxrs.println(F("[digio] too many rules for input, rule ignored"));
+    return false;
+  }
+
+  empty->outputs = output;
+  empty->pulseMs = pulseMs;
+  empty->events = events;
+  empty->inputType = inputType;
+  empty->action = action;
+  return true;
+}
+
+// Returns how many rules were rejected
+uint16_t jsonRulesConfig(JsonVariant json)
+{
+  // The rules list always replaces the whole table, and forgets pulses
+  // the old rules started (leaving those outputs as they are)
+  clearRules();
+
+  uint16_t rejected = 0;
+  for (JsonVariant rule : json.as<JsonArray>())
+  {
+    if (!jsonRuleConfig(rule)) { rejected++; }
+  }
+  return rejected;
+}
+
+// Report how much of a rules list was taken, so a rejected rule shows up
+// somewhere other than the serial log
+void publishRulesResult(uint16_t accepted, uint16_t rejected)
+{
+  StaticJsonDocument<RULES_JSON_SIZE> json;
+  JsonObject result = json.createNestedObject("rules");
+  result["accepted"] = accepted;
+  result["rejected"] = rejected;
+
+  oxrs.publishStatus(json.as<JsonVariant>());
+}
+
+void ruleOutputCommand(uint8_t index, uint8_t command)
+{
+  // Rules run in the I/O context, which owns the output handler
+  if (gpioTypes[index] != GPIO_OUTPUT) return;
+
+  if (bitRead(pwmMask, index))
+  {
+    setPwmLevel(index, command == RELAY_ON ? 100 : 0, 0);
+    return;
+  }
+
+  commandOutput(index, command);
+}
+
+void runRule(const rule_t * rule)
+{
+  for (uint8_t index = 0; index < GPIO_COUNT; index++)
+  {
+    if (!bitRead(rule->outputs, index)) continue;
+
+    switch (rule->action)
+    {
+      case RULE_ON:
+        ruleOutputCommand(index, RELAY_ON);
+        break;
+      case RULE_OFF:
+        ruleOutputCommand(index, RELAY_OFF);
+        break;
+      case RULE_TOGGLE:
+        ruleOutputCommand(index, bitRead(outputState, index) == RELAY_ON ? RELAY_OFF : RELAY_ON);
+        break;
+      case RULE_PULSE:
+        ruleOutputCommand(index, RELAY_ON);
+        // Never 0, which means no pulse is running
+        rulePulseOff[index] = (millis() + rule->pulseMs) | 1;
+        break;
+    }
+  }
+}
+
+void processRule(uint8_t input, uint8_t type, uint8_t state)
+{
+  if (state >= INPUT_EVENT_COUNT) return;
+
+  for (uint8_t slot = 0; slot < RULES_PER_INPUT; slot++)
+  {
+    const rule_t * rule = &rules[input][slot];
+    if (!bitRead(rule->events, state) || rule->inputType != type) continue;
+
+    runRule(rule);
+  }
+}
+
+void processRulePulses(void)
+{
+  uint32_t now = millis();
+  for (uint8_t index = 0; index < GPIO_COUNT; index++)
+  {
+    if (rulePulseOff[index] && (int32_t)(now - rulePulseOff[index]) >= 0)
+    {
+      rulePulseOff[index] = 0;
+      ruleOutputCommand(index, RELAY_OFF);
+    }
+  }
+}
@@ -0,0 +1,615 @@
+/**
+  Latency, loop profiler and memory stats (see digio.h)
+*/
+
+#include "digio.h"
+
+/*--------------------------- Global Variables ------------------------*/
+#if defined(LATENCY_STATS)
+const char * const LATENCY_NAMES[LATENCY_STAGES] =
+{
+  "inputSample",
+  "inputQueue",
+  "inputPublish",
+  "inputTotal",
+  "outputCommand",
+};
+
+struct latencyHistogram_t
+{
+  uint32_t count;
+  uint32_t max;
+  uint32_t buckets[LATENCY_BUCKETS];
+};
+
+latencyHistogram_t latency[LATENCY_STAGES];
+uint32_t latencyLastTelemetry = 0;
+
+// When a command was received for each output not yet written
+uint32_t outputCommandMicros[GPIO_COUNT];
+gpioWord_t outputCommandPending = 0;
+
+#define       LATENCY_JSON_SIZE     (JSON_OBJECT_SIZE(1) + JSON_OBJECT_SIZE(LATENCY_STAGES) + LATENCY_STAGES * JSON_OBJECT_SIZE(4))
+#endif
+#if defined(LOOP_PROFILER)
+const char * const PROFILE_NAMES[PROFILE_STAGES] =
+{
+  "network",
+  "inputs",
+  "outputs",
+  "publish",
+  "yield",
+};
+
+// Each stage counts its own passes, as with the I/O task (if enabled)
+// the inputs/outputs stages run at a different rate to the loop
+struct profileStats_t
+{
+  uint32_t passes;
+  uint32_t totalUs;
+  uint32_t maxUs;
+};
+
+// Stats for the current window, reset each time they are published
+struct profiler_t
+{
+  profileStats_t stages[PROFILE_STAGES];
+  uint32_t passes;
+  uint32_t overruns;
+  uint32_t maxPeriodUs;
+  uint32_t samples;
+  uint32_t sampleTotalUs;
+  uint32_t sampleMinUs;
+  uint32_t sampleMaxUs;
+};
+
+profiler_t profiler;
+
+uint32_t profilerLastPass = 0;
+uint32_t profilerLastSample = 0;
+uint32_t profilerLastPublish = 0;
+
+uint32_t profilerDeadlineUs = DEFAULT_PROFILER_DEADLINE_US;
+uint32_t profilerIntervalMs = DEFAULT_PROFILER_INTERVAL_MS;
+
+#define       PROFILER_JSON_SIZE    (JSON_OBJECT_SIZE(1) + JSON_OBJECT_SIZE(7) + JSON_OBJECT_SIZE(PROFILE_STAGES) + PROFILE_STAGES * JSON_ARRAY_SIZE(2) + JSON_ARRAY_SIZE(3))
+#endif
+#if defined(MEMORY_STATS)
+const char * const MEMORY_PATH_NAMES[MEMORY_PATHS] =
+{
+  "schema",
+  "config",
+  "command",
+  "publish",
+};
+
+// Gauges which can raise an alarm when they fall below their threshold
+enum memoryAlarm_t
+{
+  MEMORY_ALARM_FREE_HEAP,
+  MEMORY_ALARM_LARGEST_BLOCK,
+  MEMORY_ALARM_STACK_FREE,
+  MEMORY_ALARMS
+};
+
+const char * const MEMORY_ALARM_NAMES[MEMORY_ALARMS] =
+{
+  "freeHeap",
+  "largestBlock",
+  "stackFree",
+};
+
+// Most heap and stack (bytes) each path has used below what it entered
+// with, as seen at its checkpoints (see memoryCheckpoint)
+struct memoryPathStats_t
+{
+  uint32_t calls;
+  uint32_t heapBytes;
+  uint32_t stackBytes;
+};
+
+memoryPathStats_t memoryPaths[MEMORY_PATHS];
+
+// The path being measured (MEMORY_PATHS if none) - free heap and stack
+// pointer on entry, and the lowest of each seen since
+uint8_t memoryPath = MEMORY_PATHS;
+uint32_t memoryEntryHeap = 0;
+uintptr_t memoryEntryStack = 0;
+uint32_t memoryLowHeap = 0;
+uintptr_t memoryLowStack = 0;
+
+// Lowest free heap seen at any sample or checkpoint (the ESP32 also
+// tracks this itself, between our samples too)
+uint32_t memoryMinFreeHeap = UINT32_MAX;
+
+// Alarm thresholds (bytes, 0 for no alarm), and those currently raised
+uint32_t memoryThresholds[MEMORY_ALARMS];
+uint8_t memoryAlarms = 0;
+
+uint32_t memoryLastCheck = 0;
+uint32_t memoryLastPublish = 0;
+uint32_t memoryIntervalMs = DEFAULT_MEMORY_INTERVAL_MS;
+
+#define       MEMORY_JSON_SIZE      (JSON_OBJECT_SIZE(1) + JSON_OBJECT_SIZE(8) + JSON_OBJECT_SIZE(MEMORY_PATHS) + MEMORY_PATHS * JSON_ARRAY_SIZE(2) + JSON_ARRAY_SIZE(MEMORY_ALARMS))
+#endif
+
+/*--------------------------- Program ---------------------------------*/
+#if defined(LATENCY_STATS)
+/**
+  Latency histograms
+*/
+void recordLatency(uint8_t stage, uint32_t us)
+{
+  latencyHistogram_t * histogram = &latency[stage];
+
+  // Bucket n holds values below 2^n, i.e. it's the bit length of the value
+  uint8_t bucket = us ? 32 - __builtin_clz(us) : 0;
+  if (bucket >= LATENCY_BUCKETS) { bucket = LATENCY_BUCKETS - 1; }
+
+  histogram->buckets[bucket]++;
+  histogram->count++;
+  if (us > histogram->max) { histogram->max = us; }
+}
+
+void stampOutputCommand(uint8_t index, uint32_t receivedMicros)
+{
+  outputCommandMicros[index] = receivedMicros;
+  outputCommandPending |= gpioBit(index);
+}
+
+void recordOutputLatency(gpioWord_t written)
+{
+  gpioWord_t pending = written & outputCommandPending;
+  if (!pending) return;
+
+  uint32_t now = micros();
+  for (uint8_t index = 0; index < GPIO_COUNT; index++)
+  {
+    if (bitRead(pending, index))
+    {
+      recordLatency(LATENCY_OUTPUT_COMMAND, now - outputCommandMicros[index]);
+    }
+  }
+  outputCommandPending &= ~pending;
+}
+
+void recordPublishLatency(const event_t & event, uint32_t serializeMicros, uint32_t publishedMicros)
+{
+  if (event.source != EVENT_INPUT) return;
+
+  recordLatency(LATENCY_INPUT_QUEUE, serializeMicros - event.raisedMicros);
+  recordLatency(LATENCY_INPUT_PUBLISH, publishedMicros - serializeMicros);
+  recordLatency(LATENCY_INPUT_TOTAL, publishedMicros - event.sampledMicros);
+}
+
+// Upper bound of the bucket holding the given percentile
+uint32_t latencyPercentile(const latencyHistogram_t * histogram, uint8_t percent)
+{
+  if (histogram->count == 0) return 0;
+
+  uint32_t target = ((uint64_t)histogram->count * percent + 99) / 100;
+  uint32_t seen = 0;
+
+  for (uint8_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++)
+  {
+    seen += histogram->buckets[bucket];
+    if (seen >= target)
+    {
+      uint32_t upper = bucket ? (1UL << bucket) - 1 : 0;
+      return min(upper, histogram->max);
+    }
+  }
+
+  return histogram->max;
+}
+
+// The I/O task (if enabled) records into the histograms as it goes, so
+// is locked out while they are read
+void latencyJson(JsonObject json)
+{
+  for (uint8_t stage = 0; stage < LATENCY_STAGES; stage++)
+  {
+    const latencyHistogram_t * histogram = &latency[stage];
+
+    JsonObject stats = json.createNestedObject(LATENCY_NAMES[stage]);
+    stats["count"] = histogram->count;
+    stats["p50"] = latencyPercentile(histogram, 50);
+    stats["p99"] = latencyPercentile(histogram, 99);
+    stats["max"] = histogram->max;
+  }
+}
+
+void publishLatency(void)
+{
+  if ((millis() - latencyLastTelemetry) < LATENCY_TELEMETRY_MS) return;
+  latencyLastTelemetry = millis();
+
+  StaticJsonDocument<LATENCY_JSON_SIZE> json;
+  lockIO();
+  latencyJson(json.createNestedObject("latency"));
+  unlockIO();
+  oxrs.publishTelemetry(json.as<JsonVariant>());
+}
+
+void apiLatency(Request & req, Response & res)
+{
+  StaticJsonDocument<LATENCY_JSON_SIZE> json;
+  lockIO();
+  latencyJson(json.to<JsonObject>());
+  unlockIO();
+
+  res.set("Content-Type", "application/json");
+  serializeJson(json, res);
+}
+#endif
+
+#if defined(LOOP_PROFILER)
+/**
+  Loop profiler (see digio.h for the no-ops when disabled)
+*/
+uint32_t profileStart(void)
+{
+  return micros();
+}
+
+// Record a stage which began at 'start', returns the start of the next
+uint32_t profileStage(uint8_t stage, uint32_t start)
+{
+  uint32_t now = micros();
+  uint32_t us = now - start;
+
+  profiler.stages[stage].passes++;
+  profiler.stages[stage].totalUs += us;
+  if (us > profiler.stages[stage].maxUs) { profiler.stages[stage].maxUs = us; }
+  return now;
+}
+
+// Record the period since the previous loop pass started
+void profilePass(uint32_t start)
+{
+  if (profiler.passes > 0)
+  {
+    uint32_t period = start - profilerLastPass;
+    if (period > profiler.maxPeriodUs) { profiler.maxPeriodUs = period; }
+    if (period > profilerDeadlineUs) { profiler.overruns++; }
+  }
+
+  profiler.passes++;
+  profilerLastPass = start;
+}
+
+// Record the period between input scans, as seen by OXRS_Input
+void profileSample(uint32_t now)
+{
+  if (profiler.samples > 0 || profilerLastSample != 0)
+  {
+    uint32_t period = now - profilerLastSample;
+    profiler.sampleTotalUs += period;
+    if (period < profiler.sampleMinUs) { profiler.sampleMinUs = period; }
+    if (period > profiler.sampleMaxUs) { profiler.sampleMaxUs = period; }
+    profiler.samples++;
+  }
+
+  profilerLastSample = now;
+}
+
+// The I/O task (if enabled) records its stages and samples as it goes,
+// so both of these need it locked out
+void resetProfiler(void)
+{
+  lockIO();
+  memset(&profiler, 0, sizeof(profiler));
+  profiler.sampleMinUs = UINT32_MAX;
+  unlockIO();
+}
+
+void profilerJson(JsonObject json)
+{
+  uint32_t samples = max(profiler.samples, (uint32_t)1);
+
+  json["passes"] = profiler.passes;
+  json["overruns"] = profiler.overruns;
+  json["deadlineUs"] = profilerDeadlineUs;
+  json["maxPeriodUs"] = profiler.maxPeriodUs;
+
+  // Mean and max for each stage
+  JsonObject stages = json.createNestedObject("stagesUs");
+  for (uint8_t stage = 0; stage < PROFILE_STAGES; stage++)
+  {
+    JsonArray stats = stages.createNestedArray(PROFILE_NAMES[stage]);
+    stats.add(profiler.stages[stage].totalUs / max(profiler.stages[stage].passes, (uint32_t)1));
+    stats.add(profiler.stages[stage].maxUs);
+  }
+
+  // Min, mean and max period between input scans
+  uint32_t sampleMinUs = profiler.samples ? profiler.sampleMinUs : 0;
+  JsonArray sample = json.createNestedArray("sampleUs");
+  sample.add(sampleMinUs);
+  sample.add(profiler.sampleTotalUs / samples);
+  sample.add(profiler.sampleMaxUs);
+
+  json["jitterUs"] = profiler.sampleMaxUs - sampleMinUs;
+}
+
+void publishProfiler(bool reset)
+{
+  StaticJsonDocument<PROFILER_JSON_SIZE> json;
+  lockIO();
+  profilerJson(json.createNestedObject("profiler"));
+  unlockIO();
+  oxrs.publishTelemetry(json.as<JsonVariant>());
+
+  if (reset) { resetProfiler(); }
+}
+#endif
+
+#if defined(MEMORY_STATS)
+/**
+  Memory stats (see digio.h for the no-ops when disabled)
+*/
+uint32_t memoryFreeHeap(void)
+{
+  #if defined(OXRS_NATIVE)
+  uint32_t free = nativeGetFreeHeap();
+  #else
+  uint32_t free = ESP.getFreeHeap();
+  #endif
+
+  if (free < memoryMinFreeHeap) { memoryMinFreeHeap = free; }
+  return free;
+}
+
+uint32_t memoryLargestBlock(void)
+{
+  #if defined(ESP32)
+  return ESP.getMaxAllocHeap();
+  #elif defined(ESP8266)
+  return ESP.getMaxFreeBlockSize();
+  #else
+  return nativeGetFreeHeap();
+  #endif
+}
+
+uint32_t memoryMinHeap(void)
+{
+  #if defined(ESP32)
+  return min(memoryMinFreeHeap, ESP.getMinFreeHeap());
+  #else
+  return memoryMinFreeHeap;
+  #endif
+}
+
+// Stack the loop task has never used (so must be called from it)
+uint32_t memoryStackFree(void)
+{
+  #if defined(ESP32)
+  return uxTaskGetStackHighWaterMark(NULL);
+  #elif defined(ESP8266)
+  return ESP.getFreeContStack();
+  #else
+  return nativeGetStackFree();
+  #endif
+}
+
+// Not inlined, so each call's local is in a frame at the caller's depth
+uintptr_t __attribute__((noinline)) memoryStackPointer(void)
+{
+  volatile uint8_t marker = 0;
+  return (uintptr_t)&marker;
+}
+
+// Start measuring a path, unless one is already being measured
+void memoryBegin(uint8_t path)
+{
+  if (memoryPath != MEMORY_PATHS) return;
+
+  memoryPath = path;
+  memoryEntryHeap = memoryLowHeap = memoryFreeHeap();
+  memoryEntryStack = memoryLowStack = memoryStackPointer();
+}
+
+// Sample heap and stack at a point likely to be a path's deepest - i.e.
+// with its JSON documents built, just before handing them to the library
+// (what the library uses below that isn't seen)
+void memoryCheckpoint(void)
+{
+  if (memoryPath == MEMORY_PATHS) return;
+
+  uint32_t heap = memoryFreeHeap();
+  if (heap < memoryLowHeap) { memoryLowHeap = heap; }
+
+  uintptr_t stack = memoryStackPointer();
+  if (stack < memoryLowStack) { memoryLowStack = stack; }
+}
+
+void memoryEnd(uint8_t path)
+{
+  if (memoryPath != path) return;
+
+  memoryCheckpoint();
+
+  memoryPathStats_t * stats = &memoryPaths[path];
+  stats->calls++;
+  stats->heapBytes = max(stats->heapBytes, memoryEntryHeap - memoryLowHeap);
+  stats->stackBytes = max(stats->stackBytes, (uint32_t)(memoryEntryStack - memoryLowStack));
+
+  memoryPath = MEMORY_PATHS;
+}
+
+void resetMemoryStats(void)
+{
+  memset(memoryPaths, 0, sizeof(memoryPaths));
+  memoryMinFreeHeap = UINT32_MAX;
+}
+
+void memoryJson(JsonObject json)
+{
+  uint32_t freeHeap = memoryFreeHeap();
+  uint32_t largestBlock = memoryLargestBlock();
+
+  json["freeHeap"] = freeHeap;
+  json["largestBlock"] = largestBlock;
+  json["minFreeHeap"] = memoryMinHeap();
+
+  // How much of the free heap can't be had in one allocation (%)
+  json["fragmentation"] = freeHeap ? 100 - (uint32_t)((100ULL * largestBlock) / freeHeap) : 0;
+
+  json["stackFree"] = memoryStackFree();
+  #if defined(IO_TASK)
+  json["ioStackFree"] = uxTaskGetStackHighWaterMark(ioTaskHandle);
+  #endif
+
+  // Peak heap and stack for each path
+  JsonObject paths = json.createNestedObject("peakBytes");
+  for (uint8_t path = 0; path < MEMORY_PATHS; path++)
+  {
+    JsonArray stats = paths.createNestedArray(MEMORY_PATH_NAMES[path]);
+    stats.add(memoryPaths[path].heapBytes);
+    stats.add(memoryPaths[path].stackBytes);
+  }
+
+  JsonArray alarms = json.createNestedArray("alarms");
+  for (uint8_t alarm = 0; alarm < MEMORY_ALARMS; alarm++)
+  {
+    if (bitRead(memoryAlarms, alarm)) { alarms.add(MEMORY_ALARM_NAMES[alarm]); }
+  }
+}
+
+void publishMemory(void)
+{
+  StaticJsonDocument<MEMORY_JSON_SIZE> json;
+  memoryJson(json.createNestedObject("memory"));
+  oxrs.publishTelemetry(json.as<JsonVariant>());
+}
+
+// Compare the gauges against their thresholds, publishing straight away
+// if any alarm is raised or cleared
+void checkMemory(void)
+{
+  uint32_t gauges[MEMORY_ALARMS];
+  gauges[MEMORY_ALARM_FREE_HEAP] = memoryFreeHeap();
+  gauges[MEMORY_ALARM_LARGEST_BLOCK] = memoryLargestBlock();
+  gauges[MEMORY_ALARM_STACK_FREE] = memoryStackFree();
+
+  uint8_t alarms = 0;
+  for (uint8_t alarm = 0; alarm < MEMORY_ALARMS; alarm++)
+  {
+    if (gauges[alarm] < memoryThresholds[alarm]) { bitSet(alarms, alarm); }
+  }
+
+  if (alarms == memoryAlarms) return;
+
+  if (alarms & ~memoryAlarms)
+  {
+    oxrs.println(F("[digio] [memory] alarm raised"));
+  }
+  else
+  {
+    oxrs.println(F("[digio] [memory] alarm cleared"));
+  }
+
+  memoryAlarms = alarms;
+  memoryLastPublish = millis();
+  publishMemory();
+}
+#endif
+
+#if defined(LOOP_PROFILER)
+void jsonProfilerConfig(JsonVariant json)
+{
+  if (json.containsKey("deadlineUs"))
+  {
+    if (json["deadlineUs"].isNull())
+    {
+      profilerDeadlineUs = DEFAULT_PROFILER_DEADLINE_US;
+    }
+    else
+    {
+      profilerDeadlineUs = json["deadlineUs"].as<uint32_t>();
+    }
+  }
+
+  if (json.containsKey("intervalSeconds"))
+  {
+    if (json["intervalSeconds"].isNull())
+    {
+      profilerIntervalMs = DEFAULT_PROFILER_INTERVAL_MS;
+    }
+    else
+    {
+      profilerIntervalMs = json["intervalSeconds"].as<uint32_t>() * 1000;
+    }
+  }
+}
+#endif
+
+#if defined(MEMORY_STATS)
+void jsonMemoryConfig(JsonVariant json)
+{
+  if (json.containsKey("intervalSeconds"))
+  {
+    if (json["intervalSeconds"].isNull())
+    {
+      memoryIntervalMs = DEFAULT_MEMORY_INTERVAL_MS;
+    }
+    else
+    {
+      memoryIntervalMs = json["intervalSeconds"].as<uint32_t>() * 1000;
+    }
+  }
+
+  // Thresholds are named after their gauge, null (or 0) for no alarm
+  for (uint8_t alarm = 0; alarm < MEMORY_ALARMS; alarm++)
+  {
+    if (json.containsKey(MEMORY_ALARM_NAMES[alarm]))
+    {
+      memoryThresholds[alarm] = json[MEMORY_ALARM_NAMES[alarm]].as<uint32_t>();
+    }
+  }
+}
+#endif
+
+#if defined(LOOP_PROFILER)
+void jsonProfilerCommand(JsonVariant json)
+{
+  if (!json.is<const char *>())
+  {
+    oxrs.println(F("[digio] invalid profiler command"));
+  }
+  else if (strcmp(json, "query") == 0)
+  {
+    // Publish the current window, without starting a new one
+    publishProfiler(false);
+  }
+  else if (strcmp(json, "reset") == 0)
+  {
+    resetProfiler();
+  }
+  else
+  {
+    oxrs.println(F("[digio] invalid profiler command"));
+  }
+}
+#endif
+
+#if defined(MEMORY_STATS)
+void jsonMemoryCommand(JsonVariant json)
+{
+  if (!json.is<const char *>())
+  {
+    oxrs.println(F("[digio] invalid memory command"));
+  }
+  else if (strcmp(json, "query") == 0)
+  {
+    publishMemory();
+  }
+  else if (strcmp(json, "reset") == 0)
+  {
+    resetMemoryStats();
+  }
+  else
+  {
+    oxrs.println(F("[digio] invalid memory command"));
+  }
+}
+#endif
@@ -0,0 +1,458 @@
+/**
+  Streamed config/command parser (see digio.h)
+*/
+
+#include "digio.h"
+
+#if defined(STREAM_CONFIG)
+#include <PubSubClient.h>             // For taking payloads from the MQTT client
+#include <OXRS_MQTT.h>                // For the config/command topics
+
+// A slice of the payload buffer
+typedef struct
+{
+  const char * start;
+  size_t length;
+} payloadSpan_t;
+
+// Steps through the members of an object, or the elements of an array,
+// without parsing them
+typedef struct
+{
+  const char * next;        // NULL once the closing bracket is reached
+  const char * end;
+  char close;
+  bool error;
+} payloadScan_t;
+
+// Reads as an object made up of just some members of a payload, so
+// deserializeJson() can parse those without them being copied out
+class PayloadMembers
+{
+  public:
+    PayloadMembers() : _count(0), _member(0), _offset(0), _opened(false), _closed(false) {}
+
+    bool add(const payloadSpan_t & member)
+    {
+      if (_count >= STREAM_MAX_MEMBERS) return false;
+      _members[_count++] = member;
+      return true;
+    }
+
+    int read(void)
+    {
+      if (!_opened)
+      {
+        _opened = true;
+        return '{';
+      }
+
+      if (_member < _count)
+      {
+        if (_offset < _members[_member].length)
+        {
+          return _members[_member].start[_offset++];
+        }
+
+        _offset = 0;
+        if (++_member < _count) return ',';
+      }
+
+      if (!_closed)
+      {
+        _closed = true;
+        return '}';
+      }
+
+      return -1;
+    }
+
+    size_t readBytes(char * buffer, size_t length)
+    {
+      size_t count = 0;
+      while (count < length)
+      {
+        int c = read();
+        if (c < 0) break;
+        buffer[count++] = c;
+      }
+      return count;
+    }
+
+  private:
+    payloadSpan_t _members[STREAM_MAX_MEMBERS];
+    uint8_t _count;
+    uint8_t _member;
+    size_t _offset;
+    bool _opened;
+    bool _closed;
+};
+
+const char * scanSpace(const char * p, const char * end)
+{
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) { p++; }
+  return p;
+}
+
+// Find where the JSON value starting at p ends, NULL if it is cut short
+const char * scanValue(const char * p, const char * end)
+{
+  uint8_t depth = 0;
+  bool quoted = false;
+
+  for (; p < end; p++)
+  {
+    if (quoted)
+    {
+      if (*p == '\\')
+      {
+        p++;
+      }
+      else if (*p == '"')
+      {
+        quoted = false;
+        if (depth == 0) return p + 1;
+      }
+      continue;
+    }
+
+    switch (*p)
+    {
+      case '"':
+        quoted = true;
+        break;
+
+      case '{':
+      case '[':
+        depth++;
+        break;
+
+      case '}':
+      case ']':
+        if (depth == 0) return p;
+        if (--depth == 0) return p + 1;
+        break;
+
+      case ',':
+      case ' ':
+      case '\t':
+      case '\r':
+      case '\n':
+        if (depth == 0) return p;
+        break;
+    }
+  }
+
+  // Only a bare number/literal can run up to the end of the payload
+  return (depth == 0 && !quoted) ? p : NULL;
+}
+
+bool scanBegin(payloadScan_t & scan, const payloadSpan_t & span, char open)
+{
+  scan.end = span.start + span.length;
+  scan.next = scanSpace(span.start, scan.end);
+  scan.close = open == '{' ? '}' : ']';
+  scan.error = false;
+
+  if (scan.next == scan.end || *scan.next != open) return false;
+
+  // Allow for an empty object/array
+  const char * p = scanSpace(scan.next + 1, scan.end);
+  scan.next = (p < scan.end && *p == scan.close) ? NULL : p;
+  return true;
+}
+
+bool scanError(payloadScan_t & scan)
+{
+  scan.next = NULL;
+  scan.error = true;
+  return false;
+}
+
+// Get the next object member (as "key":value, with the key alone too) or
+// array element (key NULL) - false at the end, or if the payload is
+// malformed (scan.error)
+bool scanNext(payloadScan_t & scan, payloadSpan_t * key, payloadSpan_t & value)
+{
+  if (!scan.next) return false;
+
+  const char * p = scanSpace(scan.next, scan.end);
+  const char * start = p;
+
+  if (key)
+  {
+    if (p == scan.end || *p != '"') return scanError(scan);
+
+    p = scanValue(p, scan.end);
+    if (!p) return scanError(scan);
+
+    key->start = start + 1;
+    key->length = p - start - 2;
+
+    p = scanSpace(p, scan.end);
+    if (p == scan.end || *p != ':') return scanError(scan);
+    p = scanSpace(p + 1, scan.end);
+  }
+
+  const char * valueStart = p;
+  p = scanValue(p, scan.end);
+  if (!p || p == valueStart) return scanError(scan);
+
+  value.start = key ? start : valueStart;
+  value.length = p - value.start;
+
+  p = scanSpace(p, scan.end);
+  if (p == scan.end) return scanError(scan);
+
+  if (*p == ',')
+  {
+    scan.next = p + 1;
+  }
+  else if (*p == scan.close)
+  {
+    scan.next = NULL;
+  }
+  else
+  {
+    return scanError(scan);
+  }
+
+  return true;
+}
+
+bool spanIs(const payloadSpan_t & span, const char * text)
+{
+  return strlen(text) == span.length && strncmp(span.start, text, span.length) == 0;
+}
+
+// Start of the value in a "key":value member span
+payloadSpan_t memberValue(const payloadSpan_t & member, const payloadSpan_t & key)
+{
+  const char * end = member.start + member.length;
+  const char * p = scanSpace(key.start + key.length + 1, end);
+  p = scanSpace(p + 1, end);
+
+  payloadSpan_t value = { p, (size_t)(end - p) };
+  return value;
+}
+
+// Apply each element of a list in turn, parsed into a small fixed size
+// document - so it takes the same RAM however long the list is
+void streamList(const payloadSpan_t & list, void (*handler)(JsonVariant))
+{
+  payloadScan_t scan;
+  if (!scanBegin(scan, list, '['))
+  {
+    oxrs.println(F("[digio] failed to stream payload: list expected"));
+    return;
+  }
+
+  StaticJsonDocument<STREAM_ELEMENT_SIZE> json;
+  payloadSpan_t element;
+
+  while (scanNext(scan, NULL, element))
+  {
+    DeserializationError error = deserializeJson(json, element.start, element.length);
+    if (error)
+    {
+      oxrs.print(F("[digio] failed to stream list element: "));
+      oxrs.println(error.c_str());
+      continue;
+    }
+
+    memoryCheckpoint();
+    handler(json.as<JsonVariant>());
+  }
+
+  if (scan.error)
+  {
+    oxrs.println(F("[digio] failed to stream payload: malformed list"));
+  }
+}
+
+// Parse the members other than the streamed lists in one go
+bool parseMembers(JsonDocument & json, PayloadMembers & members)
+{
+  DeserializationError error = deserializeJson(json, members);
+  if (error)
+  {
+    oxrs.print(F("[digio] failed to stream payload: "));
+    oxrs.println(error.c_str());
+    return false;
+  }
+
+  memoryCheckpoint();
+  return true;
+}
+
+// Split a payload into the lists we stream and the rest of its members,
+// false (logged) if it isn't a well formed object
+bool scanPayload(const char * payload, size_t length, PayloadMembers & members,
+  payloadSpan_t * gpios, payloadSpan_t * rules)
+{
+  payloadSpan_t span = { payload, length };
+  payloadScan_t scan;
+  if (!scanBegin(scan, span, '{'))
+  {
+    oxrs.println(F("[digio] failed to stream payload: object expected"));
+    return false;
+  }
+
+  payloadSpan_t key, member;
+  while (scanNext(scan, &key, member))
+  {
+    if (gpios && spanIs(key, "gpios"))
+    {
+      *gpios = memberValue(member, key);
+    }
+    else if (rules && spanIs(key, "rules"))
+    {
+      *rules = memberValue(member, key);
+    }
+    else if (!members.add(member))
+    {
+      oxrs.println(F("[digio] too many payload members, member ignored"));
+    }
+  }
+
+  if (scan.error)
+  {
+    oxrs.println(F("[digio] failed to stream payload: malformed object"));
+    return false;
+  }
+
+  return true;
+}
+
+// Each document is parsed in a function of its own, so the members and
+// list element documents are never on the stack together
+void streamSettings(PayloadMembers & members)
+{
+  StaticJsonDocument<STREAM_MEMBERS_SIZE> json;
+  if (!parseMembers(json, members)) return;
+
+  jsonSettingsConfig(json.as<JsonVariant>());
+}
+
+// Rules taken/rejected from the list being streamed
+uint16_t streamRulesAccepted = 0;
+uint16_t streamRulesRejected = 0;
+
+void streamRule(JsonVariant json)
+{
+  if (jsonRuleConfig(json)) { streamRulesAccepted++; } else { streamRulesRejected++; }
+}
+
+void streamRules(const payloadSpan_t & list)
+{
+  // The rules list always replaces the whole table, as in jsonRulesConfig()
+  clearRules();
+
+  streamRulesAccepted = 0;
+  streamRulesRejected = 0;
+  streamList(list, streamRule);
+}
+
+// Same as jsonConfig(), but straight from the payload buffer - the gpios
+// and rules lists are applied an element at a time, and everything else
+// is parsed into one small document, so peak RAM doesn't grow with the
+// number of GPIOs configured
+void streamConfig(const char * payload, size_t length)
+{
+  memoryBegin(MEMORY_CONFIG);
+
+  PayloadMembers members;
+  payloadSpan_t gpios = { NULL, 0 };
+  payloadSpan_t ruleList = { NULL, 0 };
+
+  if (scanPayload(payload, length, members, &gpios, &ruleList))
+  {
+    streamSettings(members);
+
+    if (gpios.start)
+    {
+      lockIO();
+      streamList(gpios, jsonGpioConfig);
+      bindRotaryCounters();
+      unlockIO();
+    }
+
+    if (ruleList.start)
+    {
+      lockIO();
+      streamRules(ruleList);
+      unlockIO();
+
+      publishRulesResult(streamRulesAccepted, streamRulesRejected);
+    }
+
+    // Persist so the config is in place at the next boot
+    if (gpios.start || ruleList.start)
+    {
+      saveConfig();
+    }
+  }
+
+  memoryEnd(MEMORY_CONFIG);
+}
+
+void streamOtherCommands(PayloadMembers & members, bool gpios)
+{
+  StaticJsonDocument<STREAM_MEMBERS_SIZE> json;
+
+  // Still switch any outputs the gpios list commanded
+  if (!parseMembers(json, members)) json.clear();
+
+  jsonOtherCommands(json.as<JsonVariant>(), gpios);
+}
+
+// Same as jsonCommand(), but straight from the payload buffer - the gpios
+// list is handled an element at a time (see streamConfig()), false (and
+// nothing done) if there isn't one, or the payload isn't well formed
+bool streamCommand(const char * payload, size_t length)
+{
+  PayloadMembers members;
+  payloadSpan_t gpios = { NULL, 0 };
+
+  if (!scanPayload(payload, length, members, &gpios, NULL) || !gpios.start) return false;
+
+  memoryBegin(MEMORY_COMMAND);
+  streamList(gpios, jsonGpioCommand);
+  streamOtherCommands(members, true);
+  memoryEnd(MEMORY_COMMAND);
+  return true;
+}
+
+// The OXRS library's MQTT client and handler (globals in the library)
+extern PubSubClient _mqttClient;
+extern OXRS_MQTT _mqtt;
+
+// Registered with the OXRS library's MQTT client in place of its own
+// callback, which parses every payload into a document sized for the
+// largest config. Config payloads, and commands with a gpios list, are
+// streamed from the client's buffer instead, anything else (including
+// the library's own commands, e.g. restart) is still handed to it.
+void streamMqttCallback(char * topic, byte * payload, unsigned int length)
+{
+  char streamTopic[STREAM_TOPIC_SIZE];
+
+  if (length && strcmp(topic, _mqtt.getConfigTopic(streamTopic)) == 0)
+  {
+    streamConfig((const char *)payload, length);
+    return;
+  }
+
+  if (length && strcmp(topic, _mqtt.getCommandTopic(streamTopic)) == 0 &&
+      streamCommand((const char *)payload, length)) return;
+
+  if (_mqtt.receive(topic, payload, length) == MQTT_RECEIVE_JSON_ERROR)
+  {
+    oxrs.println(F("[digio] failed to deserialise JSON payload"));
+  }
+}
+
+void beginStream(void)
+{
+  _mqttClient.setCallback(streamMqttCallback);
+}
+#endif